@@ -1,6 +1,7 @@
 #include "Hiredis.h"
 
 #include <muduo/base/Logging.h>
+#include <muduo/base/WeakCallback.h>
 #include <muduo/net/Channel.h>
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/SocketsOps.h>
@@ -18,7 +19,9 @@ static void dummy(const boost::shared_ptr<Channel>&)
 Hiredis::Hiredis(EventLoop* loop, const InetAddress& serverAddr)
   : loop_(loop),
     serverAddr_(serverAddr),
-    context_(NULL)
+    context_(NULL),
+    flushPending_(false),
+    flushing_(false)
 {
 }
 
@@ -26,7 +29,10 @@ Hiredis::~Hiredis()
 {
   LOG_DEBUG << this;
   assert(!channel_ || channel_->isNoneEvent());
-  ::redisAsyncFree(context_);
+  if (context_)
+  {
+    ::redisAsyncFree(context_);
+  }
 }
 
 bool Hiredis::connected() const
@@ -109,6 +115,18 @@ void Hiredis::handleWrite()
   ::redisAsyncHandleWrite(context_);
 }
 
+void Hiredis::flush()
+{
+  flushPending_ = false;
+  if (connected())
+  {
+    // one write for all commands queued since the last flush.
+    flushing_ = true;
+    ::redisAsyncHandleWrite(context_);
+    flushing_ = false;
+  }
+}
+
 /* static */ Hiredis* Hiredis::getHiredis(const redisAsyncContext* ac)
 {
   Hiredis* hiredis = static_cast<Hiredis*>(ac->ev.data);
@@ -148,6 +166,12 @@ void Hiredis::connectCallback(int status)
   {
     connectCb_(this, status);
   }
+
+  if (status != REDIS_OK)
+  {
+    // hiredis frees it after we return, connect() may be called again.
+    context_ = NULL;
+  }
 }
 
 /* static */ void Hiredis::disconnectCallback(const redisAsyncContext* ac, int status)
@@ -165,13 +189,20 @@ void Hiredis::disconnectCallback(int status)
   {
     disconnectCb_(this, status);
   }
+
+  // hiredis frees it after we return, connect() may be called again.
+  context_ = NULL;
 }
 
 void Hiredis::addRead(void* privdata)
 {
   LOG_TRACE;
   Hiredis* hiredis = static_cast<Hiredis*>(privdata);
-  hiredis->channel_->enableReading();
+  // called after every write, don't update poller when unchanged.
+  if (!hiredis->channel_->isReading())
+  {
+    hiredis->channel_->enableReading();
+  }
 }
 
 void Hiredis::delRead(void* privdata)
@@ -185,14 +216,33 @@ void Hiredis::addWrite(void* privdata)
 {
   LOG_TRACE;
   Hiredis* hiredis = static_cast<Hiredis*>(privdata);
-  hiredis->channel_->enableWriting();
+  if (hiredis->flushing_
+      || hiredis->channel_->isWriting()
+      || !(hiredis->context_->c.flags & REDIS_CONNECTED))
+  {
+    // waits for connection, or for room in socket buffer.
+    if (!hiredis->channel_->isWriting())
+    {
+      hiredis->channel_->enableWriting();
+    }
+  }
+  else if (!hiredis->flushPending_)
+  {
+    hiredis->flushPending_ = true;
+    // a Hiredis destroyed in this iteration is not flushed.
+    hiredis->loop_->runAtIterationEnd(
+        makeWeakCallback(hiredis->shared_from_this(), &Hiredis::flush));
+  }
 }
 
 void Hiredis::delWrite(void* privdata)
 {
   LOG_TRACE;
   Hiredis* hiredis = static_cast<Hiredis*>(privdata);
-  hiredis->channel_->disableWriting();
+  if (hiredis->channel_->isWriting())
+  {
+    hiredis->channel_->disableWriting();
+  }
 }
 
 void Hiredis::cleanup(void* privdata)
@@ -203,28 +253,55 @@ void Hiredis::cleanup(void* privdata)
 
 int Hiredis::command(const CommandCallback& cb, muduo::StringArg cmd, ...)
 {
-  if (!connected()) return REDIS_ERR;
-
-  LOG_TRACE;
-  CommandCallback* p = new CommandCallback(cb);
   va_list args;
   va_start(args, cmd);
-  int ret = ::redisvAsyncCommand(context_, commandCallback, p, cmd.c_str(), args);
+  int ret = vcommand(cb, cmd, args);
   va_end(args);
   return ret;
 }
 
+int Hiredis::vcommand(const CommandCallback& cb, muduo::StringArg cmd, va_list args)
+{
+  if (!connected()) return REDIS_ERR;
+
+  LOG_TRACE;
+  size_t slot = 0;
+  if (freeCallbacks_.empty())
+  {
+    slot = callbacks_.size();
+    callbacks_.push_back(cb);
+  }
+  else
+  {
+    slot = freeCallbacks_.back();
+    freeCallbacks_.pop_back();
+    callbacks_[slot] = cb;
+  }
+  // privdata is the slot, not a pointer
+  void* privdata = reinterpret_cast<void*>(static_cast<uintptr_t>(slot));
+  int ret = ::redisvAsyncCommand(context_, commandCallback, privdata, cmd.c_str(), args);
+  if (ret != REDIS_OK)
+  {
+    callbacks_[slot].clear();
+    freeCallbacks_.push_back(slot);
+  }
+  return ret;
+}
+
 /* static */ void Hiredis::commandCallback(redisAsyncContext* ac, void* r, void* privdata)
 {
   redisReply* reply = static_cast<redisReply*>(r);
-  CommandCallback* cb = static_cast<CommandCallback*>(privdata);
-  getHiredis(ac)->commandCallback(reply, cb);
+  size_t slot = static_cast<size_t>(reinterpret_cast<uintptr_t>(privdata));
+  getHiredis(ac)->commandCallback(reply, slot);
 }
 
-void Hiredis::commandCallback(redisReply* reply, CommandCallback* cb)
+void Hiredis::commandCallback(redisReply* reply, size_t slot)
 {
-  (*cb)(this, reply);
-  delete cb;
+  // cb may issue commands, which reuse this slot or grow callbacks_.
+  CommandCallback cb;
+  cb.swap(callbacks_[slot]);
+  freeCallbacks_.push_back(slot);
+  cb(this, reply);
 }
 
 int Hiredis::ping()
@@ -13,6 +13,10 @@
 
 #include <hiredis/hiredis.h>
 
+#include <vector>
+
+#include <stdarg.h>
+
 struct redisAsyncContext;
 
 namespace muduo
@@ -27,6 +31,8 @@ class EventLoop;
 namespace hiredis
 {
 
+// Must be owned by a shared_ptr, pipelined commands are flushed
+// through a weak callback.
 class Hiredis : public boost::enable_shared_from_this<Hiredis>,
                 boost::noncopyable
 {
@@ -49,13 +55,17 @@ class Hiredis : public boost::enable_shared_from_this<Hiredis>,
   void connect();
   void disconnect();  // FIXME: implement this with redisAsyncDisconnect
 
+  // Commands issued in one loop iteration are pipelined, they are
+  // written together at the end of the iteration.
   int command(const CommandCallback& cb, muduo::StringArg cmd, ...);
+  int vcommand(const CommandCallback& cb, muduo::StringArg cmd, va_list args);
 
   int ping();
 
  private:
   void handleRead(muduo::Timestamp receiveTime);
   void handleWrite();
+  void flush();
 
   int fd() const;
   void logConnection(bool up) const;
@@ -64,7 +74,7 @@ class Hiredis : public boost::enable_shared_from_this<Hiredis>,
 
   void connectCallback(int status);
   void disconnectCallback(int status);
-  void commandCallback(redisReply* reply, CommandCallback* privdata);
+  void commandCallback(redisReply* reply, size_t slot);
 
   static Hiredis* getHiredis(const redisAsyncContext* ac);
 
@@ -88,6 +98,13 @@ class Hiredis : public boost::enable_shared_from_this<Hiredis>,
   boost::shared_ptr<muduo::net::Channel> channel_;
   ConnectCallback connectCb_;
   DisconnectCallback disconnectCb_;
+  bool flushPending_;  // flush() is queued for the end of loop iteration
+  bool flushing_;
+  // callbacks of commands in flight, indexed by privdata, slots are reused.
+  // Storing a callback copies it, which allocates unless it fits in
+  // boost::function's small buffer, eg. a plain function.
+  std::vector<CommandCallback> callbacks_;
+  std::vector<size_t> freeCallbacks_;
 };
 
 }
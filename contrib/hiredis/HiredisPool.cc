@@ -0,0 +1,133 @@
+#include "HiredisPool.h"
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+
+using namespace muduo;
+using namespace muduo::net;
+using namespace hiredis;
+
+HiredisPool::HiredisPool(const std::vector<EventLoop*>& loops,
+                         const InetAddress& serverAddr,
+                         int connectionsPerLoop)
+{
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    LoopConnections* lc = new LoopConnections;
+    lc->loop = loops[i];
+    for (int j = 0; j < connectionsPerLoop; ++j)
+    {
+      boost::shared_ptr<Hiredis> c(new Hiredis(loops[i], serverAddr));
+      c->setConnectCallback(boost::bind(&HiredisPool::onConnect, this, lc, _1, _2));
+      c->setDisconnectCallback(boost::bind(&HiredisPool::onDisconnect, this, lc, _1, _2));
+      lc->connections.push_back(c);
+    }
+    loops_.push_back(lc);
+    loopMap_[loops[i]] = lc;
+  }
+}
+
+HiredisPool::~HiredisPool()
+{
+}
+
+void HiredisPool::connect()
+{
+  for (size_t i = 0; i < loops_.size(); ++i)
+  {
+    loops_[i].loop->runInLoop(boost::bind(&HiredisPool::connectInLoop, this, &loops_[i]));
+  }
+}
+
+void HiredisPool::connectInLoop(LoopConnections* lc)
+{
+  lc->loop->assertInLoopThread();
+  lc->stopped = false;
+  for (size_t i = 0; i < lc->connections.size(); ++i)
+  {
+    lc->connections[i]->connect();
+  }
+}
+
+void HiredisPool::disconnect()
+{
+  for (size_t i = 0; i < loops_.size(); ++i)
+  {
+    loops_[i].loop->runInLoop(boost::bind(&HiredisPool::disconnectInLoop, this, &loops_[i]));
+  }
+}
+
+void HiredisPool::disconnectInLoop(LoopConnections* lc)
+{
+  lc->loop->assertInLoopThread();
+  lc->stopped = true;
+  for (size_t i = 0; i < lc->connections.size(); ++i)
+  {
+    lc->connections[i]->disconnect();
+  }
+}
+
+void HiredisPool::onConnect(LoopConnections* lc, Hiredis* c, int status)
+{
+  if (status != REDIS_OK)
+  {
+    lc->loop->runAfter(kReconnectDelay, boost::bind(&HiredisPool::reconnect, this, lc, c));
+  }
+}
+
+void HiredisPool::onDisconnect(LoopConnections* lc, Hiredis* c, int status)
+{
+  if (!lc->stopped)
+  {
+    LOG_WARN << "reconnect to " << c->serverAddress().toIpPort()
+             << " in " << kReconnectDelay << " seconds";
+    lc->loop->runAfter(kReconnectDelay, boost::bind(&HiredisPool::reconnect, this, lc, c));
+  }
+}
+
+void HiredisPool::reconnect(LoopConnections* lc, Hiredis* c)
+{
+  if (!lc->stopped)
+  {
+    c->connect();
+  }
+}
+
+HiredisPool::LoopConnections* HiredisPool::current()
+{
+  std::map<EventLoop*, LoopConnections*>::iterator it
+    = loopMap_.find(EventLoop::getEventLoopOfCurrentThread());
+  if (it == loopMap_.end())
+  {
+    LOG_FATAL << "HiredisPool - not in one of its loops";
+  }
+  return it->second;
+}
+
+Hiredis* HiredisPool::get()
+{
+  LoopConnections* lc = current();
+  size_t n = lc->connections.size();
+  for (size_t i = 0; i < n; ++i)
+  {
+    Hiredis* c = get_pointer(lc->connections[(lc->next + i) % n]);
+    if (c->connected())
+    {
+      lc->next = (lc->next + i + 1) % n;
+      return c;
+    }
+  }
+  return NULL;
+}
+
+int HiredisPool::command(const Hiredis::CommandCallback& cb, muduo::StringArg cmd, ...)
+{
+  Hiredis* c = get();
+  if (!c) return REDIS_ERR;
+
+  va_list args;
+  va_start(args, cmd);
+  int ret = c->vcommand(cb, cmd, args);
+  va_end(args);
+  return ret;
+}
@@ -0,0 +1,63 @@
+#ifndef MUDUO_EXAMPLES_HIREDIS_HIREDISPOOL_H
+#define MUDUO_EXAMPLES_HIREDIS_HIREDISPOOL_H
+
+#include "Hiredis.h"
+
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <map>
+#include <vector>
+
+namespace hiredis
+{
+
+// Hiredis connections in every loop, eg. of an EventLoopThreadPool.
+// Commands go out on a connection of the caller's loop, so there is no
+// locking and no hopping between threads, and commands of one loop
+// iteration are pipelined.
+class HiredisPool : boost::noncopyable
+{
+ public:
+  HiredisPool(const std::vector<muduo::net::EventLoop*>& loops,
+              const muduo::net::InetAddress& serverAddr,
+              int connectionsPerLoop = 1);
+  ~HiredisPool();
+
+  // thread safe, connections reconnect after kReconnectDelay seconds.
+  void connect();
+  void disconnect();
+
+  // A connected Hiredis of the current loop, round robin, NULL if none.
+  // Must be called in one of the loops.
+  Hiredis* get();
+
+  // REDIS_ERR if no connection in current loop.
+  int command(const Hiredis::CommandCallback& cb, muduo::StringArg cmd, ...);
+
+ private:
+  static const int kReconnectDelay = 1;
+
+  struct LoopConnections
+  {
+    LoopConnections() : loop(NULL), next(0), stopped(false) { }
+
+    muduo::net::EventLoop* loop;
+    std::vector<boost::shared_ptr<Hiredis> > connections;
+    size_t next;
+    bool stopped;
+  };
+
+  LoopConnections* current();
+  void connectInLoop(LoopConnections* lc);
+  void disconnectInLoop(LoopConnections* lc);
+  void onConnect(LoopConnections* lc, Hiredis* c, int status);
+  void onDisconnect(LoopConnections* lc, Hiredis* c, int status);
+  void reconnect(LoopConnections* lc, Hiredis* c);
+
+  boost::ptr_vector<LoopConnections> loops_;
+  std::map<muduo::net::EventLoop*, LoopConnections*> loopMap_;  // immutable after ctor
+};
+
+}
+
+#endif  // MUDUO_EXAMPLES_HIREDIS_HIREDISPOOL_H
@@ -0,0 +1,107 @@
+#include "HiredisPool.h"
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopThreadPool.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// Keeps a pipeline of commands in flight on every loop, a reply sends the
+// next one.  The callback is a plain function, so Hiredis stores it
+// without allocating, hiredis itself still allocates for each command.
+
+hiredis::HiredisPool* g_pool;
+AtomicInt64 g_replies;
+AtomicInt64 g_errors;
+int g_pipeline = 100;
+
+void sendOne();
+
+void onReply(hiredis::Hiredis* c, redisReply* reply)
+{
+  if (reply && reply->type != REDIS_REPLY_ERROR)
+  {
+    g_replies.increment();
+  }
+  else
+  {
+    g_errors.increment();
+  }
+  sendOne();
+}
+
+void sendOne()
+{
+  static __thread int count = 0;
+  if (++count % 2 == 0)
+  {
+    g_pool->command(onReply, "SET key:%d %d", count % 10000, count);
+  }
+  else
+  {
+    g_pool->command(onReply, "GET key:%d", count % 10000);
+  }
+}
+
+void start()
+{
+  for (int i = 0; i < g_pipeline; ++i)
+  {
+    sendOne();
+  }
+}
+
+void report(Timestamp* last, int64_t* lastReplies)
+{
+  Timestamp now = Timestamp::now();
+  int64_t replies = g_replies.get();
+  double seconds = timeDifference(now, *last);
+  printf("%.0f ops/sec, %" PRId64 " errors\n",
+         static_cast<double>(replies - *lastReplies) / seconds, g_errors.get());
+  *last = now;
+  *lastReplies = replies;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 3)
+  {
+    printf("Usage: %s ip port [threads] [connections_per_thread] [pipeline] [seconds]\n", argv[0]);
+    return 0;
+  }
+
+  Logger::setLogLevel(Logger::WARN);
+  InetAddress serverAddr(argv[1], static_cast<uint16_t>(atoi(argv[2])));
+  int threads = argc > 3 ? atoi(argv[3]) : 1;
+  int connections = argc > 4 ? atoi(argv[4]) : 1;
+  g_pipeline = argc > 5 ? atoi(argv[5]) : 100;
+  int seconds = argc > 6 ? atoi(argv[6]) : 10;
+
+  EventLoop loop;
+  EventLoopThreadPool threadPool(&loop, "mredisbench");
+  threadPool.setThreadNum(threads);
+  threadPool.start();
+
+  std::vector<EventLoop*> loops = threadPool.getAllLoops();
+  hiredis::HiredisPool pool(loops, serverAddr, connections);
+  g_pool = &pool;
+  pool.connect();
+
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    loops[i]->runAfter(1.0, start);
+  }
+
+  Timestamp last = Timestamp::now();
+  int64_t lastReplies = 0;
+  loop.runEvery(1.0, boost::bind(report, &last, &lastReplies));
+  loop.runAfter(1.0 + seconds, boost::bind(&hiredis::HiredisPool::disconnect, &pool));
+  loop.runAfter(1.5 + seconds, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+}
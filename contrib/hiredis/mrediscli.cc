@@ -112,28 +112,28 @@ int main(int argc, char** argv)
   EventLoop loop;
 
   InetAddress serverAddr("127.0.0.1", 6379);
-  hiredis::Hiredis hiredis(&loop, serverAddr);
+  boost::shared_ptr<hiredis::Hiredis> hiredis(new hiredis::Hiredis(&loop, serverAddr));
 
-  hiredis.setConnectCallback(connectCallback);
-  hiredis.setDisconnectCallback(disconnectCallback);
-  hiredis.connect();
+  hiredis->setConnectCallback(connectCallback);
+  hiredis->setDisconnectCallback(disconnectCallback);
+  hiredis->connect();
 
-  //hiredis.ping();
-  loop.runEvery(1.0, boost::bind(&hiredis::Hiredis::ping, &hiredis));
+  //hiredis->ping();
+  loop.runEvery(1.0, boost::bind(&hiredis::Hiredis::ping, hiredis));
 
-  hiredis.command(timeCallback, "time");
+  hiredis->command(timeCallback, "time");
 
   string hi = "hi";
-  hiredis.command(boost::bind(echoCallback, _1, _2, &hi), "echo %s", hi.c_str());
-  loop.runEvery(2.0, boost::bind(echo, &hiredis, &hi));
+  hiredis->command(boost::bind(echoCallback, _1, _2, &hi), "echo %s", hi.c_str());
+  loop.runEvery(2.0, boost::bind(echo, get_pointer(hiredis), &hi));
 
-  hiredis.command(dbsizeCallback, "dbsize");
+  hiredis->command(dbsizeCallback, "dbsize");
 
   uint16_t index = 8;
-  hiredis.command(boost::bind(selectCallback, _1, _2, &index), "select %d", index);
+  hiredis->command(boost::bind(selectCallback, _1, _2, &index), "select %d", index);
 
   string password = "password";
-  hiredis.command(boost::bind(authCallback, _1, _2, &password), "auth %s", password.c_str());
+  hiredis->command(boost::bind(authCallback, _1, _2, &password), "auth %s", password.c_str());
 
   loop.loop();
 
@@ -1,13 +1,19 @@
 #include "codec.h"
 
 #include <muduo/base/Logging.h>
+#include <muduo/base/ThreadLocalSingleton.h>
 #include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopThreadPool.h>
 #include <muduo/net/TcpServer.h>
 
 #include <boost/bind.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
 
-#include <map>
+#include <algorithm>
 #include <set>
+#include <utility>
+#include <vector>
 #include <stdio.h>
 
 using namespace muduo;
@@ -17,53 +23,93 @@ namespace pubsub
 {
 
 typedef std::set<string> ConnectionSubscription;
+typedef std::vector<TcpConnectionPtr> ConnectionList;
+// topic and the message to send its subscribers
+typedef std::pair<string, SharedMessage> Publication;
+typedef std::vector<Publication> PublicationList;
+typedef boost::shared_ptr<const PublicationList> PublicationListPtr;
 
-class Topic : public muduo::copyable
+struct StringHash
 {
- public:
-  Topic(const string& topic)
-    : topic_(topic)
+  size_t operator()(const string& s) const
   {
+    return boost::hash_range(s.begin(), s.end());
   }
+};
 
+class Topic : public muduo::copyable
+{
+ public:
   void add(const TcpConnectionPtr& conn)
   {
-    audiences_.insert(conn);
-    if (lastPubTime_.valid())
+    audiences_.push_back(conn);
+    if (message_)
     {
-      conn->send(makeMessage());
+      conn->send(message_);
     }
   }
 
   void remove(const TcpConnectionPtr& conn)
   {
-    audiences_.erase(conn);
+    ConnectionList::iterator it = std::find(audiences_.begin(), audiences_.end(), conn);
+    if (it != audiences_.end())
+    {
+      // order of audiences doesn't matter, move the last one into the hole.
+      *it = audiences_.back();
+      audiences_.pop_back();
+    }
   }
 
-  void publish(const string& content, Timestamp time)
+  void publish(const SharedMessage& message)
   {
-    content_ = content;
-    lastPubTime_ = time;
-    string message = makeMessage();
-    for (std::set<TcpConnectionPtr>::iterator it = audiences_.begin();
-         it != audiences_.end();
-         ++it)
+    message_ = message;
+    for (size_t i = 0; i < audiences_.size(); ++i)
     {
-      (*it)->send(message);
+      audiences_[i]->send(message_);
     }
   }
 
  private:
+  SharedMessage message_;  // last published
+  ConnectionList audiences_;
+};
+
+// Topics of one IO loop, with subscribers of that loop only.
+// Used in its loop thread only, so no locking.
+class Shard : boost::noncopyable
+{
+ public:
+  void subscribe(const TcpConnectionPtr& conn, const string& topic)
+  {
+    getTopic(topic).add(conn);
+  }
+
+  void unsubscribe(const TcpConnectionPtr& conn, const string& topic)
+  {
+    TopicMap::iterator it = topics_.find(topic);
+    if (it != topics_.end())
+    {
+      it->second.remove(conn);
+    }
+  }
 
-  string makeMessage()
+  void publish(const PublicationList& pubs)
+  {
+    for (size_t i = 0; i < pubs.size(); ++i)
+    {
+      getTopic(pubs[i].first).publish(pubs[i].second);
+    }
+  }
+
+ private:
+  Topic& getTopic(const string& topic)
   {
-    return "pub " + topic_ + "\r\n" + content_ + "\r\n";
+    // topics are kept even without subscribers, for the last message.
+    return topics_[topic];
   }
 
-  string topic_;
-  string content_;
-  Timestamp lastPubTime_;
-  std::set<TcpConnectionPtr> audiences_;
+  typedef boost::unordered_map<string, Topic, StringHash> TopicMap;
+  TopicMap topics_;
 };
 
 class PubSubServer : boost::noncopyable
@@ -81,9 +127,17 @@ class PubSubServer : boost::noncopyable
     loop_->runEvery(1.0, boost::bind(&PubSubServer::timePublish, this));
   }
 
+  void setThreadNum(int numThreads)
+  {
+    server_.setThreadNum(numThreads);
+  }
+
   void start()
   {
+    server_.setThreadInitCallback(boost::bind(&PubSubServer::threadInit, this, _1));
     server_.start();
+    // every loop is running now, loops_ is read only from here on.
+    loops_ = server_.threadPool()->getAllLoops();
   }
 
  private:
@@ -97,11 +151,11 @@ class PubSubServer : boost::noncopyable
     {
       const ConnectionSubscription& connSub
         = boost::any_cast<const ConnectionSubscription&>(conn->getContext());
-      // subtle: doUnsubscribe will erase *it, so increase before calling.
       for (ConnectionSubscription::const_iterator it = connSub.begin();
-           it != connSub.end();)
+           it != connSub.end();
+           ++it)
       {
-        doUnsubscribe(conn, *it++);
+        LocalShard::instance().unsubscribe(conn, *it);
       }
     }
   }
@@ -110,6 +164,8 @@ class PubSubServer : boost::noncopyable
                  Buffer* buf,
                  Timestamp receiveTime)
   {
+    // publishes in one read are sent to other loops together.
+    PublicationList pubs;
     ParseResult result = kSuccess;
     while (result == kSuccess)
     {
@@ -121,7 +177,7 @@ class PubSubServer : boost::noncopyable
       {
         if (cmd == "pub")
         {
-          doPublish(conn->name(), topic, content, receiveTime);
+          pubs.push_back(makePublication(topic, content));
         }
         else if (cmd == "sub")
         {
@@ -143,12 +199,17 @@ class PubSubServer : boost::noncopyable
         conn->shutdown();
       }
     }
+    if (!pubs.empty())
+    {
+      distribute(pubs);
+    }
   }
 
   void timePublish()
   {
     Timestamp now = Timestamp::now();
-    doPublish("internal", "utc_time", now.toFormattedString(), now);
+    PublicationList pubs(1, makePublication("utc_time", now.toFormattedString()));
+    distribute(pubs);
   }
 
   void doSubscribe(const TcpConnectionPtr& conn,
@@ -157,42 +218,73 @@ class PubSubServer : boost::noncopyable
     ConnectionSubscription* connSub
       = boost::any_cast<ConnectionSubscription>(conn->getMutableContext());
 
-    connSub->insert(topic);
-    getTopic(topic).add(conn);
+    if (connSub->insert(topic).second)
+    {
+      LocalShard::instance().subscribe(conn, topic);
+    }
   }
 
   void doUnsubscribe(const TcpConnectionPtr& conn,
                      const string& topic)
   {
     LOG_INFO << conn->name() << " unsubscribes " << topic;
-    getTopic(topic).remove(conn);
-    // topic could be the one to be destroyed, so don't use it after erasing.
+    LocalShard::instance().unsubscribe(conn, topic);
     ConnectionSubscription* connSub
       = boost::any_cast<ConnectionSubscription>(conn->getMutableContext());
     connSub->erase(topic);
   }
 
-  void doPublish(const string& source,
-                 const string& topic,
-                 const string& content,
-                 Timestamp time)
+  static Publication makePublication(const string& topic, const string& content)
   {
-    getTopic(topic).publish(content, time);
+    SharedMessage message(new string("pub " + topic + "\r\n" + content + "\r\n"));
+    return Publication(topic, message);
   }
 
-  Topic& getTopic(const string& topic)
+  // Every loop gets one functor for the whole batch, the calling loop
+  // publishes to its own subscribers directly.
+  void distribute(PublicationList& pubs)
   {
-    std::map<string, Topic>::iterator it = topics_.find(topic);
-    if (it == topics_.end())
+    boost::shared_ptr<PublicationList> batch(new PublicationList);
+    batch->swap(pubs);
+    EventLoop::Functor f = boost::bind(&PubSubServer::publishInLoop,
+                                       PublicationListPtr(batch));
+    bool local = false;
+    for (std::vector<EventLoop*>::const_iterator it = loops_.begin();
+        it != loops_.end();
+        ++it)
+    {
+      if ((*it)->isInLoopThread())
+      {
+        local = true;
+      }
+      else
+      {
+        (*it)->queueInLoop(f);
+      }
+    }
+    if (local)
     {
-      it = topics_.insert(make_pair(topic, Topic(topic))).first;
+      LocalShard::instance().publish(*batch);
     }
-    return it->second;
   }
 
+  static void publishInLoop(const PublicationListPtr& pubs)
+  {
+    LocalShard::instance().publish(*pubs);
+  }
+
+  void threadInit(EventLoop*)
+  {
+    assert(LocalShard::pointer() == NULL);
+    LocalShard::instance();
+    assert(LocalShard::pointer() != NULL);
+  }
+
+  typedef ThreadLocalSingleton<Shard> LocalShard;
+
   EventLoop* loop_;
   TcpServer server_;
-  std::map<string, Topic> topics_;
+  std::vector<EventLoop*> loops_;
 };
 
 }
@@ -203,17 +295,16 @@ int main(int argc, char* argv[])
   {
     uint16_t port = static_cast<uint16_t>(atoi(argv[1]));
     EventLoop loop;
+    pubsub::PubSubServer server(&loop, InetAddress(port));
     if (argc > 2)
     {
-      //int inspectPort = atoi(argv[2]);
+      server.setThreadNum(atoi(argv[2]));
     }
-    pubsub::PubSubServer server(&loop, InetAddress(port));
     server.start();
     loop.loop();
   }
   else
   {
-    printf("Usage: %s pubsub_port [inspect_port]\n", argv[0]);
+    printf("Usage: %s pubsub_port [num_threads]\n", argv[0]);
   }
 }
-
@@ -0,0 +1,201 @@
+#include "EpochReclaimer.h"
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/CurrentThread.h>
+
+#include <boost/static_assert.hpp>
+
+#include <algorithm>
+#include <new>
+
+#include <stdlib.h>
+
+using namespace muduo;
+
+// one cache line, so that readers on different cores don't share it
+struct EpochReclaimer::Record
+{
+  explicit Record(int tidArg)
+    : epoch(0),
+      depth(0),
+      tid(tidArg),
+      next(NULL)
+  {
+  }
+
+  volatile int64_t epoch;  // 0 when not inside a Guard
+  int depth;               // Guards may nest
+  const int tid;           // owner thread
+  Record* next;
+} __attribute__ ((aligned(64)));
+
+BOOST_STATIC_ASSERT(sizeof(EpochReclaimer::Record) == 64);
+
+namespace
+{
+AtomicInt32 g_nextId;
+__thread EpochReclaimer::Record* t_record = NULL;
+__thread int t_reclaimerId = 0;
+
+template<typename T>
+struct RetiredBefore
+{
+  explicit RetiredBefore(int64_t e)
+    : epoch(e)
+  {
+  }
+
+  bool operator()(const std::pair<int64_t, T>& x) const
+  {
+    return x.first < epoch;
+  }
+
+  int64_t epoch;
+};
+}
+
+EpochReclaimer::EpochReclaimer()
+  : id_(g_nextId.incrementAndGet()),
+    epoch_(1),
+    records_(NULL)
+{
+}
+
+EpochReclaimer::~EpochReclaimer()
+{
+  for (size_t i = 0; i < retiredMemory_.size(); ++i)
+  {
+    ::free(retiredMemory_[i].second);
+  }
+  Record* r = records_;
+  while (r)
+  {
+    Record* next = r->next;
+    r->~Record();
+    ::free(r);
+    r = next;
+  }
+}
+
+EpochReclaimer::Record* EpochReclaimer::enter()
+{
+  Record* r = t_reclaimerId == id_ ? t_record : registerThread();
+  if (r->depth++ == 0)
+  {
+    r->epoch = currentEpoch();
+    // publish our epoch before loading anything from tables,
+    // pairs with the barrier in reclaim().
+    __sync_synchronize();
+  }
+  return r;
+}
+
+void EpochReclaimer::exit(Record* r)
+{
+  if (--r->depth == 0)
+  {
+    __sync_synchronize();
+    r->epoch = 0;
+  }
+}
+
+// A thread switching between reclaimers finds its record again,
+// instead of registering a new one each time.
+EpochReclaimer::Record* EpochReclaimer::registerThread()
+{
+  const int tid = CurrentThread::tid();
+  Record* r = records_;
+  while (r != NULL && r->tid != tid)
+  {
+    r = r->next;
+  }
+  if (r == NULL)
+  {
+    void* memory = NULL;
+    if (::posix_memalign(&memory, sizeof(Record), sizeof(Record)) != 0)
+    {
+      abort();
+    }
+    r = new (memory) Record(tid);
+    MutexLockGuard lock(mutex_);
+    r->next = records_;
+    __sync_synchronize();
+    records_ = r;
+  }
+  t_record = r;
+  t_reclaimerId = id_;
+  return r;
+}
+
+int64_t EpochReclaimer::currentEpoch()
+{
+  return __sync_fetch_and_add(&epoch_, 0);  // full barrier
+}
+
+void EpochReclaimer::retire(const ConstItemPtr& item)
+{
+  // read after the item was unpublished, see reclaim()
+  const int64_t epoch = currentEpoch();
+  size_t retired = 0;
+  {
+  MutexLockGuard lock(mutex_);
+  retiredItems_.push_back(std::make_pair(epoch, item));
+  retired = retiredItems_.size();
+  }
+  if (retired >= kReclaimThreshold)
+  {
+    reclaim();
+  }
+}
+
+void EpochReclaimer::retire(void* memory)
+{
+  const int64_t epoch = currentEpoch();
+  MutexLockGuard lock(mutex_);
+  retiredMemory_.push_back(std::make_pair(epoch, memory));
+}
+
+// A reader which can still see a retired object entered no later than
+// it was retired, so its epoch is <= the tag.  Anything tagged before
+// the oldest active reader is safe to release.
+void EpochReclaimer::reclaim()
+{
+  int64_t oldest = __sync_add_and_fetch(&epoch_, 1);  // full barrier
+  for (Record* r = records_; r != NULL; r = r->next)
+  {
+    int64_t e = r->epoch;
+    if (e != 0 && e < oldest)
+    {
+      oldest = e;
+    }
+  }
+
+  std::vector<std::pair<int64_t, ConstItemPtr> > items;
+  std::vector<std::pair<int64_t, void*> > memory;
+  {
+  MutexLockGuard lock(mutex_);
+  std::vector<std::pair<int64_t, ConstItemPtr> >::iterator itemEnd =
+      std::partition(retiredItems_.begin(), retiredItems_.end(),
+                     RetiredBefore<ConstItemPtr>(oldest));
+  items.assign(retiredItems_.begin(), itemEnd);
+  retiredItems_.erase(retiredItems_.begin(), itemEnd);
+
+  std::vector<std::pair<int64_t, void*> >::iterator memoryEnd =
+      std::partition(retiredMemory_.begin(), retiredMemory_.end(),
+                     RetiredBefore<void*>(oldest));
+  memory.assign(retiredMemory_.begin(), memoryEnd);
+  retiredMemory_.erase(retiredMemory_.begin(), memoryEnd);
+  }
+
+  // items are released when going out of scope, outside of mutex_
+  for (size_t i = 0; i < memory.size(); ++i)
+  {
+    ::free(memory[i].second);
+  }
+}
+
+size_t EpochReclaimer::numRetired() const
+{
+  MutexLockGuard lock(mutex_);
+  return retiredItems_.size() + retiredMemory_.size();
+}
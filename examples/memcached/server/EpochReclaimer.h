@@ -0,0 +1,75 @@
+#ifndef MUDUO_EXAMPLES_MEMCACHED_SERVER_EPOCHRECLAIMER_H
+#define MUDUO_EXAMPLES_MEMCACHED_SERVER_EPOCHRECLAIMER_H
+
+#include "Item.h"
+
+#include <muduo/base/Mutex.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <utility>
+#include <vector>
+
+// Epoch based reclamation for lock free readers of ItemTable.
+//
+// A reader stays inside a Guard while it dereferences what it found.
+// Items and slot arrays removed by writers are retired instead of freed,
+// tagged with the current epoch, and released by reclaim() once every
+// reader that was active at that epoch has left its Guard.
+//
+// Each thread registers one record per reclaimer on first use, records
+// are freed with the reclaimer.
+class EpochReclaimer : boost::noncopyable
+{
+ public:
+  struct Record;
+
+  class Guard : boost::noncopyable
+  {
+   public:
+    explicit Guard(EpochReclaimer& reclaimer)
+      : record_(reclaimer.enter())
+    {
+    }
+
+    ~Guard()
+    {
+      EpochReclaimer::exit(record_);
+    }
+
+   private:
+    Record* record_;
+  };
+
+  EpochReclaimer();
+  ~EpochReclaimer();  // releases everything retired
+
+  // the reference is released after a grace period
+  void retire(const ConstItemPtr& item);
+  // freed with ::free() after a grace period
+  void retire(void* memory);
+
+  // Releases what no reader can see any more.
+  // Must not be called with any mutex held, as releasing an item
+  // takes the mutex of its slab class.
+  void reclaim();
+
+  size_t numRetired() const;
+
+ private:
+  Record* enter();
+  static void exit(Record* record);
+  Record* registerThread();
+  int64_t currentEpoch();
+
+  static const size_t kReclaimThreshold = 1024;
+
+  const int id_;
+  volatile int64_t epoch_;
+  Record* volatile records_;  // prepended under mutex_, read lock free
+  mutable muduo::MutexLock mutex_;
+  std::vector<std::pair<int64_t, ConstItemPtr> > retiredItems_;
+  std::vector<std::pair<int64_t, void*> > retiredMemory_;
+};
+
+#endif  // MUDUO_EXAMPLES_MEMCACHED_SERVER_EPOCHRECLAIMER_H
@@ -1,29 +1,87 @@
 #include "Item.h"
+#include "SlabAllocator.h"
 
 #include <muduo/base/LogStream.h>
 #include <muduo/net/Buffer.h>
 
 #include <boost/unordered_map.hpp>
 
+#include <new>
+
+#include <stdlib.h>
 #include <string.h> // memcpy
 #include <stdio.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
+void intrusive_ptr_release(const Item* item)
+{
+  if (__sync_sub_and_fetch(&item->refs_, 1) == 0)
+  {
+    Item* p = const_cast<Item*>(item);
+    if (p->slabs_)
+    {
+      p->slabs_->deallocate(p);  // unlinks from LRU
+    }
+    else
+    {
+      p->~Item();
+      ::free(p);
+    }
+  }
+}
+
+ItemPtr Item::makeItem(StringPiece keyArg,
+                       uint32_t flagsArg,
+                       int exptimeArg,
+                       int valuelen,
+                       uint64_t casArg)
+{
+  void* chunk = ::malloc(totalSize(keyArg.size(), valuelen));
+  return ItemPtr(new (chunk) Item(keyArg, flagsArg, exptimeArg, valuelen, casArg));
+}
+
+ItemPtr Item::makeItem(void* chunk,
+                       SlabAllocator* slabs,
+                       int slabClass,
+                       StringPiece keyArg,
+                       uint32_t flagsArg,
+                       int exptimeArg,
+                       int valuelen,
+                       uint64_t casArg)
+{
+  assert(chunk && slabs);
+  return ItemPtr(new (chunk) Item(keyArg, flagsArg, exptimeArg, valuelen, casArg,
+                                  slabs, slabClass));
+}
+
+size_t Item::hashKey(StringPiece key)
+{
+  return boost::hash_range(key.begin(), key.end());
+}
+
 Item::Item(StringPiece keyArg,
            uint32_t flagsArg,
            int exptimeArg,
            int valuelen,
-           uint64_t casArg)
+           uint64_t casArg,
+           SlabAllocator* slabs,
+           int slabClass)
   : keylen_(keyArg.size()),
     flags_(flagsArg),
     rel_exptime_(exptimeArg),
     valuelen_(valuelen),
     receivedBytes_(0),
     cas_(casArg),
-    hash_(boost::hash_range(keyArg.begin(), keyArg.end())),
-    data_(static_cast<char*>(::malloc(totalLen())))
+    hash_(hashKey(keyArg)),
+    refs_(0),
+    slabs_(slabs),
+    prev_(NULL),
+    next_(NULL),
+    lastAccess_(0),
+    slabClass_(static_cast<int8_t>(slabClass)),
+    linked_(false)
 {
   assert(valuelen_ >= 2);
   assert(receivedBytes_ < totalLen());
@@ -33,7 +91,7 @@ Item::Item(StringPiece keyArg,
 void Item::append(const char* data, size_t len)
 {
   assert(len <= neededBytes());
-  memcpy(data_ + receivedBytes_, data, len);
+  memcpy(this->data() + receivedBytes_, data, len);
   receivedBytes_ += static_cast<int>(len);
   assert(receivedBytes_ <= totalLen());
 }
@@ -41,7 +99,7 @@ void Item::append(const char* data, size_t len)
 void Item::output(Buffer* out, bool needCas) const
 {
   out->append("VALUE ");
-  out->append(data_, keylen_);
+  out->append(data(), keylen_);
   LogStream buf;
   buf << ' ' << flags_ << ' ' << valuelen_-2;
   if (needCas)
@@ -59,5 +117,5 @@ void Item::resetKey(StringPiece k)
   keylen_ = k.size();
   receivedBytes_ = 0;
   append(k.data(), k.size());
-  hash_ = boost::hash_range(k.begin(), k.end());
+  hash_ = hashKey(k);
 }
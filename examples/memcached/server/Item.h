@@ -5,9 +5,8 @@
 #include <muduo/base/StringPiece.h>
 #include <muduo/base/Types.h>
 
-#include <boost/make_shared.hpp>
+#include <boost/intrusive_ptr.hpp>
 #include <boost/noncopyable.hpp>
-#include <boost/shared_ptr.hpp>
 
 using muduo::string;
 using muduo::StringPiece;
@@ -21,10 +20,16 @@ class Buffer;
 }
 
 class Item;
-typedef boost::shared_ptr<Item> ItemPtr;  // TODO: use unique_ptr
-typedef boost::shared_ptr<const Item> ConstItemPtr;  // TODO: use unique_ptr
+class SlabAllocator;
+// reference counted in Item, no separate control block
+typedef boost::intrusive_ptr<Item> ItemPtr;
+typedef boost::intrusive_ptr<const Item> ConstItemPtr;
+
+void intrusive_ptr_add_ref(const Item* item);
+void intrusive_ptr_release(const Item* item);
 
 // Item is immutable once added into hash table
+// Key and value follow the Item in one chunk of memory.
 class Item : boost::noncopyable
 {
  public:
@@ -39,30 +44,41 @@ class Item : boost::noncopyable
     kCas,
   };
 
+  // allocated with malloc, eg. for lookup keys
   static ItemPtr makeItem(StringPiece keyArg,
                           uint32_t flagsArg,
                           int exptimeArg,
                           int valuelen,
-                          uint64_t casArg)
+                          uint64_t casArg);
+
+  // constructed in a chunk of slabs, which gets it back with the last ItemPtr.
+  static ItemPtr makeItem(void* chunk,
+                          SlabAllocator* slabs,
+                          int slabClass,
+                          StringPiece keyArg,
+                          uint32_t flagsArg,
+                          int exptimeArg,
+                          int valuelen,
+                          uint64_t casArg);
+
+  static size_t totalSize(size_t keylen, size_t valuelen)
   {
-    return boost::make_shared<Item>(keyArg, flagsArg, exptimeArg, valuelen, casArg);
-    //return ItemPtr(new Item(keyArg, flagsArg, exptimeArg, valuelen, casArg));
+    return sizeof(Item) + keylen + valuelen;
   }
 
+  static size_t hashKey(StringPiece key);
+
   Item(StringPiece keyArg,
        uint32_t flagsArg,
        int exptimeArg,
        int valuelen,
-       uint64_t casArg);
-
-  ~Item()
-  {
-    ::free(data_);
-  }
+       uint64_t casArg,
+       SlabAllocator* slabs = NULL,
+       int slabClass = -1);
 
   muduo::StringPiece key() const
   {
-    return muduo::StringPiece(data_, keylen_);
+    return muduo::StringPiece(data(), keylen_);
   }
 
   uint32_t flags() const
@@ -75,9 +91,15 @@ class Item : boost::noncopyable
     return rel_exptime_;
   }
 
+  // now is seconds since server start, same as rel_exptime()
+  bool isExpired(int now) const
+  {
+    return rel_exptime_ != 0 && rel_exptime_ <= now;
+  }
+
   const char* value() const
   {
-    return data_+keylen_;
+    return data()+keylen_;
   }
 
   size_t valueLength() const
@@ -110,16 +132,24 @@ class Item : boost::noncopyable
   bool endsWithCRLF() const
   {
     return receivedBytes_ == totalLen()
-        && data_[totalLen()-2] == '\r'
-        && data_[totalLen()-1] == '\n';
+        && data()[totalLen()-2] == '\r'
+        && data()[totalLen()-1] == '\n';
   }
 
   void output(muduo::net::Buffer* out, bool needCas = false) const;
 
   void resetKey(StringPiece k);
 
+  int refCount() const { return refs_; }
+
  private:
+  friend class SlabAllocator;
+  friend void intrusive_ptr_add_ref(const Item* item);
+  friend void intrusive_ptr_release(const Item* item);
+
   int totalLen() const { return keylen_ + valuelen_; }
+  char* data() { return reinterpret_cast<char*>(this + 1); }
+  const char* data() const { return reinterpret_cast<const char*>(this + 1); }
 
   int            keylen_;
   const uint32_t flags_;
@@ -128,7 +158,27 @@ class Item : boost::noncopyable
   int            receivedBytes_;  // FIXME: remove this member
   uint64_t       cas_;
   size_t         hash_;
-  char*          data_;
+  mutable int    refs_;
+  SlabAllocator* const slabs_;  // NULL if allocated with malloc
+  // following members are guarded by the mutex of slab class
+  mutable const Item* prev_;  // LRU, towards head
+  mutable const Item* next_;
+  mutable int    lastAccess_;
+  const int8_t   slabClass_;
+  mutable bool   linked_;
+};
+
+inline void intrusive_ptr_add_ref(const Item* item)
+{
+  __sync_fetch_and_add(&item->refs_, 1);
+}
+
+// a key of multi-get, see MemcacheServer::getItems()
+struct ItemKey
+{
+  StringPiece key;
+  size_t hash;
+  int index;  // position in request, keys are reordered by shard
 };
 
 #endif  // MUDUO_EXAMPLES_MEMCACHED_SERVER_ITEM_H
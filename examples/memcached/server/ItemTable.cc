@@ -0,0 +1,195 @@
+#include "ItemTable.h"
+#include "EpochReclaimer.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+using namespace muduo;
+
+struct ItemTable::Slots
+{
+  int bits;
+  size_t capacity;
+  const Item* items[1];  // capacity of them actually
+};
+
+namespace
+{
+const int kInitialBits = 4;
+const Item* const kTombstone = reinterpret_cast<const Item*>(1);
+
+inline const Item* loadSlot(const Item* const* slot)
+{
+  return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+}
+
+inline void storeSlot(const Item** slot, const Item* item)
+{
+  __atomic_store_n(slot, item, __ATOMIC_RELEASE);
+}
+
+inline bool isLive(const Item* item)
+{
+  return item != NULL && item != kTombstone;
+}
+}
+
+ItemTable::ItemTable()
+  : slots_(newSlots(kInitialBits)),
+    size_(0),
+    used_(0)
+{
+}
+
+ItemTable::~ItemTable()
+{
+  for (size_t i = 0; i < slots_->capacity; ++i)
+  {
+    if (isLive(slots_->items[i]))
+    {
+      intrusive_ptr_release(slots_->items[i]);
+    }
+  }
+  ::free(slots_);
+}
+
+ItemTable::Slots* ItemTable::newSlots(int bits)
+{
+  const size_t capacity = static_cast<size_t>(1) << bits;
+  Slots* slots = static_cast<Slots*>(
+      ::calloc(1, sizeof(Slots) + (capacity - 1) * sizeof(const Item*)));
+  slots->bits = bits;
+  slots->capacity = capacity;
+  return slots;
+}
+
+// Fibonacci hashing, as the low bits of hash choose the shard
+size_t ItemTable::indexOf(const Slots* slots, size_t hash)
+{
+  return static_cast<size_t>((static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ULL)
+                             >> (64 - slots->bits));
+}
+
+const Item* ItemTable::find(StringPiece key, size_t hash) const
+{
+  const Slots* slots = __atomic_load_n(&slots_, __ATOMIC_ACQUIRE);
+  const size_t mask = slots->capacity - 1;
+  for (size_t i = indexOf(slots, hash); ; i = (i + 1) & mask)
+  {
+    const Item* item = loadSlot(&slots->items[i]);
+    if (item == NULL)
+    {
+      return NULL;
+    }
+    if (item != kTombstone && item->hash() == hash && item->key() == key)
+    {
+      return item;
+    }
+  }
+}
+
+size_t ItemTable::slotOf(const Item* item) const
+{
+  mutex_.assertLocked();
+  const size_t mask = slots_->capacity - 1;
+  for (size_t i = indexOf(slots_, item->hash()); ; i = (i + 1) & mask)
+  {
+    const Item* x = slots_->items[i];
+    if (x == item || x == NULL)
+    {
+      return x == NULL ? slots_->capacity : i;
+    }
+  }
+}
+
+void ItemTable::insert(const ConstItemPtr& item, EpochReclaimer* reclaimer)
+{
+  mutex_.assertLocked();
+  assert(find(item->key(), item->hash()) == NULL);
+  if ((used_ + 1) * 4 > slots_->capacity * 3)
+  {
+    rehash(reclaimer);
+  }
+
+  const size_t mask = slots_->capacity - 1;
+  size_t i = indexOf(slots_, item->hash());
+  while (isLive(slots_->items[i]))
+  {
+    i = (i + 1) & mask;
+  }
+  if (slots_->items[i] == NULL)
+  {
+    ++used_;
+  }
+  ++size_;
+  intrusive_ptr_add_ref(get_pointer(item));  // owned by table
+  storeSlot(&slots_->items[i], get_pointer(item));
+}
+
+ConstItemPtr ItemTable::replace(const Item* oldItem, const ConstItemPtr& newItem)
+{
+  assert(oldItem->key() == newItem->key());
+  const size_t i = slotOf(oldItem);
+  assert(i < slots_->capacity);
+  intrusive_ptr_add_ref(get_pointer(newItem));
+  storeSlot(&slots_->items[i], get_pointer(newItem));
+  return ConstItemPtr(oldItem, false);  // adopts the reference of table
+}
+
+ConstItemPtr ItemTable::remove(const Item* item)
+{
+  const size_t i = slotOf(item);
+  if (i == slots_->capacity)
+  {
+    return ConstItemPtr();
+  }
+  storeSlot(&slots_->items[i], kTombstone);
+  --size_;
+  return ConstItemPtr(item, false);
+}
+
+void ItemTable::removeExpired(int now, std::vector<ConstItemPtr>* expired)
+{
+  mutex_.assertLocked();
+  for (size_t i = 0; i < slots_->capacity; ++i)
+  {
+    const Item* item = slots_->items[i];
+    if (isLive(item) && item->isExpired(now))
+    {
+      storeSlot(&slots_->items[i], kTombstone);
+      --size_;
+      expired->push_back(ConstItemPtr(item, false));
+    }
+  }
+}
+
+// Builds new slots without tombstones, readers still on the old slots
+// see the table as it was before rehash.
+void ItemTable::rehash(EpochReclaimer* reclaimer)
+{
+  int bits = slots_->bits;
+  while ((size_ + 1) * 2 > (static_cast<size_t>(1) << bits))
+  {
+    ++bits;
+  }
+  Slots* slots = newSlots(bits);
+  const size_t mask = slots->capacity - 1;
+  for (size_t i = 0; i < slots_->capacity; ++i)
+  {
+    const Item* item = slots_->items[i];
+    if (isLive(item))
+    {
+      size_t j = indexOf(slots, item->hash());
+      while (slots->items[j] != NULL)
+      {
+        j = (j + 1) & mask;
+      }
+      slots->items[j] = item;
+    }
+  }
+
+  Slots* old = slots_;
+  __atomic_store_n(&slots_, slots, __ATOMIC_RELEASE);
+  used_ = size_;
+  reclaimer->retire(old);
+}
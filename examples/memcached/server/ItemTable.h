@@ -0,0 +1,57 @@
+#ifndef MUDUO_EXAMPLES_MEMCACHED_SERVER_ITEMTABLE_H
+#define MUDUO_EXAMPLES_MEMCACHED_SERVER_ITEMTABLE_H
+
+#include "Item.h"
+
+#include <muduo/base/Mutex.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <vector>
+
+class EpochReclaimer;
+
+// One shard of the hash table of items, open addressing with linear probing.
+//
+// find() takes no lock, it must run inside an EpochReclaimer::Guard and
+// take its own reference before leaving the guard.  All modifications
+// are made with mutex() held.  Items are never changed in place: a slot
+// is published with a release store after the item is fully built, and
+// what a writer takes out of the table must be retired to the reclaimer,
+// instead of released, as a reader may still be looking at it.
+class ItemTable : boost::noncopyable
+{
+ public:
+  ItemTable();
+  ~ItemTable();  // releases all items
+
+  const Item* find(StringPiece key, size_t hash) const;
+
+  // following must be called with mutex() held
+
+  // the key must not be in table; old slots are retired to reclaimer
+  void insert(const ConstItemPtr& item, EpochReclaimer* reclaimer);
+  // oldItem must be in table, returns the reference held by table
+  ConstItemPtr replace(const Item* oldItem, const ConstItemPtr& newItem);
+  // returns NULL if item is not in table
+  ConstItemPtr remove(const Item* item);
+  void removeExpired(int now, std::vector<ConstItemPtr>* expired);
+
+  size_t size() const { return size_; }
+  muduo::MutexLock& mutex() const { return mutex_; }
+
+ private:
+  struct Slots;
+
+  static Slots* newSlots(int bits);
+  static size_t indexOf(const Slots* slots, size_t hash);
+  size_t slotOf(const Item* item) const;
+  void rehash(EpochReclaimer* reclaimer);
+
+  Slots* slots_;  // written with mutex_ held, read lock free
+  size_t size_;   // live items
+  size_t used_;   // live items and tombstones
+  mutable muduo::MutexLock mutex_;
+};
+
+#endif  // MUDUO_EXAMPLES_MEMCACHED_SERVER_ITEMTABLE_H
@@ -0,0 +1,303 @@
+#undef NDEBUG
+#include "EpochReclaimer.h"
+#include "ItemTable.h"
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/CurrentThread.h>
+#include <muduo/base/Thread.h>
+#include <muduo/base/Timestamp.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace muduo;
+
+namespace
+{
+
+// the value repeats the key, so a reader can tell a torn item.
+ItemPtr newItem(const string& key, int exptime = 0)
+{
+  ItemPtr item(Item::makeItem(key, 0, exptime, static_cast<int>(key.size()) + 2, 1));
+  item->append(key.data(), key.size());
+  item->append("\r\n", 2);
+  assert(item->endsWithCRLF());
+  return item;
+}
+
+string keyOf(int i)
+{
+  char buf[32];
+  snprintf(buf, sizeof buf, "key%d", i);
+  return buf;
+}
+
+const Item* find(const ItemTable& table, const string& key)
+{
+  return table.find(key, Item::hashKey(key));
+}
+
+void testInsertReplaceRemove()
+{
+  EpochReclaimer reclaimer;
+  ItemTable table;
+  std::vector<ItemPtr> items;
+  MutexLockGuard lock(table.mutex());
+  for (int i = 0; i < 1000; ++i)
+  {
+    items.push_back(newItem(keyOf(i)));
+    table.insert(items.back(), &reclaimer);
+    assert(items.back()->refCount() == 2);
+  }
+  assert(table.size() == 1000);
+  for (int i = 0; i < 1000; ++i)
+  {
+    assert(find(table, keyOf(i)) == get_pointer(items[i]));
+  }
+  assert(find(table, "nokey") == NULL);
+
+  // replace gives back the reference held by table
+  for (int i = 0; i < 1000; i += 2)
+  {
+    ItemPtr fresh(newItem(keyOf(i)));
+    ConstItemPtr old(table.replace(get_pointer(items[i]), fresh));
+    assert(get_pointer(old) == get_pointer(items[i]));
+    assert(find(table, keyOf(i)) == get_pointer(fresh));
+    old.reset();
+    assert(items[i]->refCount() == 1);
+    items[i] = fresh;
+  }
+  assert(table.size() == 1000);
+
+  for (int i = 0; i < 1000; i += 3)
+  {
+    ConstItemPtr removed(table.remove(get_pointer(items[i])));
+    assert(get_pointer(removed) == get_pointer(items[i]));
+    assert(find(table, keyOf(i)) == NULL);
+    assert(!table.remove(get_pointer(items[i])));
+  }
+  assert(table.size() == 1000 - 334);
+  for (int i = 0; i < 1000; ++i)
+  {
+    assert((find(table, keyOf(i)) != NULL) == (i % 3 != 0));
+  }
+}
+
+// Probing goes past tombstones, a rehash drops them and retires the
+// old slots instead of freeing them.
+void testRehashWithTombstones()
+{
+  EpochReclaimer reclaimer;
+  ItemTable table;
+  MutexLockGuard lock(table.mutex());
+  std::vector<ItemPtr> live;
+  for (int i = 0; i < 10000; ++i)
+  {
+    ItemPtr item(newItem(keyOf(i)));
+    table.insert(item, &reclaimer);
+    live.push_back(item);
+    if (live.size() > 8)
+    {
+      // keeps a few, the rest become tombstones
+      assert(table.remove(get_pointer(live.front())));
+      assert(find(table, live.front()->key().as_string()) == NULL);
+      live.erase(live.begin());
+    }
+    for (size_t j = 0; j < live.size(); ++j)
+    {
+      assert(find(table, live[j]->key().as_string()) == get_pointer(live[j]));
+    }
+  }
+  assert(table.size() == live.size());
+  assert(reclaimer.numRetired() > 0);
+  reclaimer.reclaim();
+  assert(reclaimer.numRetired() == 0);
+}
+
+void holdGuard(EpochReclaimer* reclaimer, CountDownLatch* entered, CountDownLatch* leave)
+{
+  EpochReclaimer::Guard guard(*reclaimer);
+  entered->countDown();
+  leave->wait();
+}
+
+void testReclaimWithGuard()
+{
+  EpochReclaimer reclaimer;
+  ItemPtr item(newItem("guarded"));
+
+  // a reader in another thread entered before the item is retired
+  CountDownLatch entered(1);
+  CountDownLatch leave(1);
+  Thread reader(boost::bind(holdGuard, &reclaimer, &entered, &leave), "reader");
+  reader.start();
+  entered.wait();
+  reclaimer.retire(item);
+  reclaimer.reclaim();
+  assert(reclaimer.numRetired() == 1);
+  assert(item->refCount() == 2);
+  leave.countDown();
+  reader.join();
+  reclaimer.reclaim();
+  assert(reclaimer.numRetired() == 0);
+  assert(item->refCount() == 1);
+
+  // nested Guards of this thread, the item waits for the outer one
+  {
+  EpochReclaimer::Guard outer(reclaimer);
+  {
+  EpochReclaimer::Guard inner(reclaimer);
+  reclaimer.retire(item);
+  }
+  reclaimer.reclaim();
+  assert(reclaimer.numRetired() == 1);
+  }
+  reclaimer.reclaim();
+  assert(reclaimer.numRetired() == 0);
+  assert(item->refCount() == 1);
+}
+
+// Readers look keys up without locks while a writer inserts, replaces
+// and removes them, and a crawler removes the expired ones.
+const int kKeys = 512;
+const double kSeconds = 1.0;
+
+struct Shared : boost::noncopyable
+{
+  EpochReclaimer reclaimer;
+  ItemTable table;
+  AtomicInt32 stop;
+  AtomicInt64 reads;
+  AtomicInt64 hits;
+  AtomicInt64 writes;
+  AtomicInt64 expired;
+  AtomicInt32 now;  // seconds of the crawler
+};
+
+void reader(Shared* shared)
+{
+  unsigned seed = static_cast<unsigned>(CurrentThread::tid());
+  while (shared->stop.get() == 0)
+  {
+    string key(keyOf(rand_r(&seed) % kKeys));
+    ConstItemPtr item;
+    {
+    EpochReclaimer::Guard guard(shared->reclaimer);
+    const Item* found = find(shared->table, key);
+    if (found)
+    {
+      assert(found->key() == key);
+      item.reset(found);  // own reference, taken inside the guard
+    }
+    }
+    if (item)
+    {
+      assert(StringPiece(item->value(), static_cast<int>(item->valueLength()) - 2) == key);
+      shared->hits.increment();
+    }
+    shared->reads.increment();
+  }
+}
+
+void writer(Shared* shared)
+{
+  unsigned seed = static_cast<unsigned>(CurrentThread::tid());
+  while (shared->stop.get() == 0)
+  {
+    string key(keyOf(rand_r(&seed) % kKeys));
+    // some items expire at the crawler's next second
+    ItemPtr item(newItem(key, rand_r(&seed) % 4 == 0 ? shared->now.get() + 1 : 0));
+    ConstItemPtr old;
+    {
+    MutexLockGuard lock(shared->table.mutex());
+    const Item* found = find(shared->table, key);
+    if (found == NULL)
+    {
+      shared->table.insert(item, &shared->reclaimer);
+    }
+    else if (rand_r(&seed) % 2)
+    {
+      old = shared->table.replace(found, item);
+    }
+    else
+    {
+      old = shared->table.remove(found);
+    }
+    }
+    if (old)
+    {
+      shared->reclaimer.retire(old);
+    }
+    shared->writes.increment();
+  }
+}
+
+void crawler(Shared* shared)
+{
+  while (shared->stop.get() == 0)
+  {
+    std::vector<ConstItemPtr> expired;
+    {
+    MutexLockGuard lock(shared->table.mutex());
+    shared->table.removeExpired(shared->now.incrementAndGet(), &expired);
+    }
+    for (size_t i = 0; i < expired.size(); ++i)
+    {
+      shared->reclaimer.retire(expired[i]);
+    }
+    shared->expired.add(static_cast<int64_t>(expired.size()));
+    shared->reclaimer.reclaim();
+  }
+}
+
+void testConcurrent()
+{
+  Shared shared;
+  boost::ptr_vector<Thread> threads;
+  for (int i = 0; i < 3; ++i)
+  {
+    threads.push_back(new Thread(boost::bind(reader, &shared), "reader"));
+  }
+  threads.push_back(new Thread(boost::bind(writer, &shared), "writer"));
+  threads.push_back(new Thread(boost::bind(crawler, &shared), "crawler"));
+  for (size_t i = 0; i < threads.size(); ++i)
+  {
+    threads[i].start();
+  }
+  Timestamp start(Timestamp::now());
+  while (timeDifference(Timestamp::now(), start) < kSeconds)
+  {
+    ::usleep(10 * 1000);
+  }
+  shared.stop.getAndSet(1);
+  for (size_t i = 0; i < threads.size(); ++i)
+  {
+    threads[i].join();
+  }
+  shared.reclaimer.reclaim();
+  assert(shared.reclaimer.numRetired() == 0);
+  printf("reads %lld hits %lld writes %lld expired %lld\n",
+         static_cast<long long>(shared.reads.get()),
+         static_cast<long long>(shared.hits.get()),
+         static_cast<long long>(shared.writes.get()),
+         static_cast<long long>(shared.expired.get()));
+  assert(shared.reads.get() > 0 && shared.hits.get() > 0);
+  assert(shared.writes.get() > 0 && shared.expired.get() > 0);
+}
+
+}
+
+int main()
+{
+  testInsertReplaceRemove();
+  testRehashWithTombstones();
+  testReclaimWithGuard();
+  testConcurrent();
+  printf("All tests passed\n");
+}
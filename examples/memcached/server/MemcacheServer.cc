@@ -1,16 +1,22 @@
 #include "MemcacheServer.h"
 
 #include <muduo/base/Atomic.h>
+#include <muduo/base/CountDownLatch.h>
 #include <muduo/base/Logging.h>
 #include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopThreadPool.h>
 
 #include <boost/bind.hpp>
 
+#include <algorithm>
+
 using namespace muduo;
 using namespace muduo::net;
 
 muduo::AtomicInt64 g_cas;
 
+const double MemcacheServer::kCrawlInterval = 0.1;
+
 MemcacheServer::Options::Options()
 {
   bzero(this, sizeof(*this));
@@ -24,6 +30,10 @@ MemcacheServer::MemcacheServer(muduo::net::EventLoop* loop, const Options& optio
   : loop_(loop),
     options_(options),
     startTime_(::time(NULL)-1),
+    slabs_(static_cast<size_t>(options.memoryMB) * 1024 * 1024,
+           Item::totalSize(Session::kLongestKeySize, kMaxValueSize + 2)),
+    crawlShard_(0),
+    crawlReclaimed_(0),
     server_(loop, InetAddress(options.tcpport), "muduo-memcached"),
     stats_(new Stats)
 {
@@ -31,13 +41,46 @@ MemcacheServer::MemcacheServer(muduo::net::EventLoop* loop, const Options& optio
       boost::bind(&MemcacheServer::onConnection, this, _1));
 }
 
+namespace
+{
+void stopListener(UdpListener* listener, CountDownLatch* latch)
+{
+  listener->stop();
+  latch->countDown();
+}
+}
+
 MemcacheServer::~MemcacheServer()
 {
+  loop_->cancel(crawlTimer_);
+  // listeners call back into this, wait until none of them can.
+  // IO loops are still running, they are stopped with server_.
+  CountDownLatch latch(static_cast<int>(udpListeners_.size()));
+  for (size_t i = 0; i < udpListeners_.size(); ++i)
+  {
+    udpListeners_[i]->loop()->runInLoop(
+        boost::bind(stopListener, get_pointer(udpListeners_[i]), &latch));
+  }
+  latch.wait();
 }
 
 void MemcacheServer::start()
 {
   server_.start();
+  if (options_.udpport != 0)
+  {
+    std::vector<EventLoop*> loops = server_.threadPool()->getAllLoops();
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+      UdpListenerPtr listener(new UdpListener(this, loops[i], options_.udpport));
+      loops[i]->runInLoop(boost::bind(&UdpListener::start, listener));
+      udpListeners_.push_back(listener);
+    }
+    LOG_INFO << "serving UDP port " << options_.udpport
+             << " in " << loops.size() << " loops";
+  }
+  crawlTimer_ = loop_->runEvery(kCrawlInterval,
+                                boost::bind(&MemcacheServer::crawlExpired, this));
 }
 
 void MemcacheServer::stop()
@@ -45,22 +88,98 @@ void MemcacheServer::stop()
   loop_->runAfter(3.0, boost::bind(&EventLoop::quit, loop_));
 }
 
+ItemPtr MemcacheServer::makeItem(StringPiece key,
+                                 uint32_t flags,
+                                 int exptime,
+                                 int valuelen,
+                                 uint64_t cas)
+{
+  int cls = slabs_.slabClass(Item::totalSize(key.size(), valuelen));
+  if (cls < 0)
+  {
+    return ItemPtr();
+  }
+
+  const int kMaxTries = 10;
+  for (int i = 0; i < kMaxTries; ++i)
+  {
+    void* chunk = slabs_.allocate(cls);
+    if (chunk)
+    {
+      return Item::makeItem(chunk, &slabs_, cls, key, flags, exptime, valuelen, cas);
+    }
+    // frees its chunk once no reader can see it, unless it's being sent
+    ConstItemPtr victim(slabs_.evict(cls, boost::bind(&MemcacheServer::removeIfPresent, this, _1)));
+    if (victim)
+    {
+      reclaimer_.retire(victim);
+      reclaimer_.reclaim();
+    }
+    else if (slabs_.stats(cls).items == 0)
+    {
+      break;
+    }
+  }
+  LOG_WARN << "MemcacheServer::makeItem - out of memory for " << valuelen << " bytes";
+  return ItemPtr();
+}
+
+// same as realtime() in memcached.c
+int MemcacheServer::relativeTime(time_t exptime) const
+{
+  const time_t kMaxDelta = 60*60*24*30;
+  if (exptime == 0)
+  {
+    return 0;
+  }
+  else if (exptime < 0)
+  {
+    return 1;  // already expired, as currentTime() >= 1
+  }
+  else if (exptime > kMaxDelta)
+  {
+    // absolute unix time
+    return exptime <= startTime_ ? 1 : static_cast<int>(exptime - startTime_);
+  }
+  else
+  {
+    return static_cast<int>(exptime) + currentTime();
+  }
+}
+
 bool MemcacheServer::storeItem(const ItemPtr& item, const Item::UpdatePolicy policy, bool* exists)
 {
   assert(item->neededBytes() == 0);
-  MutexLock& mutex = shards_[item->hash() % kShards].mutex;
-  ItemMap& items = shards_[item->hash() % kShards].items;
-  MutexLockGuard lock(mutex);
-  ItemMap::const_iterator it = items.find(item);
-  *exists = it != items.end();
+  if (policy == Item::kAppend || policy == Item::kPrepend)
+  {
+    return appendItem(item, policy, exists);
+  }
+
+  const int now = currentTime();
+  ConstItemPtr oldItem;  // retired after unlocking, see SlabAllocator
+  ConstItemPtr expired;
+  bool stored = true;
+  {
+  ItemTable& table = shards_[item->hash() % kShards];
+  MutexLockGuard lock(table.mutex());
+  const Item* it = table.find(item->key(), item->hash());
+  if (it != NULL && it->isExpired(now))
+  {
+    expired = table.remove(it);
+    it = NULL;
+  }
+  *exists = it != NULL;
   if (policy == Item::kSet)
   {
     item->setCas(g_cas.incrementAndGet());
     if (*exists)
     {
-      items.erase(it);
+      oldItem = table.replace(it, item);
+    }
+    else
+    {
+      table.insert(item, &reclaimer_);
     }
-    items.insert(item);
   }
   else
   {
@@ -68,12 +187,12 @@ bool MemcacheServer::storeItem(const ItemPtr& item, const Item::UpdatePolicy pol
     {
       if (*exists)
       {
-        return false;
+        stored = false;
       }
       else
       {
         item->setCas(g_cas.incrementAndGet());
-        items.insert(item);
+        table.insert(item, &reclaimer_);
       }
     }
     else if (policy == Item::kReplace)
@@ -81,56 +200,23 @@ bool MemcacheServer::storeItem(const ItemPtr& item, const Item::UpdatePolicy pol
       if (*exists)
       {
         item->setCas(g_cas.incrementAndGet());
-        items.erase(it);
-        items.insert(item);
-      }
-      else
-      {
-        return false;
-      }
-    }
-    else if (policy == Item::kAppend || policy == Item::kPrepend)
-    {
-      if (*exists)
-      {
-        const ConstItemPtr& oldItem = *it;
-        int newLen = static_cast<int>(item->valueLength() + oldItem->valueLength() - 2);
-        ItemPtr newItem(Item::makeItem(item->key(),
-                                       oldItem->flags(),
-                                       oldItem->rel_exptime(),
-                                       newLen,
-                                       g_cas.incrementAndGet()));
-        if (policy == Item::kAppend)
-        {
-          newItem->append(oldItem->value(), oldItem->valueLength() - 2);
-          newItem->append(item->value(), item->valueLength());
-        }
-        else
-        {
-          newItem->append(item->value(), item->valueLength() - 2);
-          newItem->append(oldItem->value(), oldItem->valueLength());
-        }
-        assert(newItem->neededBytes() == 0);
-        assert(newItem->endsWithCRLF());
-        items.erase(it);
-        items.insert(newItem);
+        oldItem = table.replace(it, item);
       }
       else
       {
-        return false;
+        stored = false;
       }
     }
     else if (policy == Item::kCas)
     {
-      if (*exists && (*it)->cas() == item->cas())
+      if (*exists && it->cas() == item->cas())
       {
         item->setCas(g_cas.incrementAndGet());
-        items.erase(it);
-        items.insert(item);
+        oldItem = table.replace(it, item);
       }
       else
       {
-        return false;
+        stored = false;
       }
     }
     else
@@ -138,24 +224,245 @@ bool MemcacheServer::storeItem(const ItemPtr& item, const Item::UpdatePolicy pol
       assert(false);
     }
   }
-  return true;
+  }
+
+  // the expired item is gone even if nothing is stored
+  retire(expired);
+  retire(oldItem);
+  if (stored)
+  {
+    slabs_.link(get_pointer(item), now);
+  }
+  return stored;
 }
 
-ConstItemPtr MemcacheServer::getItem(const ConstItemPtr& key) const
+// The new item is allocated without holding the shard mutex, as
+// allocation may evict, so retry if the old item was changed meanwhile.
+// Gives up with NOT_STORED if it keeps losing the race.
+bool MemcacheServer::appendItem(const ItemPtr& item, const Item::UpdatePolicy policy, bool* exists)
 {
-  MutexLock& mutex = shards_[key->hash() % kShards].mutex;
-  const ItemMap& items = shards_[key->hash() % kShards].items;
-  MutexLockGuard lock(mutex);
-  ItemMap::const_iterator it = items.find(key);
-  return it != items.end() ? *it : ConstItemPtr();
+  const int kMaxRetries = 16;
+  for (int retry = 0; retry < kMaxRetries; ++retry)
+  {
+    ConstItemPtr oldItem(getItem(item));
+    *exists = oldItem.get() != NULL;
+    if (!oldItem)
+    {
+      return false;
+    }
+
+    int newLen = static_cast<int>(item->valueLength() + oldItem->valueLength() - 2);
+    ItemPtr newItem(makeItem(item->key(),
+                             oldItem->flags(),
+                             oldItem->rel_exptime(),
+                             newLen,
+                             0));
+    if (!newItem)
+    {
+      return false;
+    }
+    if (policy == Item::kAppend)
+    {
+      newItem->append(oldItem->value(), oldItem->valueLength() - 2);
+      newItem->append(item->value(), item->valueLength());
+    }
+    else
+    {
+      newItem->append(item->value(), item->valueLength() - 2);
+      newItem->append(oldItem->value(), oldItem->valueLength());
+    }
+    assert(newItem->neededBytes() == 0);
+    assert(newItem->endsWithCRLF());
+
+    ConstItemPtr replaced;
+    {
+    ItemTable& table = shards_[item->hash() % kShards];
+    MutexLockGuard lock(table.mutex());
+    if (table.find(item->key(), item->hash()) == get_pointer(oldItem))
+    {
+      newItem->setCas(g_cas.incrementAndGet());
+      replaced = table.replace(get_pointer(oldItem), newItem);
+    }
+    }
+
+    if (replaced)
+    {
+      retire(replaced);
+      slabs_.link(get_pointer(newItem), currentTime());
+      return true;
+    }
+  }
+  LOG_WARN << "MemcacheServer::appendItem - gave up after " << kMaxRetries
+           << " concurrent updates of " << item->key();
+  return false;
+}
+
+ConstItemPtr MemcacheServer::getItem(const ConstItemPtr& key)
+{
+  const int now = currentTime();
+  ConstItemPtr item;
+  {
+  EpochReclaimer::Guard guard(reclaimer_);
+  item = shards_[key->hash() % kShards].find(key->key(), key->hash());
+  }
+  if (item)
+  {
+    if (item->isExpired(now))
+    {
+      // lazy expiry
+      retire(removeIfPresent(get_pointer(item)));
+      item.reset();
+    }
+    else
+    {
+      slabs_.touch(get_pointer(item), now);
+    }
+  }
+  return item;
+}
+
+namespace
+{
+struct ShardLess
+{
+  explicit ShardLess(size_t shards)
+    : shards_(shards)
+  {
+  }
+
+  bool operator()(const ItemKey& x, const ItemKey& y) const
+  {
+    return x.hash % shards_ < y.hash % shards_;
+  }
+
+  size_t shards_;
+};
+}
+
+void MemcacheServer::getItems(std::vector<ItemKey>* keys, std::vector<ConstItemPtr>* items)
+{
+  const int now = currentTime();
+  std::vector<ItemKey>& k = *keys;
+  items->assign(k.size(), ConstItemPtr());
+  for (size_t i = 0; i < k.size(); ++i)
+  {
+    k[i].hash = Item::hashKey(k[i].key);
+    k[i].index = static_cast<int>(i);
+  }
+  std::sort(k.begin(), k.end(), ShardLess(kShards));
+
+  {
+  EpochReclaimer::Guard guard(reclaimer_);
+  for (size_t i = 0; i < k.size(); ++i)
+  {
+    (*items)[k[i].index] = shards_[k[i].hash % kShards].find(k[i].key, k[i].hash);
+  }
+  }
+
+  std::vector<ConstItemPtr> expired;  // lazy expiry, retired after unlocking
+  for (size_t i = 0; i < k.size(); )
+  {
+    const size_t shard = k[i].hash % kShards;
+    size_t end = i;
+    bool anyExpired = false;
+    for (; end < k.size() && k[end].hash % kShards == shard; ++end)
+    {
+      const ConstItemPtr& item = (*items)[k[end].index];
+      anyExpired = anyExpired || (item && item->isExpired(now));
+    }
+    if (anyExpired)
+    {
+      ItemTable& table = shards_[shard];
+      MutexLockGuard lock(table.mutex());
+      for (; i < end; ++i)
+      {
+        ConstItemPtr& item = (*items)[k[i].index];
+        if (item && item->isExpired(now))
+        {
+          expired.push_back(table.remove(get_pointer(item)));
+          item.reset();
+        }
+      }
+    }
+    i = end;
+  }
+  for (size_t i = 0; i < expired.size(); ++i)
+  {
+    retire(expired[i]);
+  }
+
+  for (size_t i = 0; i < items->size(); ++i)
+  {
+    if ((*items)[i])
+    {
+      slabs_.touch(get_pointer((*items)[i]), now);
+    }
+  }
 }
 
 bool MemcacheServer::deleteItem(const ConstItemPtr& key)
 {
-  MutexLock& mutex = shards_[key->hash() % kShards].mutex;
-  ItemMap& items = shards_[key->hash() % kShards].items;
-  MutexLockGuard lock(mutex);
-  return items.erase(key) == 1;
+  ConstItemPtr oldItem;
+  {
+  ItemTable& table = shards_[key->hash() % kShards];
+  MutexLockGuard lock(table.mutex());
+  const Item* it = table.find(key->key(), key->hash());
+  if (it != NULL)
+  {
+    oldItem = table.remove(it);
+  }
+  }
+  retire(oldItem);
+  return oldItem.get() != NULL && !oldItem->isExpired(currentTime());
+}
+
+// Visits a few shards per tick, so that a shard mutex is held for one
+// shard only and IO threads barely notice.
+void MemcacheServer::crawlExpired()
+{
+  const int now = currentTime();
+  std::vector<ConstItemPtr> expired;
+  for (int i = 0; i < kCrawlShardsPerTick; ++i)
+  {
+    ItemTable& table = shards_[crawlShard_];
+    {
+    MutexLockGuard lock(table.mutex());
+    table.removeExpired(now, &expired);
+    }
+    if (++crawlShard_ == kShards)
+    {
+      crawlShard_ = 0;
+      LOG_DEBUG << "expiry crawler reclaimed " << crawlReclaimed_ << " items";
+      crawlReclaimed_ = 0;
+    }
+  }
+
+  for (size_t i = 0; i < expired.size(); ++i)
+  {
+    retire(expired[i]);
+  }
+  crawlReclaimed_ += static_cast<int64_t>(expired.size());
+  // also frees what lazy expiry and deletes left, when readers are gone
+  reclaimer_.reclaim();
+}
+
+// called by SlabAllocator::evict() with the slab class mutex held
+ConstItemPtr MemcacheServer::removeIfPresent(const Item* item)
+{
+  ItemTable& table = shards_[item->hash() % kShards];
+  MutexLockGuard lock(table.mutex());
+  return table.remove(item);
+}
+
+// Unlinks an item taken out of table, its chunk goes back to slabs
+// after readers which might have found it are gone.
+void MemcacheServer::retire(const ConstItemPtr& item)
+{
+  if (item)
+  {
+    slabs_.unlink(get_pointer(item));
+    reclaimer_.retire(item);
+  }
 }
 
 void MemcacheServer::onConnection(const TcpConnectionPtr& conn)
@@ -1,17 +1,21 @@
 #ifndef MUDUO_EXAMPLES_MEMCACHED_SERVER_MEMCACHESERVER_H
 #define MUDUO_EXAMPLES_MEMCACHED_SERVER_MEMCACHESERVER_H
 
+#include "EpochReclaimer.h"
 #include "Item.h"
+#include "ItemTable.h"
 #include "Session.h"
+#include "SlabAllocator.h"
+#include "UdpListener.h"
 
 #include <muduo/base/Mutex.h>
 #include <muduo/net/TcpServer.h>
+#include <muduo/net/TimerId.h>
 #include <examples/wordcount/hash.h>
 
 #include <boost/array.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/unordered_map.hpp>
-#include <boost/unordered_set.hpp>
 
 class MemcacheServer : boost::noncopyable
 {
@@ -23,8 +27,11 @@ class MemcacheServer : boost::noncopyable
     uint16_t udpport;
     uint16_t gperfport;
     int threads;
+    int memoryMB;  // 0 means no limit
   };
 
+  static const int kMaxValueSize = 1024*1024;
+
   MemcacheServer(muduo::net::EventLoop* loop, const Options&);
   ~MemcacheServer();
 
@@ -33,55 +40,65 @@ class MemcacheServer : boost::noncopyable
   void stop();
 
   time_t startTime() const { return startTime_; }
+  // seconds since startTime()
+  int currentTime() const { return static_cast<int>(::time(NULL) - startTime_); }
+  // converts exptime of protocol to seconds since startTime(), 0 for never
+  int relativeTime(time_t exptime) const;
+
+  // Allocates from slabs, evicting least recently used items if needed.
+  // Returns NULL if the item is too large or no memory can be freed.
+  ItemPtr makeItem(StringPiece key,
+                   uint32_t flags,
+                   int exptime,
+                   int valuelen,
+                   uint64_t cas);
 
   bool storeItem(const ItemPtr& item, Item::UpdatePolicy policy, bool* exists);
-  ConstItemPtr getItem(const ConstItemPtr& key) const;
+  ConstItemPtr getItem(const ConstItemPtr& key);  // removes expired item
+  // Looks up many keys without taking any lock, grouped by shard, so
+  // expired ones are removed with one lock per shard.
+  // (*items)[i] is the item of i-th key, or NULL.  Reorders *keys.
+  void getItems(std::vector<ItemKey>* keys, std::vector<ConstItemPtr>* items);
   bool deleteItem(const ConstItemPtr& key);
 
+  const SlabAllocator& slabs() const { return slabs_; }
+
  private:
   void onConnection(const muduo::net::TcpConnectionPtr& conn);
+  bool appendItem(const ItemPtr& item, Item::UpdatePolicy policy, bool* exists);
+  ConstItemPtr removeIfPresent(const Item* item);
+  void retire(const ConstItemPtr& item);
+  void crawlExpired();
 
   struct Stats;
 
   muduo::net::EventLoop* loop_;  // not own
   Options options_;
   const time_t startTime_;
+  // destructs after everything holding items
+  SlabAllocator slabs_;
 
   mutable muduo::MutexLock mutex_;
   boost::unordered_map<string, SessionPtr> sessions_;
 
-  // a complicated solution to save memory
-  struct Hash
-  {
-    size_t operator()(const ConstItemPtr& x) const
-    {
-      return x->hash();
-    }
-  };
-
-  struct Equal
-  {
-    bool operator()(const ConstItemPtr& x, const ConstItemPtr& y) const
-    {
-      return x->key() == y->key();
-    }
-  };
-
-  typedef boost::unordered_set<ConstItemPtr, Hash, Equal> ItemMap;
-
-  struct MapWithLock
-  {
-    ItemMap items;
-    mutable muduo::MutexLock mutex;
-  };
-
   const static int kShards = 4096;
-
-  boost::array<MapWithLock, kShards> shards_;
+  // expiry crawler visits kShards in 6.4 seconds
+  const static int kCrawlShardsPerTick = 64;
+  static const double kCrawlInterval;
+
+  // readers of shards_ take no lock, see ItemTable
+  EpochReclaimer reclaimer_;
+  boost::array<ItemTable, kShards> shards_;
+  // only accessed in loop_
+  muduo::net::TimerId crawlTimer_;
+  int crawlShard_;
+  int64_t crawlReclaimed_;
 
   // NOT guarded by mutex_, but here because server_ has to destructs before
   // sessions_
   muduo::net::TcpServer server_;
+  // one for each IO loop, if options_.udpport != 0
+  std::vector<UdpListenerPtr> udpListeners_;
   boost::scoped_ptr<Stats> stats_;
 };
 
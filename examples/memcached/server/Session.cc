@@ -1,6 +1,10 @@
 #include "Session.h"
 #include "MemcacheServer.h"
 
+#include <muduo/net/Endian.h>
+
+#include <limits>
+
 #ifdef HAVE_TCMALLOC
 #include <gperftools/malloc_extension.h>
 #endif
@@ -13,63 +17,111 @@ static bool isBinaryProtocol(uint8_t firstByte)
   return firstByte == 0x80;
 }
 
-const int kLongestKeySize = 250;
+const int Session::kLongestKeySize;
 string Session::kLongestKey(kLongestKeySize, 'x');
 
-template <typename InputIterator, typename Token>
-bool Session::SpaceSeparator::operator()(InputIterator& next, InputIterator end, Token& tok)
+namespace
 {
-  while (next != end && *next == ' ')
-    ++next;
-  if (next == end)
-  {
-    tok.clear();
-    return false;
-  }
-  InputIterator start(next);
-  const char* sp = static_cast<const char*>(memchr(start, ' ', end - start));
-  if (sp)
-  {
-    tok.set(start, static_cast<int>(sp - start));
-    next = sp;
-  }
-  else
+// Decimal digits only, within token and the range of T.  A leading '-' is
+// accepted for signed T only, eg. a negative exptime.
+template<typename T>
+bool parseNumber(StringPiece token, T* val)
+{
+  const char* p = token.begin();
+  const char* const end = token.end();
+  bool negative = false;
+  if (std::numeric_limits<T>::is_signed && p != end && *p == '-')
   {
-    tok.set(start, static_cast<int>(end - next));
-    next = end;
+    negative = true;
+    ++p;
   }
-  return true;
-}
-
-struct Session::Reader
-{
-  Reader(Tokenizer::iterator& beg, Tokenizer::iterator end)
-      : first_(beg),
-        last_(end)
+  if (p == end)
   {
+    return false;
   }
 
-  template<typename T>
-  bool read(T* val)
+  const uint64_t limit = static_cast<uint64_t>(std::numeric_limits<T>::max()) + (negative ? 1 : 0);
+  uint64_t x = 0;
+  for (; p != end; ++p)
   {
-    if (first_ == last_)
+    if (*p < '0' || *p > '9')
+    {
       return false;
-    char* end = NULL;
-    uint64_t x = strtoull((*first_).data(), &end, 10);
-    if (end == (*first_).end())
+    }
+    uint64_t digit = static_cast<uint64_t>(*p - '0');
+    if (x > (limit - digit) / 10)
     {
-      *val = static_cast<T>(x);
-      ++first_;
-      return true;
+      return false;
     }
-    return false;
+    x = x * 10 + digit;
   }
+  *val = static_cast<T>(negative ? 0 - x : x);
+  return true;
+}
+
+// memcached binary protocol, see protocol_binary.h of memcached
+const size_t kBinaryHeaderLen = 24;
+const uint8_t kRequestMagic = 0x80;
+const uint8_t kResponseMagic = 0x81;
 
- private:
-  Tokenizer::iterator first_;
-  Tokenizer::iterator last_;;
+enum BinaryOpcode
+{
+  kGet = 0x00,
+  kSet = 0x01,
+  kAdd = 0x02,
+  kReplace = 0x03,
+  kDelete = 0x04,
+  kQuit = 0x07,
+  kGetQ = 0x09,
+  kNoop = 0x0a,
+  kVersion = 0x0b,
+  kGetK = 0x0c,
+  kGetKQ = 0x0d,
+  kAppend = 0x0e,
+  kPrepend = 0x0f,
+  kSetQ = 0x11,
+  kAddQ = 0x12,
+  kReplaceQ = 0x13,
+  kDeleteQ = 0x14,
+  kQuitQ = 0x17,
+  kAppendQ = 0x19,
+  kPrependQ = 0x1a,
+};
+
+enum BinaryStatus
+{
+  kSuccess = 0x00,
+  kKeyNotFound = 0x01,
+  kKeyExists = 0x02,
+  kTooLarge = 0x03,
+  kInvalidArguments = 0x04,
+  kNotStored = 0x05,
+  kUnknownCommand = 0x81,
+  kOutOfMemory = 0x82,
 };
 
+uint16_t readUint16(const char* p)
+{
+  uint16_t be16 = 0;
+  ::memcpy(&be16, p, sizeof be16);
+  return sockets::networkToHost16(be16);
+}
+
+uint32_t readUint32(const char* p)
+{
+  uint32_t be32 = 0;
+  ::memcpy(&be32, p, sizeof be32);
+  return sockets::networkToHost32(be32);
+}
+
+uint64_t readUint64(const char* p)
+{
+  uint64_t be64 = 0;
+  ::memcpy(&be64, p, sizeof be64);
+  return sockets::networkToHost64(be64);
+}
+}
+
 void Session::onMessage(const muduo::net::TcpConnectionPtr& conn,
                         muduo::net::Buffer* buf,
                         muduo::Timestamp)
@@ -90,7 +142,10 @@ void Session::onMessage(const muduo::net::TcpConnectionPtr& conn,
       assert(protocol_ == kAscii || protocol_ == kBinary);
       if (protocol_ == kBinary)
       {
-        // FIXME
+        if (!processBinaryRequest(buf))
+        {
+          break;
+        }
       }
       else  // ASCII protocol
       {
@@ -131,6 +186,12 @@ void Session::onMessage(const muduo::net::TcpConnectionPtr& conn,
     }
   }
   bytesRead_ += initialReadable - buf->readableBytes();
+
+  // binary responses of one batch of requests, eg. pipelined quiet gets
+  if (outputBuf_.readableBytes() > 0)
+  {
+    conn_->send(&outputBuf_);
+  }
 }
 
 void Session::receiveValue(muduo::net::Buffer* buf)
@@ -140,7 +201,7 @@ void Session::receiveValue(muduo::net::Buffer* buf)
   // if (protocol_ == kBinary)
 
   const size_t avail = std::min(buf->readableBytes(), currItem_->neededBytes());
-  assert(currItem_.unique());
+  assert(currItem_->refCount() == 1);
   currItem_->append(buf->peek(), avail);
   buf->retrieve(avail);
   if (currItem_->neededBytes() == 0)
@@ -200,7 +261,6 @@ void Session::discardValue(muduo::net::Buffer* buf)
 
 bool Session::processRequest(StringPiece request)
 {
-  assert(command_.empty());
   assert(!noreply_);
   assert(policy_ == Item::kInvalid);
   assert(!currItem_);
@@ -218,60 +278,40 @@ bool Session::processRequest(StringPiece request)
     }
   }
 
-  SpaceSeparator sep;
-  Tokenizer tok(request.begin(), request.end(), sep);
-  Tokenizer::iterator beg = tok.begin();
-  if (beg == tok.end())
+  tokenize(request, &tokens_);
+  if (tokens_.empty())
   {
     reply("ERROR\r\n");
     return true;
   }
-  (*beg).CopyToString(&command_);
-  ++beg;
-  if (command_ == "set" || command_ == "add" || command_ == "replace"
-      || command_ == "append" || command_ == "prepend" || command_ == "cas")
+  const StringPiece command = tokens_[0];
+  if (command == "set")
+    policy_ = Item::kSet;
+  else if (command == "add")
+    policy_ = Item::kAdd;
+  else if (command == "replace")
+    policy_ = Item::kReplace;
+  else if (command == "append")
+    policy_ = Item::kAppend;
+  else if (command == "prepend")
+    policy_ = Item::kPrepend;
+  else if (command == "cas")
+    policy_ = Item::kCas;
+
+  if (policy_ != Item::kInvalid)
   {
     // this normally returns false
-    return doUpdate(beg, tok.end());
+    return doUpdate();
   }
-  else if (command_ == "get" || command_ == "gets")
+  else if (command == "get" || command == "gets")
   {
-    bool cas = command_ == "gets";
-
-    // FIXME: send multiple chunks with write complete callback.
-    while (beg != tok.end())
-    {
-      StringPiece key = *beg;
-      bool good = key.size() <= kLongestKeySize;
-      if (!good)
-      {
-        reply("CLIENT_ERROR bad command line format\r\n");
-        return true;
-      }
-
-      needle_->resetKey(key);
-      ConstItemPtr item = owner_->getItem(needle_);
-      ++beg;
-      if (item)
-      {
-        item->output(&outputBuf_, cas);
-      }
-    }
-    outputBuf_.append("END\r\n");
-
-    if (conn_->outputBuffer()->writableBytes() > 65536 + outputBuf_.readableBytes())
-    {
-      LOG_DEBUG << "shrink output buffer from " << conn_->outputBuffer()->internalCapacity();
-      conn_->outputBuffer()->shrink(65536 + outputBuf_.readableBytes());
-    }
-
-    conn_->send(&outputBuf_);
+    doGet(command == "gets");
   }
-  else if (command_ == "delete")
+  else if (command == "delete")
   {
-    doDelete(beg, tok.end());
+    doDelete();
   }
-  else if (command_ == "version")
+  else if (command == "version")
   {
 #ifdef HAVE_TCMALLOC
     reply("VERSION 0.01 muduo with tcmalloc\r\n");
@@ -280,18 +320,18 @@ bool Session::processRequest(StringPiece request)
 #endif
   }
 #ifdef HAVE_TCMALLOC
-  else if (command_ == "memstat")
+  else if (command == "memstat")
   {
     char buf[1024*64];
     MallocExtension::instance()->GetStats(buf, sizeof buf);
     reply(buf);
   }
 #endif
-  else if (command_ == "quit")
+  else if (command == "quit")
   {
     conn_->shutdown();
   }
-  else if (command_ == "shutdown")
+  else if (command == "shutdown")
   {
     // "ERROR: shutdown not enabled"
     conn_->shutdown();
@@ -300,14 +340,76 @@ bool Session::processRequest(StringPiece request)
   else
   {
     reply("ERROR\r\n");
-    LOG_INFO << "Unknown command: " << command_;
+    LOG_INFO << "Unknown command: " << command;
   }
   return true;
 }
 
+// one pass, no allocation once tokens_ has grown to the longest request
+void Session::tokenize(StringPiece request, std::vector<StringPiece>* tokens)
+{
+  tokens->clear();
+  const char* p = request.begin();
+  const char* const end = request.end();
+  while (p < end)
+  {
+    if (*p == ' ')
+    {
+      ++p;
+      continue;
+    }
+    const char* sp = static_cast<const char*>(memchr(p, ' ', end - p));
+    if (sp == NULL)
+    {
+      sp = end;
+    }
+    tokens->push_back(StringPiece(p, static_cast<int>(sp - p)));
+    p = sp;
+  }
+}
+
+void Session::doGet(bool cas)
+{
+  // get <key>+
+  if (tokens_.size() < 2)
+  {
+    reply("ERROR\r\n");
+    return;
+  }
+  keys_.resize(tokens_.size() - 1);
+  for (size_t i = 1; i < tokens_.size(); ++i)
+  {
+    if (tokens_[i].size() > kLongestKeySize)
+    {
+      reply("CLIENT_ERROR bad command line format\r\n");
+      return;
+    }
+    keys_[i-1].key = tokens_[i];
+  }
+
+  owner_->getItems(&keys_, &items_);
+  // FIXME: send multiple chunks with write complete callback.
+  for (size_t i = 0; i < items_.size(); ++i)
+  {
+    if (items_[i])
+    {
+      items_[i]->output(&outputBuf_, cas);
+      items_[i].reset();
+    }
+  }
+  outputBuf_.append("END\r\n");
+
+  if (conn_->outputBuffer()->writableBytes() > 65536 + outputBuf_.readableBytes())
+  {
+    LOG_DEBUG << "shrink output buffer from " << conn_->outputBuffer()->internalCapacity();
+    conn_->outputBuffer()->shrink(65536 + outputBuf_.readableBytes());
+  }
+
+  conn_->send(&outputBuf_);
+}
+
 void Session::resetRequest()
 {
-  command_.clear();
   noreply_ = false;
   policy_ = Item::kInvalid;
   currItem_.reset();
@@ -322,89 +424,74 @@ void Session::reply(muduo::StringPiece msg)
   }
 }
 
-bool Session::doUpdate(Session::Tokenizer::iterator& beg, Session::Tokenizer::iterator end)
+bool Session::doUpdate()
 {
-  if (command_ == "set")
-    policy_ = Item::kSet;
-  else if (command_ == "add")
-    policy_ = Item::kAdd;
-  else if (command_ == "replace")
-    policy_ = Item::kReplace;
-  else if (command_ == "append")
-    policy_ = Item::kAppend;
-  else if (command_ == "prepend")
-    policy_ = Item::kPrepend;
-  else if (command_ == "cas")
-    policy_ = Item::kCas;
-  else
-    assert(false);
-
-  // FIXME: check (beg != end)
-  StringPiece key = (*beg);
-  ++beg;
-  bool good = key.size() <= kLongestKeySize;
+  // <command> <key> <flags> <exptime> <bytes> [<cas unique>]
+  const size_t numTokens = policy_ == Item::kCas ? 6 : 5;
+  bool good = tokens_.size() >= numTokens;
+  StringPiece key = good ? tokens_[1] : StringPiece();
+  good = good && key.size() <= kLongestKeySize;
 
   uint32_t flags = 0;
   time_t exptime = 1;
   int bytes = -1;
   uint64_t cas = 0;
 
-  Reader r(beg, end);
-  good = good && r.read(&flags) && r.read(&exptime) && r.read(&bytes);
+  good = good
+      && parseNumber(tokens_[2], &flags)
+      && parseNumber(tokens_[3], &exptime)
+      && parseNumber(tokens_[4], &bytes);
 
-  int rel_exptime = static_cast<int>(exptime);
-  if (exptime > 60*60*24*30)
-  {
-    rel_exptime = static_cast<int>(exptime - owner_->startTime());
-    if (rel_exptime < 1)
-    {
-      rel_exptime = 1;
-    }
-  }
-  else
-  {
-    // rel_exptime = exptime + currentTime;
-  }
+  int rel_exptime = owner_->relativeTime(exptime);
 
   if (good && policy_ == Item::kCas)
   {
-    good = r.read(&cas);
+    good = parseNumber(tokens_[5], &cas);
   }
 
-  if (!good)
+  if (!good || bytes < 0)
   {
     reply("CLIENT_ERROR bad command line format\r\n");
     return true;
   }
-  if (bytes > 1024*1024)
+  if (bytes <= MemcacheServer::kMaxValueSize)
   {
-    reply("SERVER_ERROR object too large for cache\r\n");
-    needle_->resetKey(key);
-    owner_->deleteItem(needle_);
-    bytesToDiscard_ = bytes + 2;
-    state_ = kDiscardValue;
+    currItem_ = owner_->makeItem(key, flags, rel_exptime, bytes + 2, cas);
+  }
+  if (currItem_)
+  {
+    state_ = kReceiveValue;
     return false;
   }
   else
   {
-    currItem_ = Item::makeItem(key, flags, rel_exptime, bytes + 2, cas);
-    state_ = kReceiveValue;
+    if (bytes > MemcacheServer::kMaxValueSize)
+    {
+      reply("SERVER_ERROR object too large for cache\r\n");
+    }
+    else
+    {
+      reply("SERVER_ERROR out of memory storing object\r\n");
+    }
+    // avoid stale data persisting in cache
+    needle_->resetKey(key);
+    owner_->deleteItem(needle_);
+    bytesToDiscard_ = bytes + 2;
+    state_ = kDiscardValue;
     return false;
   }
 }
 
-void Session::doDelete(Session::Tokenizer::iterator& beg, Session::Tokenizer::iterator end)
+void Session::doDelete()
 {
-  assert(command_ == "delete");
-  // FIXME: check (beg != end)
-  StringPiece key = *beg;
-  bool good = key.size() <= kLongestKeySize;
-  ++beg;
+  // delete <key> [0]
+  StringPiece key = tokens_.size() >= 2 ? tokens_[1] : StringPiece();
+  bool good = !key.empty() && key.size() <= kLongestKeySize;
   if (!good)
   {
     reply("CLIENT_ERROR bad command line format\r\n");
   }
-  else if (beg != end && *beg != "0") // issue 108, old protocol
+  else if (tokens_.size() > 2 && tokens_[2] != "0") // issue 108, old protocol
   {
     reply("CLIENT_ERROR bad command line format.  Usage: delete <key> [noreply]\r\n");
   }
@@ -421,3 +508,267 @@ void Session::doDelete(Session::Tokenizer::iterator& beg, Session::Tokenizer::it
     }
   }
 }
+
+// Responses are appended to outputBuf_ and sent at the end of onMessage(),
+// so a pipeline of quiet gets ending with a noop goes out in one write.
+bool Session::processBinaryRequest(Buffer* buf)
+{
+  if (buf->readableBytes() < kBinaryHeaderLen)
+  {
+    return false;
+  }
+
+  const char* header = buf->peek();
+  const uint8_t magic = static_cast<uint8_t>(header[0]);
+  const uint8_t opcode = static_cast<uint8_t>(header[1]);
+  const uint16_t keylen = readUint16(header + 2);
+  const uint8_t extlen = static_cast<uint8_t>(header[4]);
+  const uint32_t bodylen = readUint32(header + 8);
+  const uint32_t opaque = readUint32(header + 12);
+  const uint64_t cas = readUint64(header + 16);
+
+  if (magic != kRequestMagic || static_cast<uint32_t>(keylen) + extlen > bodylen)
+  {
+    LOG_INFO << "Bad binary request from " << conn_->peerAddress().toIpPort();
+    buf->retrieveAll();
+    conn_->send(&outputBuf_);
+    conn_->shutdown();
+    return false;
+  }
+
+  const uint32_t kMaxBodyLen = kLongestKeySize + 8 + MemcacheServer::kMaxValueSize;
+  if (bodylen > kMaxBodyLen)
+  {
+    ++requestsProcessed_;
+    binaryError(opcode, kTooLarge, opaque);
+    buf->retrieve(kBinaryHeaderLen);
+    bytesToDiscard_ = bodylen;
+    state_ = kDiscardValue;
+    return true;
+  }
+  if (buf->readableBytes() < kBinaryHeaderLen + bodylen)
+  {
+    return false;
+  }
+
+  ++requestsProcessed_;
+  StringPiece extras(header + kBinaryHeaderLen, extlen);
+  StringPiece key(extras.end(), keylen);
+  StringPiece value(key.end(), static_cast<int>(bodylen - keylen - extlen));
+  bool quit = false;
+  if (keylen > kLongestKeySize)
+  {
+    binaryError(opcode, kInvalidArguments, opaque);
+  }
+  else
+  {
+    switch (opcode)
+    {
+      case kGet:
+      case kGetQ:
+      case kGetK:
+      case kGetKQ:
+        binaryGet(opcode, opaque, key);
+        break;
+      case kSet:
+      case kSetQ:
+      case kAdd:
+      case kAddQ:
+      case kReplace:
+      case kReplaceQ:
+      case kAppend:
+      case kAppendQ:
+      case kPrepend:
+      case kPrependQ:
+        binaryUpdate(opcode, opaque, cas, extras, key, value);
+        break;
+      case kDelete:
+      case kDeleteQ:
+        needle_->resetKey(key);
+        if (owner_->deleteItem(needle_))
+        {
+          if (opcode == kDelete)
+          {
+            binaryReply(opcode, kSuccess, opaque, 0, "", "", "");
+          }
+        }
+        else
+        {
+          binaryError(opcode, kKeyNotFound, opaque);
+        }
+        break;
+      case kNoop:
+        binaryReply(opcode, kSuccess, opaque, 0, "", "", "");
+        break;
+      case kVersion:
+        binaryReply(opcode, kSuccess, opaque, 0, "", "", "0.01 muduo");
+        break;
+      case kQuit:
+      case kQuitQ:
+        if (opcode == kQuit)
+        {
+          binaryReply(opcode, kSuccess, opaque, 0, "", "", "");
+        }
+        quit = true;
+        break;
+      default:
+        binaryError(opcode, kUnknownCommand, opaque);
+        break;
+    }
+  }
+
+  if (quit)
+  {
+    buf->retrieveAll();
+    conn_->send(&outputBuf_);
+    conn_->shutdown();
+    return false;
+  }
+  buf->retrieve(kBinaryHeaderLen + bodylen);
+  return true;
+}
+
+void Session::binaryGet(uint8_t opcode, uint32_t opaque, StringPiece key)
+{
+  const bool withKey = opcode == kGetK || opcode == kGetKQ;
+  keys_.resize(1);
+  keys_[0].key = key;
+  owner_->getItems(&keys_, &items_);
+  if (items_[0])
+  {
+    const ConstItemPtr& item = items_[0];
+    uint32_t be32 = sockets::hostToNetwork32(item->flags());
+    binaryReply(opcode, kSuccess, opaque, item->cas(),
+                StringPiece(reinterpret_cast<const char*>(&be32), sizeof be32),
+                withKey ? item->key() : StringPiece(),
+                StringPiece(item->value(), static_cast<int>(item->valueLength() - 2)));
+    items_[0].reset();
+  }
+  else if (opcode == kGet || opcode == kGetK)
+  {
+    binaryReply(opcode, kKeyNotFound, opaque, 0, "", withKey ? key : StringPiece(), "Not found");
+  }
+}
+
+void Session::binaryUpdate(uint8_t opcode,
+                           uint32_t opaque,
+                           uint64_t cas,
+                           StringPiece extras,
+                           StringPiece key,
+                           StringPiece value)
+{
+  Item::UpdatePolicy policy = Item::kInvalid;
+  bool quiet = false;
+  switch (opcode)
+  {
+    case kSetQ: quiet = true;  // fall through
+    case kSet: policy = cas ? Item::kCas : Item::kSet; break;
+    case kAddQ: quiet = true;  // fall through
+    case kAdd: policy = Item::kAdd; break;
+    case kReplaceQ: quiet = true;  // fall through
+    case kReplace: policy = cas ? Item::kCas : Item::kReplace; break;
+    case kAppendQ: quiet = true;  // fall through
+    case kAppend: policy = Item::kAppend; break;
+    case kPrependQ: quiet = true;  // fall through
+    case kPrepend: policy = Item::kPrepend; break;
+    default: assert(false);
+  }
+
+  // set, add and replace have flags and exptime in extras
+  const bool hasExtras = policy != Item::kAppend && policy != Item::kPrepend;
+  if (key.empty() || extras.size() != (hasExtras ? 8 : 0))
+  {
+    binaryError(opcode, kInvalidArguments, opaque);
+    return;
+  }
+  uint32_t flags = 0;
+  int rel_exptime = 0;
+  if (hasExtras)
+  {
+    flags = readUint32(extras.data());
+    int32_t exptime = static_cast<int32_t>(readUint32(extras.data() + 4));
+    rel_exptime = owner_->relativeTime(exptime);
+  }
+
+  ItemPtr item;
+  if (value.size() <= MemcacheServer::kMaxValueSize)
+  {
+    item = owner_->makeItem(key, flags, rel_exptime, value.size() + 2, cas);
+  }
+  if (!item)
+  {
+    binaryError(opcode,
+                value.size() > MemcacheServer::kMaxValueSize ? kTooLarge : kOutOfMemory,
+                opaque);
+    // avoid stale data persisting in cache
+    needle_->resetKey(key);
+    owner_->deleteItem(needle_);
+    return;
+  }
+  item->append(value.data(), value.size());
+  item->append("\r\n", 2);
+
+  bool exists = false;
+  if (owner_->storeItem(item, policy, &exists))
+  {
+    if (!quiet)
+    {
+      binaryReply(opcode, kSuccess, opaque, item->cas(), "", "", "");
+    }
+  }
+  else
+  {
+    uint16_t status = kNotStored;
+    if (policy == Item::kAdd)
+    {
+      status = kKeyExists;
+    }
+    else if (policy == Item::kReplace)
+    {
+      status = kKeyNotFound;
+    }
+    else if (policy == Item::kCas)
+    {
+      status = exists ? kKeyExists : kKeyNotFound;
+    }
+    binaryError(opcode, status, opaque);
+  }
+}
+
+void Session::binaryReply(uint8_t opcode,
+                          uint16_t status,
+                          uint32_t opaque,
+                          uint64_t cas,
+                          StringPiece extras,
+                          StringPiece key,
+                          StringPiece value)
+{
+  outputBuf_.appendInt8(static_cast<int8_t>(kResponseMagic));
+  outputBuf_.appendInt8(static_cast<int8_t>(opcode));
+  outputBuf_.appendInt16(static_cast<int16_t>(key.size()));
+  outputBuf_.appendInt8(static_cast<int8_t>(extras.size()));
+  outputBuf_.appendInt8(0);  // data type
+  outputBuf_.appendInt16(static_cast<int16_t>(status));
+  outputBuf_.appendInt32(extras.size() + key.size() + value.size());
+  outputBuf_.appendInt32(static_cast<int32_t>(opaque));
+  outputBuf_.appendInt64(static_cast<int64_t>(cas));
+  outputBuf_.append(extras.data(), extras.size());
+  outputBuf_.append(key.data(), key.size());
+  outputBuf_.append(value.data(), value.size());
+}
+
+// errors are sent for quiet commands too
+void Session::binaryError(uint8_t opcode, uint16_t status, uint32_t opaque)
+{
+  const char* msg = "Unknown command";
+  switch (status)
+  {
+    case kKeyNotFound: msg = "Not found"; break;
+    case kKeyExists: msg = "Data exists for key."; break;
+    case kTooLarge: msg = "Too large."; break;
+    case kInvalidArguments: msg = "Invalid arguments"; break;
+    case kNotStored: msg = "Not stored."; break;
+    case kOutOfMemory: msg = "Out of memory"; break;
+  }
+  binaryReply(opcode, status, opaque, 0, "", "", msg);
+}
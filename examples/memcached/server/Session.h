@@ -10,7 +10,8 @@
 #include <boost/bind.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/noncopyable.hpp>
-#include <boost/tokenizer.hpp>
+
+#include <vector>
 
 using muduo::string;
 
@@ -24,7 +25,7 @@ class Session : boost::noncopyable,
     : owner_(owner),
       conn_(conn),
       state_(kNewCommand),
-      protocol_(kAscii), // FIXME
+      protocol_(kAuto),
       noreply_(false),
       policy_(Item::kInvalid),
       bytesToDiscard_(0),
@@ -43,6 +44,12 @@ class Session : boost::noncopyable,
              << " output buffer size: " << conn_->outputBuffer()->internalCapacity();
   }
 
+  static const int kLongestKeySize = 250;
+
+  // splits request by spaces, also used by UdpListener
+  static void tokenize(muduo::StringPiece request,
+                       std::vector<muduo::StringPiece>* tokens);
+
  private:
   enum State
   {
@@ -72,19 +79,28 @@ class Session : boost::noncopyable,
   void resetRequest();
   void reply(muduo::StringPiece msg);
 
-  struct SpaceSeparator
-  {
-    void reset() {}
-    template <typename InputIterator, typename Token>
-    bool operator()(InputIterator& next, InputIterator end, Token& tok);
-  };
-
-  typedef boost::tokenizer<SpaceSeparator,
-      const char*,
-      muduo::StringPiece> Tokenizer;
-  struct Reader;
-  bool doUpdate(Tokenizer::iterator& beg, Tokenizer::iterator end);
-  void doDelete(Tokenizer::iterator& beg, Tokenizer::iterator end);
+  bool doUpdate();
+  void doGet(bool cas);
+  void doDelete();
+
+  // memcached binary protocol
+  // returns false if more data is needed
+  bool processBinaryRequest(muduo::net::Buffer* buf);
+  void binaryGet(uint8_t opcode, uint32_t opaque, muduo::StringPiece key);
+  void binaryUpdate(uint8_t opcode,
+                    uint32_t opaque,
+                    uint64_t cas,
+                    muduo::StringPiece extras,
+                    muduo::StringPiece key,
+                    muduo::StringPiece value);
+  void binaryReply(uint8_t opcode,
+                   uint16_t status,
+                   uint32_t opaque,
+                   uint64_t cas,
+                   muduo::StringPiece extras,
+                   muduo::StringPiece key,
+                   muduo::StringPiece value);
+  void binaryError(uint8_t opcode, uint16_t status, uint32_t opaque);
 
   MemcacheServer* owner_;
   muduo::net::TcpConnectionPtr conn_;
@@ -92,14 +108,16 @@ class Session : boost::noncopyable,
   Protocol protocol_;
 
   // current request
-  string command_;
   bool noreply_;
   Item::UpdatePolicy policy_;
   ItemPtr currItem_;
   size_t bytesToDiscard_;
-  // cached
+  // cached, reused by every request
   ItemPtr needle_;
   muduo::net::Buffer outputBuf_;
+  std::vector<muduo::StringPiece> tokens_;
+  std::vector<ItemKey> keys_;
+  std::vector<ConstItemPtr> items_;
 
   // per session stats
   size_t bytesRead_;
@@ -0,0 +1,257 @@
+#include "SlabAllocator.h"
+
+#include <muduo/base/Logging.h>
+
+#include <algorithm>
+
+#include <stdlib.h>
+
+using namespace muduo;
+
+namespace
+{
+const size_t kMinValueSize = 48;  // same as memcached -n
+const size_t kAlignment = 8;
+
+size_t alignUp(size_t size)
+{
+  return (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+}
+
+SlabAllocator::SlabAllocator(size_t memoryLimit, size_t maxItemSize, double factor)
+  : memoryLimit_(memoryLimit),
+    numClasses_(0)
+{
+  assert(factor > 1.0);
+  const size_t largest = alignUp(maxItemSize);
+  size_t size = alignUp(sizeof(Item) + kMinValueSize);
+  while (size < largest && numClasses_ < kMaxClasses - 1)
+  {
+    SlabClass& sc = classes_[numClasses_++];
+    sc.chunkSize = size;
+    sc.perPage = static_cast<int>(std::max<size_t>(kPageSize / size, 1));
+    size = std::max(alignUp(static_cast<size_t>(static_cast<double>(size) * factor)),
+                    size + kAlignment);
+  }
+  SlabClass& sc = classes_[numClasses_++];
+  sc.chunkSize = largest;
+  sc.perPage = static_cast<int>(std::max<size_t>(kPageSize / largest, 1));
+}
+
+SlabAllocator::~SlabAllocator()
+{
+  for (int i = 0; i < numClasses_; ++i)
+  {
+    SlabClass& sc = classes_[i];
+    assert(sc.usedChunks == 0);
+    for (size_t j = 0; j < sc.pages.size(); ++j)
+    {
+      ::free(sc.pages[j]);
+    }
+  }
+}
+
+int SlabAllocator::slabClass(size_t size) const
+{
+  int lo = 0;
+  int hi = numClasses_;
+  while (lo < hi)
+  {
+    int mid = lo + (hi - lo) / 2;
+    if (classes_[mid].chunkSize < size)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  return lo < numClasses_ ? lo : -1;
+}
+
+void* SlabAllocator::allocate(int cls)
+{
+  assert(0 <= cls && cls < numClasses_);
+  SlabClass& sc = classes_[cls];
+  MutexLockGuard lock(sc.mutex);
+  if (sc.freeList == NULL && !newPage(&sc))
+  {
+    return NULL;
+  }
+  void* chunk = sc.freeList;
+  sc.freeList = *static_cast<void**>(chunk);
+  ++sc.usedChunks;
+  return chunk;
+}
+
+void SlabAllocator::deallocate(Item* item)
+{
+  assert(0 <= item->slabClass_ && item->slabClass_ < numClasses_);
+  SlabClass& sc = classes_[item->slabClass_];
+  MutexLockGuard lock(sc.mutex);
+  if (item->linked_)
+  {
+    unlinkLocked(&sc, item);
+  }
+  item->~Item();
+  void* chunk = item;
+  *static_cast<void**>(chunk) = sc.freeList;
+  sc.freeList = chunk;
+  --sc.usedChunks;
+}
+
+bool SlabAllocator::newPage(SlabClass* sc)
+{
+  const size_t pageBytes = sc->chunkSize * sc->perPage;
+  int64_t total = memoryAllocated_.addAndGet(static_cast<int64_t>(pageBytes));
+  if (memoryLimit_ > 0 && static_cast<size_t>(total) > memoryLimit_)
+  {
+    memoryAllocated_.add(-static_cast<int64_t>(pageBytes));
+    return false;
+  }
+
+  char* page = static_cast<char*>(::malloc(pageBytes));
+  if (page == NULL)
+  {
+    LOG_ERROR << "SlabAllocator::newPage - malloc failed for " << pageBytes;
+    memoryAllocated_.add(-static_cast<int64_t>(pageBytes));
+    return false;
+  }
+  sc->pages.push_back(page);
+  // first chunk of page is allocated first
+  for (int i = sc->perPage - 1; i >= 0; --i)
+  {
+    void* chunk = page + i * sc->chunkSize;
+    *static_cast<void**>(chunk) = sc->freeList;
+    sc->freeList = chunk;
+  }
+  return true;
+}
+
+void SlabAllocator::link(const Item* item, int now)
+{
+  if (item->slabClass_ < 0)
+  {
+    return;  // malloc'ed, not on any LRU list
+  }
+  SlabClass& sc = classes_[item->slabClass_];
+  MutexLockGuard lock(sc.mutex);
+  item->lastAccess_ = now;
+  if (!item->linked_)
+  {
+    linkLocked(&sc, item);
+  }
+}
+
+void SlabAllocator::unlink(const Item* item)
+{
+  if (item->slabClass_ < 0)
+  {
+    return;  // malloc'ed, not on any LRU list
+  }
+  SlabClass& sc = classes_[item->slabClass_];
+  MutexLockGuard lock(sc.mutex);
+  if (item->linked_)
+  {
+    unlinkLocked(&sc, item);
+  }
+}
+
+void SlabAllocator::touch(const Item* item, int now)
+{
+  // racy read, a missed or extra bump is harmless
+  if (item->slabClass_ < 0 || now - item->lastAccess_ < kLruUpdateInterval)
+  {
+    return;
+  }
+  SlabClass& sc = classes_[item->slabClass_];
+  MutexLockGuard lock(sc.mutex);
+  item->lastAccess_ = now;
+  if (item->linked_ && sc.head != item)
+  {
+    unlinkLocked(&sc, item);
+    linkLocked(&sc, item);
+  }
+}
+
+ConstItemPtr SlabAllocator::evict(int cls, const Remover& remover)
+{
+  assert(0 <= cls && cls < numClasses_);
+  SlabClass& sc = classes_[cls];
+  MutexLockGuard lock(sc.mutex);
+  const Item* item = sc.tail;
+  for (int i = 0; item != NULL && i < kEvictSearchDepth; ++i)
+  {
+    const Item* prev = item->prev_;
+    // linked items are alive, deallocate() unlinks under the same mutex.
+    ConstItemPtr removed(remover(item));
+    unlinkLocked(&sc, item);
+    if (removed)
+    {
+      ++sc.evictions;
+      return removed;
+    }
+    // already deleted or replaced, but not yet unlinked
+    item = prev;
+  }
+  return ConstItemPtr();
+}
+
+SlabAllocator::Stats SlabAllocator::stats(int cls) const
+{
+  assert(0 <= cls && cls < numClasses_);
+  const SlabClass& sc = classes_[cls];
+  MutexLockGuard lock(sc.mutex);
+  Stats result;
+  result.chunkSize = sc.chunkSize;
+  result.pages = static_cast<int>(sc.pages.size());
+  result.usedChunks = sc.usedChunks;
+  result.items = sc.items;
+  result.evictions = sc.evictions;
+  return result;
+}
+
+void SlabAllocator::linkLocked(SlabClass* sc, const Item* item)
+{
+  assert(!item->linked_);
+  item->prev_ = NULL;
+  item->next_ = sc->head;
+  if (sc->head)
+  {
+    sc->head->prev_ = item;
+  }
+  sc->head = item;
+  if (sc->tail == NULL)
+  {
+    sc->tail = item;
+  }
+  item->linked_ = true;
+  ++sc->items;
+}
+
+void SlabAllocator::unlinkLocked(SlabClass* sc, const Item* item)
+{
+  assert(item->linked_);
+  if (item->prev_)
+  {
+    item->prev_->next_ = item->next_;
+  }
+  else
+  {
+    sc->head = item->next_;
+  }
+  if (item->next_)
+  {
+    item->next_->prev_ = item->prev_;
+  }
+  else
+  {
+    sc->tail = item->prev_;
+  }
+  item->prev_ = NULL;
+  item->next_ = NULL;
+  item->linked_ = false;
+  --sc->items;
+}
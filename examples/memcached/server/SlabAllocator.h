@@ -0,0 +1,109 @@
+#ifndef MUDUO_EXAMPLES_MEMCACHED_SERVER_SLABALLOCATOR_H
+#define MUDUO_EXAMPLES_MEMCACHED_SERVER_SLABALLOCATOR_H
+
+#include "Item.h"
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Mutex.h>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <vector>
+
+// Memory of items, carved from 1MB pages into classes of chunk sizes
+// growing by a factor, like memcached's slabs.c.
+//
+// Pages are never returned, total pages are capped by memoryLimit.
+// When a class runs out of chunks and no more page can be allocated,
+// its least recently used item is evicted to make room.
+//
+// Each class has its own mutex, which guards the free list and the LRU.
+// Lock order is class mutex before hash table mutex, so an ItemPtr must
+// never be released while holding a hash table mutex.
+class SlabAllocator : boost::noncopyable
+{
+ public:
+  static const int kPageSize = 1024*1024;
+  static const int kMaxClasses = 64;
+  static const int kLruUpdateInterval = 60;  // seconds
+  static const int kEvictSearchDepth = 5;
+
+  struct Stats
+  {
+    size_t chunkSize;
+    int pages;
+    int64_t usedChunks;
+    int64_t items;  // linked in LRU
+    int64_t evictions;
+  };
+
+  // removes item from the hash table, if it is still there.
+  typedef boost::function<ConstItemPtr (const Item*)> Remover;
+
+  // memoryLimit == 0 means no limit
+  SlabAllocator(size_t memoryLimit, size_t maxItemSize, double factor = 1.25);
+  ~SlabAllocator();
+
+  // returns -1 if size is larger than the largest chunk
+  int slabClass(size_t size) const;
+
+  // returns NULL if no free chunk and memory limit reached
+  void* allocate(int cls);
+  // called by the last ItemPtr of item
+  void deallocate(Item* item);
+
+  // items not allocated from slabs are ignored
+  void link(const Item* item, int now);
+  void unlink(const Item* item);
+  // moves item to the head of LRU, at most once per kLruUpdateInterval
+  void touch(const Item* item, int now);
+
+  // Removes one of the least recently used items of cls from hash table.
+  // The returned item must be released without holding any lock,
+  // its chunk is freed when the last reference goes.
+  ConstItemPtr evict(int cls, const Remover& remover);
+
+  int numClasses() const { return numClasses_; }
+  Stats stats(int cls) const;
+  size_t memoryLimit() const { return memoryLimit_; }
+  int64_t memoryAllocated() const { return memoryAllocated_.get(); }
+
+ private:
+  struct SlabClass
+  {
+    SlabClass()
+      : chunkSize(0),
+        perPage(0),
+        freeList(NULL),
+        head(NULL),
+        tail(NULL),
+        usedChunks(0),
+        items(0),
+        evictions(0)
+    {
+    }
+
+    size_t chunkSize;
+    int perPage;
+    void* freeList;  // next pointer lives in the first word of each chunk
+    std::vector<char*> pages;
+    const Item* head;  // most recently used
+    const Item* tail;
+    int64_t usedChunks;
+    int64_t items;
+    int64_t evictions;
+    mutable muduo::MutexLock mutex;
+  };
+
+  bool newPage(SlabClass* sc);
+  void linkLocked(SlabClass* sc, const Item* item);
+  void unlinkLocked(SlabClass* sc, const Item* item);
+
+  const size_t memoryLimit_;
+  mutable muduo::AtomicInt64 memoryAllocated_;
+  int numClasses_;
+  SlabClass classes_[kMaxClasses];
+};
+
+#endif  // MUDUO_EXAMPLES_MEMCACHED_SERVER_SLABALLOCATOR_H
@@ -0,0 +1,294 @@
+#undef NDEBUG
+#include "MemcacheServer.h"
+#include "SlabAllocator.h"
+
+#include <muduo/net/EventLoop.h>
+
+#include <boost/bind.hpp>
+
+#include <map>
+
+#include <assert.h>
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const size_t kMaxItemSize = 1024 * 1024;
+
+ItemPtr newItem(SlabAllocator* slabs, int cls, const string& key)
+{
+  void* chunk = slabs->allocate(cls);
+  if (chunk == NULL)
+  {
+    return ItemPtr();
+  }
+  return Item::makeItem(chunk, slabs, cls, key, 0, 0, 2, 0);
+}
+
+string keyOf(int i)
+{
+  char buf[32];
+  snprintf(buf, sizeof buf, "key%06d", i);  // same size class
+  return buf;
+}
+
+// stands for the hash table that evict() removes items from.
+struct Table
+{
+  ConstItemPtr remove(const Item* item)
+  {
+    ConstItemPtr removed;
+    std::map<const Item*, ConstItemPtr>::iterator it = items.find(item);
+    if (it != items.end())
+    {
+      removed = it->second;
+      items.erase(it);
+    }
+    return removed;
+  }
+
+  SlabAllocator::Remover remover()
+  {
+    return boost::bind(&Table::remove, this, _1);
+  }
+
+  void add(const ConstItemPtr& item)
+  {
+    items[get_pointer(item)] = item;
+  }
+
+  std::map<const Item*, ConstItemPtr> items;
+};
+
+void testClassSizes()
+{
+  SlabAllocator slabs(0, kMaxItemSize, 1.25);
+  assert(slabs.numClasses() > 1 && slabs.numClasses() <= SlabAllocator::kMaxClasses);
+  assert(slabs.stats(0).chunkSize >= sizeof(Item) + 48);
+  for (int i = 0; i < slabs.numClasses(); ++i)
+  {
+    const size_t chunkSize = slabs.stats(i).chunkSize;
+    assert(chunkSize % 8 == 0);
+    assert(slabs.slabClass(chunkSize) == i);
+    assert(slabs.stats(i).pages == 0);
+    if (i > 0)
+    {
+      const size_t smaller = slabs.stats(i - 1).chunkSize;
+      assert(chunkSize > smaller);
+      assert(slabs.slabClass(smaller + 1) == i);
+      // grows by the factor, rounded up to alignment
+      assert(chunkSize <= static_cast<size_t>(static_cast<double>(smaller) * 1.25) + 8);
+    }
+  }
+  assert(slabs.stats(slabs.numClasses() - 1).chunkSize == kMaxItemSize);
+  assert(slabs.slabClass(1) == 0);
+  assert(slabs.slabClass(kMaxItemSize) == slabs.numClasses() - 1);
+  assert(slabs.slabClass(kMaxItemSize + 1) == -1);
+
+  SlabAllocator coarse(0, kMaxItemSize, 2.0);
+  assert(coarse.numClasses() < slabs.numClasses());
+}
+
+void testMemoryCap()
+{
+  SlabAllocator slabs(2 * SlabAllocator::kPageSize, kMaxItemSize);
+  const size_t chunkSize = slabs.stats(0).chunkSize;
+  const int64_t perPage = SlabAllocator::kPageSize / chunkSize;
+  std::vector<ItemPtr> items;
+  ItemPtr item;
+  while ((item = newItem(&slabs, 0, keyOf(static_cast<int>(items.size())))))
+  {
+    items.push_back(item);
+  }
+  const SlabAllocator::Stats full = slabs.stats(0);
+  assert(full.pages == 2);
+  assert(full.usedChunks == 2 * perPage);
+  assert(static_cast<int64_t>(items.size()) == 2 * perPage);
+  assert(slabs.memoryAllocated() == 2 * perPage * static_cast<int64_t>(chunkSize));
+  // no room for a page of another class either
+  assert(slabs.allocate(slabs.numClasses() - 1) == NULL);
+  assert(slabs.allocate(1) == NULL);
+  assert(slabs.stats(1).pages == 0);
+
+  // chunks of released items are reused, no more pages
+  items.pop_back();
+  items.pop_back();
+  assert(slabs.stats(0).usedChunks == full.usedChunks - 2);
+  items.push_back(newItem(&slabs, 0, "again"));
+  assert(items.back());
+  assert(slabs.stats(0).pages == 2);
+  assert(slabs.stats(0).usedChunks == full.usedChunks - 1);
+  items.clear();
+  assert(slabs.stats(0).usedChunks == 0);
+
+  SlabAllocator unlimited(0, kMaxItemSize);
+  assert(unlimited.memoryLimit() == 0);
+  std::vector<ItemPtr> large;
+  const int largest = unlimited.numClasses() - 1;
+  for (int i = 0; i < 3; ++i)
+  {
+    large.push_back(newItem(&unlimited, largest, keyOf(i)));
+    assert(large.back());
+  }
+  assert(unlimited.stats(largest).pages == 3);
+  assert(unlimited.memoryAllocated() == 3 * static_cast<int64_t>(kMaxItemSize));
+}
+
+// An item deleted or replaced but not yet unlinked stays on LRU for a
+// while, evict() drops it and goes on to the next one.
+void testEvictSkipsRemoved()
+{
+  SlabAllocator slabs(0, kMaxItemSize);
+  Table table;
+  std::vector<ItemPtr> items;
+  for (int i = 0; i < 3; ++i)
+  {
+    items.push_back(newItem(&slabs, 0, keyOf(i)));
+    slabs.link(get_pointer(items.back()), 0);
+  }
+  // items[0] is the tail, and is no longer in table
+  table.add(items[1]);
+  table.add(items[2]);
+  assert(slabs.stats(0).items == 3);
+
+  ConstItemPtr victim(slabs.evict(0, table.remover()));
+  assert(get_pointer(victim) == get_pointer(items[1]));
+  assert(slabs.stats(0).evictions == 1);
+  assert(slabs.stats(0).items == 1);
+  assert(table.items.size() == 1);
+
+  // nothing left to remove
+  table.items.clear();
+  assert(!slabs.evict(0, table.remover()));
+  assert(slabs.stats(0).items == 0);
+  assert(slabs.stats(0).evictions == 1);
+  assert(!slabs.evict(0, table.remover()));
+
+  // gives up after kEvictSearchDepth removed items
+  const int kRemoved = SlabAllocator::kEvictSearchDepth + 1;
+  for (int i = 0; i < kRemoved; ++i)
+  {
+    items.push_back(newItem(&slabs, 0, keyOf(i + 3)));
+    slabs.link(get_pointer(items.back()), 0);
+  }
+  table.add(items.back());  // linked last, at head
+  assert(!slabs.evict(0, table.remover()));
+  assert(slabs.stats(0).items == kRemoved - SlabAllocator::kEvictSearchDepth);
+  victim = slabs.evict(0, table.remover());
+  assert(get_pointer(victim) == get_pointer(items.back()));
+  assert(slabs.stats(0).items == 0);
+  assert(slabs.stats(0).evictions == 2);
+
+  // releasing the last reference unlinks a linked item
+  ItemPtr linked(newItem(&slabs, 0, "linked"));
+  slabs.link(get_pointer(linked), 0);
+  assert(slabs.stats(0).items == 1);
+  linked.reset();
+  assert(slabs.stats(0).items == 0);
+}
+
+// touch() moves an item to head at most once per kLruUpdateInterval.
+void testTouchThrottled()
+{
+  SlabAllocator slabs(0, kMaxItemSize);
+  for (int touchAt = SlabAllocator::kLruUpdateInterval - 30;
+       touchAt <= SlabAllocator::kLruUpdateInterval;
+       touchAt += 30)
+  {
+    Table table;
+    ItemPtr a(newItem(&slabs, 0, "a"));
+    ItemPtr b(newItem(&slabs, 0, "b"));
+    slabs.link(get_pointer(a), 0);
+    slabs.link(get_pointer(b), 0);
+    table.add(a);
+    table.add(b);
+    slabs.touch(get_pointer(a), touchAt);
+    const bool moved = touchAt >= SlabAllocator::kLruUpdateInterval;
+    ConstItemPtr victim(slabs.evict(0, table.remover()));
+    assert(get_pointer(victim) == (moved ? get_pointer(b) : get_pointer(a)));
+    victim = slabs.evict(0, table.remover());
+    assert(get_pointer(victim) == (moved ? get_pointer(a) : get_pointer(b)));
+  }
+
+  // items not from slabs are ignored
+  ItemPtr malloced(Item::makeItem("malloced", 0, 0, 2, 0));
+  slabs.link(get_pointer(malloced), 0);
+  slabs.touch(get_pointer(malloced), 3600);
+  slabs.unlink(get_pointer(malloced));
+  assert(slabs.stats(0).items == 0);
+}
+
+bool store(MemcacheServer* server, const string& key, int valuelen)
+{
+  ItemPtr item(server->makeItem(key, 0, 0, valuelen + 2, 1));
+  if (!item)
+  {
+    return false;
+  }
+  string value(valuelen, 'x');
+  item->append(value.data(), value.size());
+  item->append("\r\n", 2);
+  assert(item->endsWithCRLF());
+  bool exists = false;
+  bool stored = server->storeItem(item, Item::kSet, &exists);
+  assert(stored);
+  return stored;
+}
+
+bool present(MemcacheServer* server, const string& key)
+{
+  ConstItemPtr lookup(Item::makeItem(key, 0, 0, 2, 0));
+  return get_pointer(server->getItem(lookup)) != NULL;
+}
+
+// Once memory is full, makeItem() evicts the least recently used items
+// of the same class, it fails only if that class has none.
+void testMakeItemEvicts()
+{
+  EventLoop loop;
+  MemcacheServer::Options options;
+  options.memoryMB = 1;
+  MemcacheServer server(&loop, options);
+  const SlabAllocator& slabs = server.slabs();
+
+  const int kValueLen = 100;
+  const int cls = slabs.slabClass(Item::totalSize(keyOf(0).size(), kValueLen + 2));
+  assert(cls >= 0);
+  const int64_t perPage = SlabAllocator::kPageSize / slabs.stats(cls).chunkSize;
+  const int kItems = static_cast<int>(3 * perPage);
+  for (int i = 0; i < kItems; ++i)
+  {
+    assert(store(&server, keyOf(i), kValueLen));
+  }
+  const SlabAllocator::Stats st = slabs.stats(cls);
+  assert(st.pages == 1);
+  assert(st.items == perPage);
+  assert(st.evictions == kItems - perPage);
+  assert(!present(&server, keyOf(0)));
+  assert(!present(&server, keyOf(static_cast<int>(kItems - perPage - 1))));
+  assert(present(&server, keyOf(static_cast<int>(kItems - perPage))));
+  assert(present(&server, keyOf(kItems - 1)));
+
+  // memory is full, and there is nothing to evict in a larger class
+  assert(!server.makeItem("large", 0, 0, 10000, 1));
+  assert(slabs.stats(slabs.slabClass(Item::totalSize(5, 10000))).pages == 0);
+  // larger than any class
+  assert(!server.makeItem("huge", 0, 0, 2 * MemcacheServer::kMaxValueSize, 1));
+  assert(slabs.stats(cls).items == perPage);
+}
+
+}
+
+int main()
+{
+  testClassSizes();
+  testMemoryCap();
+  testEvictSkipsRemoved();
+  testTouchThrottled();
+  testMakeItemEvicts();
+  printf("All tests passed\n");
+}
@@ -0,0 +1,250 @@
+#include "UdpListener.h"
+#include "MemcacheServer.h"
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+
+#include <errno.h>
+#include <string.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+int createNonblockingUDP()
+{
+  int sockfd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+  if (sockfd < 0)
+  {
+    LOG_SYSFATAL << "::socket";
+  }
+  return sockfd;
+}
+
+const size_t kMaxBody = UdpListener::kMaxDatagramSize - UdpListener::kHeaderSize;
+}
+
+UdpListener::UdpListener(MemcacheServer* owner, EventLoop* loop, uint16_t port)
+  : owner_(owner),
+    loop_(loop),
+    socket_(createNonblockingUDP()),
+    channel_(loop, socket_.fd()),
+    requests_(kBatchSize * kMaxRequestSize),
+    requestsProcessed_(0),
+    datagramsDropped_(0)
+{
+  socket_.setReuseAddr(true);
+  socket_.setReusePort(true);
+  socket_.bindAddress(InetAddress(port));
+  channel_.setReadCallback(boost::bind(&UdpListener::handleRead, this, _1));
+
+  bzero(requestMsgs_, sizeof requestMsgs_);
+  for (int i = 0; i < kBatchSize; ++i)
+  {
+    requestIov_[i].iov_base = &requests_[i * kMaxRequestSize];
+    requestIov_[i].iov_len = kMaxRequestSize;
+    requestMsgs_[i].msg_hdr.msg_iov = &requestIov_[i];
+    requestMsgs_[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+UdpListener::~UdpListener()
+{
+  LOG_INFO << "UdpListener fd " << socket_.fd()
+           << " processed " << requestsProcessed_ << " requests"
+           << ", dropped " << datagramsDropped_ << " datagrams";
+}
+
+void UdpListener::start()
+{
+  loop_->assertInLoopThread();
+  channel_.enableReading();
+}
+
+void UdpListener::stop()
+{
+  loop_->assertInLoopThread();
+  channel_.disableAll();
+  channel_.remove();
+}
+
+void UdpListener::handleRead(Timestamp)
+{
+  for (int i = 0; i < kBatchSize; ++i)
+  {
+    requestMsgs_[i].msg_hdr.msg_name = &peers_[i];
+    requestMsgs_[i].msg_hdr.msg_namelen = sizeof peers_[i];
+    requestMsgs_[i].msg_hdr.msg_flags = 0;
+  }
+
+  int n = ::recvmmsg(socket_.fd(), requestMsgs_, kBatchSize, 0, NULL);
+  if (n < 0)
+  {
+    if (errno != EAGAIN && errno != EINTR)
+    {
+      LOG_SYSERR << "UdpListener::handleRead - recvmmsg";
+    }
+    return;
+  }
+
+  for (int i = 0; i < n; ++i)
+  {
+    if (requestMsgs_[i].msg_hdr.msg_flags & MSG_TRUNC)
+    {
+      ++datagramsDropped_;
+      continue;
+    }
+    processRequest(&requests_[i * kMaxRequestSize], requestMsgs_[i].msg_len, i);
+  }
+  sendReplies();
+}
+
+void UdpListener::processRequest(const char* data, size_t len, int peer)
+{
+  uint16_t header[kHeaderSize / sizeof(uint16_t)];
+  if (len < kHeaderSize)
+  {
+    ++datagramsDropped_;
+    return;
+  }
+  memcpy(header, data, kHeaderSize);
+  // a request must fit in one datagram, like memcached
+  if (ntohs(header[2]) != 1 || header[3] != 0)
+  {
+    ++datagramsDropped_;
+    return;
+  }
+  ++requestsProcessed_;
+
+  const size_t begin = replies_.readableBytes();
+  processCommand(data + kHeaderSize, data + len);
+  const size_t length = replies_.readableBytes() - begin;
+  const size_t count = (length + kMaxBody - 1) / kMaxBody;
+  if (count > 0xFFFF)
+  {
+    // can't be numbered, drop the reply
+    replies_.unwrite(length);
+    ++datagramsDropped_;
+    return;
+  }
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    Datagram d;
+    d.header[0] = header[0];  // request id
+    d.header[1] = htons(static_cast<uint16_t>(i));
+    d.header[2] = htons(static_cast<uint16_t>(count));
+    d.header[3] = 0;
+    d.offset = begin + i * kMaxBody;
+    d.length = std::min(kMaxBody, length - i * kMaxBody);
+    d.peer = peer;
+    datagrams_.push_back(d);
+  }
+}
+
+void UdpListener::processCommand(const char* begin, const char* end)
+{
+  const char* crlf = static_cast<const char*>(memmem(begin, end - begin, "\r\n", 2));
+  if (crlf == NULL)
+  {
+    replies_.append("CLIENT_ERROR line not terminated\r\n");
+    return;
+  }
+
+  Session::tokenize(StringPiece(begin, static_cast<int>(crlf - begin)), &tokens_);
+  if (tokens_.empty())
+  {
+    replies_.append("ERROR\r\n");
+    return;
+  }
+  const bool cas = tokens_[0] == "gets";
+  if (!cas && tokens_[0] != "get")
+  {
+    replies_.append("SERVER_ERROR only get and gets are served over UDP\r\n");
+    return;
+  }
+  if (tokens_.size() < 2)
+  {
+    replies_.append("ERROR\r\n");
+    return;
+  }
+
+  keys_.resize(tokens_.size() - 1);
+  for (size_t i = 1; i < tokens_.size(); ++i)
+  {
+    if (tokens_[i].size() > Session::kLongestKeySize)
+    {
+      replies_.append("CLIENT_ERROR bad command line format\r\n");
+      return;
+    }
+    keys_[i-1].key = tokens_[i];
+  }
+
+  owner_->getItems(&keys_, &items_);
+  for (size_t i = 0; i < items_.size(); ++i)
+  {
+    if (items_[i])
+    {
+      items_[i]->output(&replies_, cas);
+      items_[i].reset();
+    }
+  }
+  replies_.append("END\r\n");
+}
+
+// Replies are dropped if the socket buffer is full, as memcached does.
+void UdpListener::sendReplies()
+{
+  const size_t n = datagrams_.size();
+  replyIov_.resize(2 * n);
+  replyMsgs_.resize(n);
+  for (size_t i = 0; i < n; ++i)
+  {
+    Datagram& d = datagrams_[i];
+    replyIov_[2*i].iov_base = d.header;
+    replyIov_[2*i].iov_len = kHeaderSize;
+    replyIov_[2*i+1].iov_base = const_cast<char*>(replies_.peek() + d.offset);
+    replyIov_[2*i+1].iov_len = d.length;
+
+    struct msghdr& msg = replyMsgs_[i].msg_hdr;
+    bzero(&msg, sizeof msg);
+    msg.msg_name = &peers_[d.peer];
+    msg.msg_namelen = requestMsgs_[d.peer].msg_hdr.msg_namelen;
+    msg.msg_iov = &replyIov_[2*i];
+    msg.msg_iovlen = 2;
+  }
+
+  size_t sent = 0;
+  while (sent < n)
+  {
+    int nw = ::sendmmsg(socket_.fd(), &replyMsgs_[sent],
+                        static_cast<unsigned int>(n - sent), 0);
+    if (nw < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if (errno != EAGAIN)
+      {
+        LOG_SYSERR << "UdpListener::sendReplies - sendmmsg";
+      }
+      datagramsDropped_ += static_cast<int64_t>(n - sent);
+      break;
+    }
+    sent += nw;
+  }
+
+  datagrams_.clear();
+  replies_.retrieveAll();
+  if (replies_.internalCapacity() > 1024 * 1024)
+  {
+    replies_.shrink(0);
+  }
+}
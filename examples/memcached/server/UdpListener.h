@@ -0,0 +1,94 @@
+#ifndef MUDUO_EXAMPLES_MEMCACHED_SERVER_UDPLISTENER_H
+#define MUDUO_EXAMPLES_MEMCACHED_SERVER_UDPLISTENER_H
+
+#include "Item.h"
+
+#include <muduo/base/Timestamp.h>
+#include <muduo/net/Buffer.h>
+#include <muduo/net/Channel.h>
+#include <muduo/net/Socket.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+namespace muduo
+{
+namespace net
+{
+class EventLoop;
+}
+}
+
+class MemcacheServer;
+
+// Serves get and gets over UDP, in one loop.
+//
+// Every IO loop has its own socket bound to the same port with
+// SO_REUSEPORT, so that the kernel spreads datagrams among loops.
+// Datagrams are read with recvmmsg() and replies of a whole batch are
+// written with sendmmsg().  Each datagram starts with the 8 bytes frame
+// header of memcached: request id, sequence number, total number of
+// datagrams and a reserved zero, all in network byte order.
+// Replies are split into datagrams of at most kMaxDatagramSize bytes.
+class UdpListener : boost::noncopyable
+{
+ public:
+  static const int kHeaderSize = 8;
+  static const int kMaxDatagramSize = 1400;  // same as memcached
+  static const int kMaxRequestSize = 8192;
+  static const int kBatchSize = 32;
+
+  UdpListener(MemcacheServer* owner, muduo::net::EventLoop* loop, uint16_t port);
+  ~UdpListener();
+
+  muduo::net::EventLoop* loop() const { return loop_; }
+  void start();  // in loop
+  void stop();   // in loop
+
+ private:
+  // a reply datagram, header and a slice of replies_
+  struct Datagram
+  {
+    uint16_t header[kHeaderSize / sizeof(uint16_t)];
+    size_t offset;
+    size_t length;
+    int peer;  // index of peers_
+  };
+
+  void handleRead(muduo::Timestamp receiveTime);
+  void processRequest(const char* data, size_t len, int peer);
+  void processCommand(const char* begin, const char* end);
+  void sendReplies();
+
+  MemcacheServer* owner_;  // not own
+  muduo::net::EventLoop* loop_;
+  muduo::net::Socket socket_;
+  muduo::net::Channel channel_;
+
+  // one batch of requests
+  std::vector<char> requests_;
+  struct sockaddr_in6 peers_[kBatchSize];
+  struct iovec requestIov_[kBatchSize];
+  struct mmsghdr requestMsgs_[kBatchSize];
+
+  // replies of one batch
+  muduo::net::Buffer replies_;
+  std::vector<Datagram> datagrams_;
+  std::vector<struct iovec> replyIov_;
+  std::vector<struct mmsghdr> replyMsgs_;
+
+  std::vector<StringPiece> tokens_;
+  std::vector<ItemKey> keys_;
+  std::vector<ConstItemPtr> items_;
+
+  int64_t requestsProcessed_;
+  int64_t datagramsDropped_;
+};
+typedef boost::shared_ptr<UdpListener> UdpListenerPtr;
+
+#endif  // MUDUO_EXAMPLES_MEMCACHED_SERVER_UDPLISTENER_H
@@ -2,6 +2,7 @@
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/inspect/ProcessInspector.h>
 
+#include <inttypes.h>
 #include <stdio.h>
 #ifdef HAVE_TCMALLOC
 #include <gperftools/heap-profiler.h>
@@ -20,17 +21,19 @@ int main(int argc, char* argv[])
   int valuelen = argc > 3 ? atoi(argv[3]) : 100;
   EventLoop loop;
   MemcacheServer::Options options;
+  options.memoryMB = argc > 4 ? atoi(argv[4]) : 0;
   MemcacheServer server(&loop, options);
 
-  printf("sizeof(Item) = %zd\npid = %d\nitems = %d\nkeylen = %d\nvaluelen = %d\n",
-         sizeof(Item), getpid(), items, keylen, valuelen);
+  printf("sizeof(Item) = %zd\npid = %d\nitems = %d\nkeylen = %d\nvaluelen = %d\nmemory limit = %d MB\n",
+         sizeof(Item), getpid(), items, keylen, valuelen, options.memoryMB);
   char key[256] = { 0 };
   string value;
   for (int i = 0; i < items; ++i)
   {
     snprintf(key, sizeof key, "%0*d", keylen, i);
     value.assign(valuelen, "0123456789"[i % 10]);
-    ItemPtr item(Item::makeItem(key, 0, 0, valuelen+2, 1));
+    ItemPtr item(server.makeItem(key, 0, 0, valuelen+2, 1));
+    assert(item);
     item->append(value.data(), value.size());
     item->append("\r\n", 2);
     assert(item->endsWithCRLF());
@@ -39,10 +42,36 @@ int main(int argc, char* argv[])
     assert(stored); (void) stored;
     assert(!exists);
   }
+
+  const SlabAllocator& slabs = server.slabs();
+  int64_t totalItems = 0;
+  int64_t totalEvictions = 0;
+  printf("==========\nclass  chunk  pages    items  evictions\n");
+  for (int i = 0; i < slabs.numClasses(); ++i)
+  {
+    SlabAllocator::Stats st = slabs.stats(i);
+    if (st.pages > 0)
+    {
+      printf("%5d %6zd %6d %8" PRId64 " %10" PRId64 "\n",
+             i, st.chunkSize, st.pages, st.items, st.evictions);
+      totalItems += st.items;
+      totalEvictions += st.evictions;
+    }
+  }
+  const double payload = static_cast<double>(totalItems) * (keylen + valuelen);
+  const double allocated = static_cast<double>(server.slabs().memoryAllocated());
+  printf("items = %" PRId64 "\nevictions = %" PRId64 "\n", totalItems, totalEvictions);
+  printf("slab memory = %.0f bytes\n", allocated);
+  if (totalItems > 0)
+  {
+    printf("bytes per item = %.1f\noverhead = %.1f%%\n",
+           allocated / static_cast<double>(totalItems),
+           payload > 0 ? (allocated - payload) * 100 / payload : 0.0);
+  }
+
   Inspector::ArgList arg;
   printf("==========\n%s\n",
          ProcessInspector::overview(HttpRequest::kGet, arg).c_str());
-  // TODO: print bytes per item, overhead percent
   fflush(stdout);
 #ifdef HAVE_TCMALLOC
   char buf[8192];
@@ -14,6 +14,7 @@ bool parseCommandLine(int argc, char* argv[], MemcacheServer::Options* options)
   options->tcpport = 11211;
   options->gperfport = 11212;
   options->threads = 4;
+  options->memoryMB = 64;
 
   po::options_description desc("Allowed options");
   desc.add_options()
@@ -22,6 +23,7 @@ bool parseCommandLine(int argc, char* argv[], MemcacheServer::Options* options)
       ("udpport,U", po::value<uint16_t>(&options->udpport), "UDP port")
       ("gperf,g", po::value<uint16_t>(&options->gperfport), "port for gperftools")
       ("threads,t", po::value<int>(&options->threads), "Number of worker threads")
+      ("memory,m", po::value<int>(&options->memoryMB), "Memory limit in megabytes, 0 for no limit")
       ;
 
   po::variables_map vm;
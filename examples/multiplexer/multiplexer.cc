@@ -9,8 +9,10 @@
 
 #include <boost/bind.hpp>
 
+#include <algorithm>
 #include <queue>
 #include <utility>
+#include <vector>
 
 #include <stdio.h>
 #include <unistd.h>
@@ -37,7 +39,8 @@ class MultiplexServer
       backend_(loop, backendAddr, "MultiplexBackend"),
       numThreads_(numThreads),
       oldCounter_(0),
-      startTime_(Timestamp::now())
+      startTime_(Timestamp::now()),
+      clientConns_(kMaxConns + 1)
   {
     server_.setConnectionCallback(
         boost::bind(&MultiplexServer::onClientConnection, this, _1));
@@ -63,16 +66,17 @@ class MultiplexServer
   }
 
  private:
-  void sendBackendPacket(int id, Buffer* buf)
+  static void makeHeader(uint8_t* header, int id, size_t len)
   {
-    size_t len = buf->readableBytes();
     assert(len <= kMaxPacketLen);
-    uint8_t header[kHeaderLen] = {
-      static_cast<uint8_t>(len),
-      static_cast<uint8_t>(id & 0xFF),
-      static_cast<uint8_t>((id & 0xFF00) >> 8)
-    };
-    buf->prepend(header, kHeaderLen);
+    header[0] = static_cast<uint8_t>(len);
+    header[1] = static_cast<uint8_t>(id & 0xFF);
+    header[2] = static_cast<uint8_t>((id & 0xFF00) >> 8);
+  }
+
+  // buf holds frames, sent to backend in one piece.
+  void sendBackend(Buffer* buf)
+  {
     TcpConnectionPtr backendConn;
     {
       MutexLockGuard lock(mutex_);
@@ -86,24 +90,35 @@ class MultiplexServer
 
   void sendBackendString(int id, const string& msg)
   {
-    assert(msg.size() <= kMaxPacketLen);
     Buffer buf;
     buf.append(msg);
-    sendBackendPacket(id, &buf);
+    sendBackendBuffer(id, &buf);
   }
 
   void sendBackendBuffer(int id, Buffer* buf)
   {
-    while (buf->readableBytes() > kMaxPacketLen)
+    uint8_t header[kHeaderLen];
+    size_t len = buf->readableBytes();
+    if (len <= kMaxPacketLen)
     {
-      Buffer packet;
-      packet.append(buf->peek(), kMaxPacketLen);
-      buf->retrieve(kMaxPacketLen);
-      sendBackendPacket(id, &packet);
+      // one frame, header goes in front of the payload in place.
+      makeHeader(header, id, len);
+      buf->prepend(header, kHeaderLen);
+      sendBackend(buf);
     }
-    if (buf->readableBytes() > 0)
+    else
     {
-      sendBackendPacket(id, buf);
+      // all frames of the chunk together, one send instead of one per frame.
+      Buffer frames(len + (len / kMaxPacketLen + 1) * kHeaderLen);
+      while (buf->readableBytes() > 0)
+      {
+        len = std::min(buf->readableBytes(), kMaxPacketLen);
+        makeHeader(header, id, len);
+        frames.append(header, kHeaderLen);
+        frames.append(buf->peek(), len);
+        buf->retrieve(len);
+      }
+      sendBackend(&frames);
     }
   }
 
@@ -122,13 +137,10 @@ class MultiplexServer
         id |= (static_cast<uint8_t>(buf->peek()[2]) << 8);
 
         TcpConnectionPtr clientConn;
+        if (id > 0 && id <= kMaxConns)
         {
           MutexLockGuard lock(mutex_);
-          std::map<int, TcpConnectionPtr>::iterator it = clientConns_.find(id);
-          if (it != clientConns_.end())
-          {
-            clientConn = it->second;
-          }
+          clientConn = clientConns_[id];
         }
         if (clientConn)
         {
@@ -185,12 +197,12 @@ class MultiplexServer
         if (backendConn_)
         {
           availIds_.push(id);
-          clientConns_.erase(id);
+          clientConns_[id].reset();
         }
         else
         {
           assert(availIds_.empty());
-          assert(clientConns_.empty());
+          assert(!clientConns_[id]);
         }
       }
     }
@@ -222,6 +234,8 @@ class MultiplexServer
     std::vector<TcpConnectionPtr> connsToDestroy;
     if (conn->connected())
     {
+      // frames from all clients queued in one loop iteration go out together.
+      conn->setDeferredFlush(true);
       MutexLockGuard lock(mutex_);
       backendConn_ = conn;
       assert(availIds_.empty());
@@ -234,14 +248,14 @@ class MultiplexServer
     {
       MutexLockGuard lock(mutex_);
       backendConn_.reset();
-      connsToDestroy.reserve(clientConns_.size());
-      for (std::map<int, TcpConnectionPtr>::iterator it = clientConns_.begin();
-          it != clientConns_.end();
-          ++it)
+      for (size_t i = 0; i < clientConns_.size(); ++i)
       {
-        connsToDestroy.push_back(it->second);
+        if (clientConns_[i])
+        {
+          connsToDestroy.push_back(clientConns_[i]);
+          clientConns_[i].reset();
+        }
       }
-      clientConns_.clear();
       while (!availIds_.empty())
       {
         availIds_.pop();
@@ -289,7 +303,7 @@ class MultiplexServer
   Timestamp startTime_;
   MutexLock mutex_;
   TcpConnectionPtr backendConn_;
-  std::map<int, TcpConnectionPtr> clientConns_;
+  std::vector<TcpConnectionPtr> clientConns_;  // indexed by id, 0 unused
   std::queue<int> availIds_;
 };
 
@@ -16,14 +16,25 @@
 using namespace muduo;
 using namespace muduo::net;
 
+int g_busyPollUs = 0;
+
 void onConnection(const TcpConnectionPtr& conn)
 {
   if (conn->connected())
   {
     conn->setTcpNoDelay(true);
+    if (g_busyPollUs > 0)
+    {
+      conn->setBusyPoll(g_busyPollUs);
+    }
   }
 }
 
+void threadInit(EventLoop* loop)
+{
+  loop->setBusyPoll(g_busyPollUs);
+}
+
 void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
 {
   conn->send(buf);
@@ -33,7 +44,7 @@ int main(int argc, char* argv[])
 {
   if (argc < 4)
   {
-    fprintf(stderr, "Usage: server <address> <port> <threads>\n");
+    fprintf(stderr, "Usage: server <address> <port> <threads> [busy_poll_us]\n");
   }
   else
   {
@@ -44,6 +55,10 @@ int main(int argc, char* argv[])
     uint16_t port = static_cast<uint16_t>(atoi(argv[2]));
     InetAddress listenAddr(ip, port);
     int threadCount = atoi(argv[3]);
+    if (argc > 4)
+    {
+      g_busyPollUs = atoi(argv[4]);
+    }
 
     EventLoop loop;
 
@@ -51,6 +66,7 @@ int main(int argc, char* argv[])
 
     server.setConnectionCallback(onConnection);
     server.setMessageCallback(onMessage);
+    server.setThreadInitCallback(threadInit);
 
     if (threadCount > 1)
     {
@@ -8,6 +8,7 @@
 
 #include "codec.h"
 
+#include <muduo/base/Crc32c.h>
 #include <muduo/base/Logging.h>
 #include <muduo/net/Endian.h>
 #include <muduo/net/protorpc/google-inl.h>
@@ -19,7 +20,26 @@
 using namespace muduo;
 using namespace muduo::net;
 
-void ProtobufCodec::fillEmptyBuffer(Buffer* buf, const google::protobuf::Message& message)
+namespace
+{
+int32_t checksum(ProtobufCodec::ChecksumType type, const char* buf, int len)
+{
+  switch (type)
+  {
+   case ProtobufCodec::kCrc32c:
+     return static_cast<int32_t>(muduo::crc32c::value(buf, len));
+   case ProtobufCodec::kNoChecksum:
+     return 0;
+   default:
+     return static_cast<int32_t>(
+         ::adler32(1, reinterpret_cast<const Bytef*>(buf), len));
+  }
+}
+}
+
+void ProtobufCodec::fillEmptyBuffer(Buffer* buf,
+                                    const google::protobuf::Message& message,
+                                    ChecksumType type)
 {
   // buf->retrieveAll();
   assert(buf->readableBytes() == 0);
@@ -43,13 +63,12 @@ void ProtobufCodec::fillEmptyBuffer(Buffer* buf, const google::protobuf::Message
   }
   buf->hasWritten(byte_size);
 
-  int32_t checkSum = static_cast<int32_t>(
-      ::adler32(1,
-                reinterpret_cast<const Bytef*>(buf->peek()),
-                static_cast<int>(buf->readableBytes())));
+  int32_t checkSum = checksum(type, buf->peek(), static_cast<int>(buf->readableBytes()));
   buf->appendInt32(checkSum);
   assert(buf->readableBytes() == sizeof nameLen + nameLen + byte_size + sizeof checkSum);
-  int32_t len = sockets::hostToNetwork32(static_cast<int32_t>(buf->readableBytes()));
+  uint32_t header = static_cast<uint32_t>(type) << kChecksumTypeShift
+                  | static_cast<uint32_t>(buf->readableBytes());
+  int32_t len = sockets::hostToNetwork32(static_cast<int32_t>(header));
   buf->prepend(&len, sizeof len);
 }
 
@@ -118,16 +137,24 @@ void ProtobufCodec::onMessage(const TcpConnectionPtr& conn,
 {
   while (buf->readableBytes() >= kMinMessageLen + kHeaderLen)
   {
-    const int32_t len = buf->peekInt32();
+    const uint32_t header = static_cast<uint32_t>(buf->peekInt32());
+    const int32_t len = static_cast<int32_t>(header & ((1u << kChecksumTypeShift) - 1));
+    const uint32_t type = header >> kChecksumTypeShift;
     if (len > kMaxMessageLen || len < kMinMessageLen)
     {
       errorCallback_(conn, buf, receiveTime, kInvalidLength);
       break;
     }
+    else if (type > kNoChecksum)
+    {
+      errorCallback_(conn, buf, receiveTime, kCheckSumError);
+      break;
+    }
     else if (buf->readableBytes() >= implicit_cast<size_t>(len + kHeaderLen))
     {
       ErrorCode errorCode = kNoError;
-      MessagePtr message = parse(buf->peek()+kHeaderLen, len, &errorCode);
+      MessagePtr message = parse(buf->peek()+kHeaderLen, len, &errorCode,
+                                 static_cast<ChecksumType>(type));
       if (errorCode == kNoError && message)
       {
         messageCallback_(conn, message, receiveTime);
@@ -163,17 +190,15 @@ google::protobuf::Message* ProtobufCodec::createMessage(const std::string& typeN
   return message;
 }
 
-MessagePtr ProtobufCodec::parse(const char* buf, int len, ErrorCode* error)
+MessagePtr ProtobufCodec::parse(const char* buf, int len, ErrorCode* error,
+                                ChecksumType type)
 {
   MessagePtr message;
 
   // check sum
   int32_t expectedCheckSum = asInt32(buf + len - kHeaderLen);
-  int32_t checkSum = static_cast<int32_t>(
-      ::adler32(1,
-                reinterpret_cast<const Bytef*>(buf),
-                static_cast<int>(len - kHeaderLen)));
-  if (checkSum == expectedCheckSum)
+  int32_t checkSum = checksum(type, buf, len - kHeaderLen);
+  if (type == kNoChecksum || checkSum == expectedCheckSum)
   {
     // get message type name
     int32_t nameLen = asInt32(buf);
@@ -46,6 +46,15 @@ class ProtobufCodec : boost::noncopyable
     kParseError,
   };
 
+  // carried in the top 4 bits of the length field,
+  // kAdler32 (0) frames are the original format.
+  enum ChecksumType
+  {
+    kAdler32 = 0,
+    kCrc32c = 1,
+    kNoChecksum = 2,
+  };
+
   typedef boost::function<void (const muduo::net::TcpConnectionPtr&,
                                 const MessagePtr&,
                                 muduo::Timestamp)> ProtobufMessageCallback;
@@ -57,14 +66,22 @@ class ProtobufCodec : boost::noncopyable
 
   explicit ProtobufCodec(const ProtobufMessageCallback& messageCb)
     : messageCallback_(messageCb),
-      errorCallback_(defaultErrorCallback)
+      errorCallback_(defaultErrorCallback),
+      checksumType_(kAdler32)
   {
   }
 
   ProtobufCodec(const ProtobufMessageCallback& messageCb, const ErrorCallback& errorCb)
     : messageCallback_(messageCb),
-      errorCallback_(errorCb)
+      errorCallback_(errorCb),
+      checksumType_(kAdler32)
+  {
+  }
+
+  // peers without checksum types only understand kAdler32
+  void setChecksumType(ChecksumType type)
   {
+    checksumType_ = type;
   }
 
   void onMessage(const muduo::net::TcpConnectionPtr& conn,
@@ -76,14 +93,17 @@ class ProtobufCodec : boost::noncopyable
   {
     // FIXME: serialize to TcpConnection::outputBuffer()
     muduo::net::Buffer buf;
-    fillEmptyBuffer(&buf, message);
+    fillEmptyBuffer(&buf, message, checksumType_);
     conn->send(&buf);
   }
 
   static const muduo::string& errorCodeToString(ErrorCode errorCode);
-  static void fillEmptyBuffer(muduo::net::Buffer* buf, const google::protobuf::Message& message);
+  static void fillEmptyBuffer(muduo::net::Buffer* buf,
+                              const google::protobuf::Message& message,
+                              ChecksumType type = kAdler32);
   static google::protobuf::Message* createMessage(const std::string& type_name);
-  static MessagePtr parse(const char* buf, int len, ErrorCode* errorCode);
+  static MessagePtr parse(const char* buf, int len, ErrorCode* errorCode,
+                          ChecksumType type = kAdler32);
 
  private:
   static void defaultErrorCallback(const muduo::net::TcpConnectionPtr&,
@@ -93,7 +113,9 @@ class ProtobufCodec : boost::noncopyable
 
   ProtobufMessageCallback messageCallback_;
   ErrorCallback errorCallback_;
+  ChecksumType checksumType_;
 
+  const static int kChecksumTypeShift = 28;
   const static int kHeaderLen = sizeof(int32_t);
   const static int kMinMessageLen = 2*kHeaderLen + 2; // nameLen + typeName + checkSum
   const static int kMaxMessageLen = 64*1024*1024; // same as codec_stream.h kDefaultTotalBytesLimit
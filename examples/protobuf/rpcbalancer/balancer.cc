@@ -1,120 +1,23 @@
+#include <muduo/base/CountDownLatch.h>
 #include <muduo/base/Logging.h>
 #include <muduo/base/ThreadLocal.h>
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/EventLoopThreadPool.h>
-#include <muduo/net/TcpClient.h>
+#include <muduo/net/TcpClientPool.h>
 #include <muduo/net/TcpServer.h>
 #include <muduo/net/protorpc/RpcCodec.h>
 #include <muduo/net/protorpc/rpc.pb.h>
 
 #include <boost/bind.hpp>
-#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <map>
 
 #include <stdio.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
-class BackendSession : boost::noncopyable
-{
- public:
-  BackendSession(EventLoop* loop, const InetAddress& backendAddr, const string& name)
-    : loop_(loop),
-      client_(loop, backendAddr, name),
-      codec_(boost::bind(&BackendSession::onRpcMessage, this, _1, _2, _3)),
-      nextId_(0)
-  {
-    client_.setConnectionCallback(
-        boost::bind(&BackendSession::onConnection, this, _1));
-    client_.setMessageCallback(
-        boost::bind(&RpcCodec::onMessage, &codec_, _1, _2, _3));
-    client_.enableRetry();
-  }
-
-  void connect()
-  {
-    client_.connect();
-  }
-
-  // FIXME: add health check
-  bool send(RpcMessage& msg, const TcpConnectionPtr& clientConn)
-  {
-    loop_->assertInLoopThread();
-    if (conn_)
-    {
-      uint64_t id = ++nextId_;
-      Request r = { msg.id(), clientConn };
-      assert(outstandings_.find(id) == outstandings_.end());
-      outstandings_[id] = r;
-      msg.set_id(id);
-      codec_.send(conn_, msg);
-      // LOG_DEBUG << "forward " << r.origId << " from " << clientConn->name()
-      //           << " as " << id << " to " << conn_->name();
-      return true;
-    }
-    else
-      return false;
-  }
-
- private:
-  void onConnection(const TcpConnectionPtr& conn)
-  {
-    loop_->assertInLoopThread();
-    LOG_INFO << "Backend "
-             << conn->localAddress().toIpPort() << " -> "
-             << conn->peerAddress().toIpPort() << " is "
-             << (conn->connected() ? "UP" : "DOWN");
-    if (conn->connected())
-    {
-      conn_ = conn;
-    }
-    else
-    {
-      conn_.reset();
-      // FIXME: reject pending
-    }
-  }
-
-  void onRpcMessage(const TcpConnectionPtr&,
-                    const RpcMessagePtr& msg,
-                    Timestamp)
-  {
-    loop_->assertInLoopThread();
-    std::map<uint64_t, Request>::iterator it = outstandings_.find(msg->id());
-    if (it != outstandings_.end())
-    {
-      uint64_t origId = it->second.origId;
-      TcpConnectionPtr clientConn = it->second.clientConn.lock();
-      outstandings_.erase(it);
-
-      if (clientConn)
-      {
-        // LOG_DEBUG << "send back " << origId << " of " << clientConn->name()
-        //           << " using " << msg.id() << " from " << conn_->name();
-        msg->set_id(origId);
-        codec_.send(clientConn, *msg);
-      }
-    }
-    else
-    {
-      // LOG_ERROR
-    }
-  }
-
-  struct Request
-  {
-    uint64_t origId;
-    boost::weak_ptr<TcpConnection> clientConn;
-  };
-
-  EventLoop* loop_;
-  TcpClient client_;
-  RpcCodec codec_;
-  TcpConnectionPtr conn_;
-  uint64_t nextId_;
-  std::map<uint64_t, Request> outstandings_;
-};
-
 class Balancer : boost::noncopyable
 {
  public:
@@ -125,10 +28,9 @@ class Balancer : boost::noncopyable
     : loop_(loop),
       server_(loop, listenAddr, name),
       codec_(boost::bind(&Balancer::onRpcMessage, this, _1, _2, _3)),
+      backendCodec_(boost::bind(&Balancer::onBackendRpcMessage, this, _1, _2, _3)),
       backends_(backends)
   {
-    server_.setThreadInitCallback(
-        boost::bind(&Balancer::initPerThread, this, _1));
     server_.setConnectionCallback(
         boost::bind(&Balancer::onConnection, this, _1));
     server_.setMessageCallback(
@@ -137,6 +39,19 @@ class Balancer : boost::noncopyable
 
   ~Balancer()
   {
+    if (pool_)
+    {
+      // IO threads run until server_ goes, they stop forwarding to
+      // backends before pool_ does.
+      std::vector<EventLoop*> loops = server_.threadPool()->getAllLoops();
+      CountDownLatch latch(static_cast<int>(loops.size()));
+      for (size_t i = 0; i < loops.size(); ++i)
+      {
+        loops[i]->runInLoop(boost::bind(&Balancer::stopForwarding, this, &latch));
+      }
+      latch.wait();
+      pool_.reset();
+    }
   }
 
   void setThreadNum(int numThreads)
@@ -147,30 +62,36 @@ class Balancer : boost::noncopyable
   void start()
   {
     server_.start();
+    // connects to backends in every IO thread, before clients come.
+    pool_.reset(new TcpClientPool(server_.threadPool()->getAllLoops(),
+                                  backends_, server_.name()));
+    pool_->setConnectionCallback(
+        boost::bind(&Balancer::onBackendConnection, this, _1));
+    pool_->setMessageCallback(
+        boost::bind(&RpcCodec::onMessage, &backendCodec_, _1, _2, _3));
+    pool_->start();
   }
 
  private:
-  struct PerThread
+  struct Request
   {
-    size_t current;
-    boost::ptr_vector<BackendSession> backends;
-    PerThread() : current(0) { }
+    uint64_t origId;
+    boost::weak_ptr<TcpConnection> clientConn;
+    const TcpConnection* backendConn;
   };
 
-  void initPerThread(EventLoop* ioLoop)
+  struct PerThread
   {
-    int count = threadCount_.getAndAdd(1);
-    LOG_INFO << "IO thread " << count;
-    PerThread& t = t_backends_.value();
-    t.current = count % backends_.size();
+    uint64_t nextId;
+    std::map<uint64_t, Request> outstandings;
+    bool stopped;
+    PerThread() : nextId(0), stopped(false) { }
+  };
 
-    for (size_t i = 0; i < backends_.size(); ++i)
-    {
-      char buf[32];
-      snprintf(buf, sizeof buf, "%s#%d", backends_[i].toIpPort().c_str(), count);
-      t.backends.push_back(new BackendSession(ioLoop, backends_[i], buf));
-      t.backends.back().connect();
-    }
+  void stopForwarding(CountDownLatch* latch)
+  {
+    t_backends_.value().stopped = true;
+    latch->countDown();
   }
 
   void onConnection(const TcpConnectionPtr& conn)
@@ -185,28 +106,88 @@ class Balancer : boost::noncopyable
     }
   }
 
+  void onBackendConnection(const TcpConnectionPtr& conn)
+  {
+    LOG_INFO << "Backend "
+             << conn->localAddress().toIpPort() << " -> "
+             << conn->peerAddress().toIpPort() << " is "
+             << (conn->connected() ? "UP" : "DOWN");
+    if (!conn->connected())
+    {
+      // responses of requests sent on conn never come.
+      std::map<uint64_t, Request>& outstandings = t_backends_.value().outstandings;
+      std::map<uint64_t, Request>::iterator it = outstandings.begin();
+      while (it != outstandings.end())
+      {
+        if (it->second.backendConn == get_pointer(conn))
+        {
+          outstandings.erase(it++);
+        }
+        else
+        {
+          ++it;
+        }
+      }
+    }
+  }
+
   void onRpcMessage(const TcpConnectionPtr& conn,
                     const RpcMessagePtr& msg,
                     Timestamp)
   {
     PerThread& t = t_backends_.value();
-    bool succeed = false;
-    for (size_t i = 0; i < t.backends.size() && !succeed; ++i)
+    if (t.stopped)
     {
-      succeed = t.backends[t.current].send(*msg, conn);
-      t.current = (t.current+1) % t.backends.size();
+      return;
     }
-    if (!succeed)
+    TcpConnectionPtr backendConn = pool_->getConnection();
+    if (backendConn)
+    {
+      uint64_t id = ++t.nextId;
+      Request r = { msg->id(), conn, get_pointer(backendConn) };
+      assert(t.outstandings.find(id) == t.outstandings.end());
+      t.outstandings[id] = r;
+      msg->set_id(id);
+      pool_->requestStarted(backendConn);
+      backendCodec_.send(backendConn, *msg);
+    }
+    else
     {
       // FIXME: no backend available
     }
   }
 
+  void onBackendRpcMessage(const TcpConnectionPtr& backendConn,
+                           const RpcMessagePtr& msg,
+                           Timestamp)
+  {
+    std::map<uint64_t, Request>& outstandings = t_backends_.value().outstandings;
+    std::map<uint64_t, Request>::iterator it = outstandings.find(msg->id());
+    if (it != outstandings.end())
+    {
+      uint64_t origId = it->second.origId;
+      TcpConnectionPtr clientConn = it->second.clientConn.lock();
+      outstandings.erase(it);
+      pool_->requestFinished(backendConn, true);
+
+      if (clientConn)
+      {
+        msg->set_id(origId);
+        codec_.send(clientConn, *msg);
+      }
+    }
+    else
+    {
+      // LOG_ERROR
+    }
+  }
+
   EventLoop* loop_;
   TcpServer server_;
   RpcCodec codec_;
+  RpcCodec backendCodec_;
   std::vector<InetAddress> backends_;
-  AtomicInt32 threadCount_;
+  boost::scoped_ptr<TcpClientPool> pool_;
   ThreadLocal<PerThread> t_backends_;
 };
 
@@ -37,6 +37,12 @@ int main(int argc, char* argv[])
   RpcServer server(&loop, listenAddr);
   server.setThreadNum(nThreads);
   server.registerService(&impl);
+  int nWorkers = argc > 3 ? atoi(argv[3]) : 0;
+  if (nWorkers > 0)
+  {
+    server.setExecutor(echo::EchoService::descriptor(),
+                       RpcExecutorPtr(new RpcExecutor("EchoWorker", nWorkers, 10000)));
+  }
   server.start();
   loop.loop();
 }
@@ -9,6 +9,7 @@ using namespace muduo;
 using namespace muduo::net;
 
 const size_t frameLen = 2*sizeof(int64_t);
+int busyPollUs = 0;
 
 void serverConnectionCallback(const TcpConnectionPtr& conn)
 {
@@ -18,6 +19,7 @@ void serverConnectionCallback(const TcpConnectionPtr& conn)
   if (conn->connected())
   {
     conn->setTcpNoDelay(true);
+    conn->setBusyPoll(busyPollUs);
   }
   else
   {
@@ -41,6 +43,7 @@ void serverMessageCallback(const TcpConnectionPtr& conn,
 void runServer(uint16_t port)
 {
   EventLoop loop;
+  loop.setBusyPoll(busyPollUs);
   TcpServer server(&loop, InetAddress(port), "ClockServer");
   server.setConnectionCallback(serverConnectionCallback);
   server.setMessageCallback(serverMessageCallback);
@@ -59,6 +62,7 @@ void clientConnectionCallback(const TcpConnectionPtr& conn)
   {
     clientConnection = conn;
     conn->setTcpNoDelay(true);
+    conn->setBusyPoll(busyPollUs);
   }
   else
   {
@@ -97,6 +101,7 @@ void sendMyTime()
 void runClient(const char* ip, uint16_t port)
 {
   EventLoop loop;
+  loop.setBusyPoll(busyPollUs);
   TcpClient client(&loop, InetAddress(ip, port), "ClockClient");
   client.enableRetry();
   client.setConnectionCallback(clientConnectionCallback);
@@ -111,6 +116,10 @@ int main(int argc, char* argv[])
   if (argc > 2)
   {
     uint16_t port = static_cast<uint16_t>(atoi(argv[2]));
+    if (argc > 3)
+    {
+      busyPollUs = atoi(argv[3]);
+    }
     if (strcmp(argv[1], "-s") == 0)
     {
       runServer(port);
@@ -122,7 +131,7 @@ int main(int argc, char* argv[])
   }
   else
   {
-    printf("Usage:\n%s -s port\n%s ip port\n", argv[0], argv[0]);
+    printf("Usage:\n%s -s port [busy_poll_us]\n%s ip port [busy_poll_us]\n", argv[0], argv[0]);
   }
 }
 
@@ -1,6 +1,7 @@
 #include <muduo/net/http/HttpServer.h>
 #include <muduo/net/http/HttpRequest.h>
 #include <muduo/net/http/HttpResponse.h>
+#include <muduo/net/http/HttpRouter.h>
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/EventLoopThreadPool.h>
 #include <muduo/base/Logging.h>
@@ -19,7 +20,7 @@ bool benchmark = false;
 
 std::map<string, string> redirections;
 
-void onRequest(const HttpRequest& req, HttpResponse* resp)
+void onRequest(const HttpRouter* router, const HttpRequest& req, HttpResponse* resp)
 {
   LOG_INFO << "Headers " << req.methodString() << " " << req.path();
   if (!benchmark)
@@ -32,49 +33,48 @@ void onRequest(const HttpRequest& req, HttpResponse* resp)
       LOG_DEBUG << it->first << ": " << it->second;
     }
   }
+  router->route(req, resp);
+}
 
-  // TODO: support PUT and DELETE to create new redirections on-the-fly.
+// TODO: support PUT and DELETE to create new redirections on-the-fly.
 
-  std::map<string, string>::const_iterator it = redirections.find(req.path());
-  if (it != redirections.end())
-  {
-    resp->setStatusCode(HttpResponse::k301MovedPermanently);
-    resp->setStatusMessage("Moved Permanently");
-    resp->addHeader("Location", it->second);
-    // resp->setCloseConnection(true);
-  }
-  else if (req.path() == "/")
-  {
-    resp->setStatusCode(HttpResponse::k200Ok);
-    resp->setStatusMessage("OK");
-    resp->setContentType("text/html");
-    string now = Timestamp::now().toFormattedString();
-    std::map<string, string>::const_iterator i = redirections.begin();
-    string text;
-    for (; i != redirections.end(); ++i)
-    {
-      text.append("<ul>" + i->first + " =&gt; " + i->second + "</ul>");
-    }
+void onRedirect(const string& location,
+                const HttpRequest& req,
+                const HttpRouter::Params&,
+                HttpResponse* resp)
+{
+  resp->setStatusCode(HttpResponse::k301MovedPermanently);
+  resp->setStatusMessage("Moved Permanently");
+  resp->addHeader("Location", location);
+  // resp->setCloseConnection(true);
+}
 
-    resp->setBody("<html><head><title>My tiny short url service</title></head>"
-        "<body><h1>Known redirections</h1>"
-        + text +
-        "Now is " + now +
-        "</body></html>");
-  }
-  else if (req.path() == "/favicon.ico")
-  {
-    resp->setStatusCode(HttpResponse::k200Ok);
-    resp->setStatusMessage("OK");
-    resp->setContentType("image/png");
-    resp->setBody(string(favicon, sizeof favicon));
-  }
-  else
+void onIndex(const HttpRequest& req, const HttpRouter::Params&, HttpResponse* resp)
+{
+  resp->setStatusCode(HttpResponse::k200Ok);
+  resp->setStatusMessage("OK");
+  resp->setContentType("text/html");
+  string now = Timestamp::now().toFormattedString();
+  std::map<string, string>::const_iterator i = redirections.begin();
+  string text;
+  for (; i != redirections.end(); ++i)
   {
-    resp->setStatusCode(HttpResponse::k404NotFound);
-    resp->setStatusMessage("Not Found");
-    resp->setCloseConnection(true);
+    text.append("<ul>" + i->first + " =&gt; " + i->second + "</ul>");
   }
+
+  resp->setBody("<html><head><title>My tiny short url service</title></head>"
+      "<body><h1>Known redirections</h1>"
+      + text +
+      "Now is " + now +
+      "</body></html>");
+}
+
+void onFavicon(const HttpRequest& req, const HttpRouter::Params&, HttpResponse* resp)
+{
+  resp->setStatusCode(HttpResponse::k200Ok);
+  resp->setStatusMessage("OK");
+  resp->setContentType("image/png");
+  resp->setBody(string(favicon, sizeof favicon));
 }
 
 int main(int argc, char* argv[])
@@ -82,6 +82,16 @@ int main(int argc, char* argv[])
   redirections["/1"] = "http://chenshuo.com";
   redirections["/2"] = "http://blog.csdn.net/Solstice";
 
+  HttpRouter router;
+  router.get("/", onIndex);
+  router.get("/favicon.ico", onFavicon);
+  for (std::map<string, string>::const_iterator it = redirections.begin();
+       it != redirections.end();
+       ++it)
+  {
+    router.get(it->first, boost::bind(onRedirect, it->second, _1, _2, _3));
+  }
+
   int numThreads = 0;
   if (argc > 1)
   {
@@ -111,7 +121,8 @@ int main(int argc, char* argv[])
                                      InetAddress(8000),
                                      "shorturl",
                                      TcpServer::kReusePort));
-    servers.back().setHttpCallback(onRequest);
+    servers.back().setHttpCallback(
+        boost::bind(onRequest, &router, _1, _2));
     servers.back().getLoop()->runInLoop(
         boost::bind(&HttpServer::start, &servers.back()));
   }
@@ -120,7 +131,7 @@ int main(int argc, char* argv[])
   LOG_WARN << "Normal";
   EventLoop loop;
   HttpServer server(&loop, InetAddress(8000), "shorturl");
-  server.setHttpCallback(onRequest);
+  server.setHttpCallback(boost::bind(onRequest, &router, _1, _2));
   server.setThreadNum(numThreads);
   server.start();
   loop.loop();
@@ -9,6 +9,7 @@ using namespace muduo::net;
 
 EventLoop* g_eventLoop;
 InetAddress* g_serverAddr;
+bool g_splice = false;
 std::map<string, TunnelPtr> g_tunnels;
 
 void onServerConnection(const TcpConnectionPtr& conn)
@@ -19,6 +20,7 @@ void onServerConnection(const TcpConnectionPtr& conn)
     conn->setTcpNoDelay(true);
     conn->stopRead();
     TunnelPtr tunnel(new Tunnel(g_eventLoop, *g_serverAddr, conn));
+    tunnel->setSplice(g_splice);
     tunnel->setup();
     tunnel->connect();
     g_tunnels[conn->name()] = tunnel;
@@ -51,7 +53,7 @@ int main(int argc, char* argv[])
 {
   if (argc < 4)
   {
-    fprintf(stderr, "Usage: %s <host_ip> <port> <listen_port>\n", argv[0]);
+    fprintf(stderr, "Usage: %s <host_ip> <port> <listen_port> [splice]\n", argv[0]);
   }
   else
   {
@@ -68,6 +70,7 @@ int main(int argc, char* argv[])
     g_serverAddr = &serverAddr;
 
     uint16_t acceptPort = static_cast<uint16_t>(atoi(argv[3]));
+    g_splice = argc > 4 && strcmp(argv[4], "splice") == 0;
     InetAddress listenAddr(acceptPort);
 
     EventLoop loop;
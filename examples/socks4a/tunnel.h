@@ -18,7 +18,8 @@ class Tunnel : public boost::enable_shared_from_this<Tunnel>,
          const muduo::net::InetAddress& serverAddr,
          const muduo::net::TcpConnectionPtr& serverConn)
     : client_(loop, serverAddr, serverConn->name()),
-      serverConn_(serverConn)
+      serverConn_(serverConn),
+      splice_(false)
   {
     LOG_INFO << "Tunnel " << serverConn->peerAddress().toIpPort()
              << " <-> " << serverAddr.toIpPort();
@@ -29,6 +30,12 @@ class Tunnel : public boost::enable_shared_from_this<Tunnel>,
     LOG_INFO << "~Tunnel";
   }
 
+  // relay with splice(2) in kernel, instead of through input buffers.
+  void setSplice(bool on)
+  {
+    splice_ = on;
+  }
+
   void setup()
   {
     client_.setConnectionCallback(
@@ -82,6 +89,12 @@ class Tunnel : public boost::enable_shared_from_this<Tunnel>,
       {
         conn->send(serverConn_->inputBuffer());
       }
+      if (splice_)
+      {
+        // backpressure comes from the pipes, not high water marks.
+        serverConn_->startSplice(conn);
+        conn->startSplice(serverConn_);
+      }
     }
     else
     {
@@ -183,6 +196,7 @@ class Tunnel : public boost::enable_shared_from_this<Tunnel>,
   muduo::net::TcpClient client_;
   muduo::net::TcpConnectionPtr serverConn_;
   muduo::net::TcpConnectionPtr clientConn_;
+  bool splice_;
 };
 typedef boost::shared_ptr<Tunnel> TunnelPtr;
 
@@ -0,0 +1,136 @@
+#include <muduo/base/Crc32c.h>
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define MUDUO_CRC32C_HARDWARE 1
+#endif
+
+namespace
+{
+
+const uint32_t kPolynomial = 0x82f63b78;  // reversed 0x1EDC6F41
+
+struct Tables
+{
+  Tables()
+  {
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+      uint32_t crc = i;
+      for (int j = 0; j < 8; ++j)
+      {
+        crc = (crc >> 1) ^ (kPolynomial & (0 - (crc & 1)));
+      }
+      table[0][i] = crc;
+    }
+    for (int k = 1; k < 8; ++k)
+    {
+      for (uint32_t i = 0; i < 256; ++i)
+      {
+        uint32_t crc = table[k-1][i];
+        table[k][i] = (crc >> 8) ^ table[0][crc & 0xff];
+      }
+    }
+  }
+
+  uint32_t table[8][256];
+};
+
+const Tables kTables;
+
+uint32_t extendTable(uint32_t l, const uint8_t* p, const uint8_t* end)
+{
+  const uint32_t (*t)[256] = kTables.table;
+  while (end - p >= 8)
+  {
+    uint32_t lo;
+    uint32_t hi;
+    memcpy(&lo, p, sizeof lo);  // little endian
+    memcpy(&hi, p + 4, sizeof hi);
+    lo ^= l;
+    l = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+      ^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    p += 8;
+  }
+  while (p != end)
+  {
+    l = t[0][(l ^ *p++) & 0xff] ^ (l >> 8);
+  }
+  return l;
+}
+
+#ifdef MUDUO_CRC32C_HARDWARE
+// compiled for SSE4.2 whatever -march is, only called if the CPU has it.
+__attribute__((target("sse4.2")))
+uint32_t extendHardware(uint32_t crc, const uint8_t* p, const uint8_t* end)
+{
+  while (p != end && reinterpret_cast<uintptr_t>(p) % 8 != 0)
+  {
+    crc = _mm_crc32_u8(crc, *p++);
+  }
+#ifdef __x86_64__
+  uint64_t l = crc;
+  while (end - p >= 8)
+  {
+    uint64_t word;
+    memcpy(&word, p, sizeof word);
+    l = _mm_crc32_u64(l, word);
+    p += 8;
+  }
+  crc = static_cast<uint32_t>(l);
+#endif
+  while (end - p >= 4)
+  {
+    uint32_t word;
+    memcpy(&word, p, sizeof word);
+    crc = _mm_crc32_u32(crc, word);
+    p += 4;
+  }
+  while (p != end)
+  {
+    crc = _mm_crc32_u8(crc, *p++);
+  }
+  return crc;
+}
+
+bool detectHardware()
+{
+#ifdef __SSE4_2__
+  return true;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+// checked once at startup, before main().
+const bool kHardware = detectHardware();
+#endif
+
+}
+
+uint32_t muduo::crc32c::extend(uint32_t crc, const void* data, size_t len)
+{
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  const uint8_t* end = p + len;
+  uint32_t l = crc ^ 0xffffffffu;
+
+#ifdef MUDUO_CRC32C_HARDWARE
+  if (kHardware)
+  {
+    return extendHardware(l, p, end) ^ 0xffffffffu;
+  }
+#endif
+  return extendTable(l, p, end) ^ 0xffffffffu;
+}
+
+bool muduo::crc32c::isHardwareAccelerated()
+{
+#ifdef MUDUO_CRC32C_HARDWARE
+  return kHardware;
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,38 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#ifndef MUDUO_BASE_CRC32C_H
+#define MUDUO_BASE_CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace muduo
+{
+namespace crc32c
+{
+
+///
+/// CRC-32C (Castagnoli polynomial), as computed by the SSE4.2 crc32 instruction.
+///
+/// Uses the instruction if the CPU running the program has SSE4.2
+/// (Nehalem or later), checked at startup, whatever -march the library
+/// was built with.  A slicing-by-8 table otherwise.
+///
+
+/// Returns crc of data appended to the data that produced crc.
+uint32_t extend(uint32_t crc, const void* data, size_t len);
+
+inline uint32_t value(const void* data, size_t len)
+{
+  return extend(0, data, len);
+}
+
+bool isHardwareAccelerated();
+
+}
+}
+
+#endif  // MUDUO_BASE_CRC32C_H
@@ -248,3 +248,62 @@ std::vector<pid_t> ProcessInfo::threads()
   return result;
 }
 
+std::vector<int> ProcessInfo::numaNodeCpus(int node)
+{
+  char filename[64];
+  snprintf(filename, sizeof filename, "/sys/devices/system/node/node%d/cpulist", node);
+  string cpulist;
+  if (FileUtil::readFile(filename, 4096, &cpulist) == 0)
+  {
+    return parseCpuList(cpulist);
+  }
+  return std::vector<int>();
+}
+
+namespace
+{
+// parses digits at *p, false if none or too large for a CPU number.
+bool parseCpu(const char** p, const char* end, int* cpu)
+{
+  const int kMaxCpu = 1 << 20;
+  const char* start = *p;
+  int value = 0;
+  while (*p != end && **p >= '0' && **p <= '9' && value <= kMaxCpu)
+  {
+    value = value * 10 + (**p - '0');
+    ++*p;
+  }
+  *cpu = value;
+  return *p != start && value <= kMaxCpu;
+}
+}
+
+std::vector<int> ProcessInfo::parseCpuList(const StringPiece& cpulist)
+{
+  std::vector<int> result;
+  const char* p = cpulist.begin();
+  const char* end = cpulist.end();
+  int first = 0;
+  while (parseCpu(&p, end, &first))
+  {
+    int last = first;
+    if (p != end && *p == '-')
+    {
+      ++p;
+      if (!parseCpu(&p, end, &last) || last < first)
+      {
+        break;
+      }
+    }
+    for (int cpu = first; cpu <= last; ++cpu)
+    {
+      result.push_back(cpu);
+    }
+    if (p == end || *p != ',')
+    {
+      break;
+    }
+    ++p;
+  }
+  return result;
+}
@@ -61,6 +61,13 @@ namespace ProcessInfo
 
   int numThreads();
   std::vector<pid_t> threads();
+
+  /// CPUs of a NUMA node, from /sys/devices/system/node/nodeN/cpulist,
+  /// empty if no such node.
+  std::vector<int> numaNodeCpus(int node);
+
+  /// CPUs of a cpulist, eg. "0-3,8-11", up to the first malformed item.
+  std::vector<int> parseCpuList(const StringPiece& cpulist);
 }
 
 }
@@ -240,7 +240,49 @@ void Thread::start()//开启线程
   started_ = true;
   // FIXME: move(func_)
   detail::ThreadData* data = new detail::ThreadData(func_, name_, tid_);
-  if (pthread_create(&pthreadId_, NULL, &detail::startThread, data))
+  pthread_attr_t attr;
+  pthread_attr_t* pattr = NULL;
+  if (!cpus_.empty())
+  {
+    // set before creation, so the stack is first touched on these CPUs.
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (size_t i = 0; i < cpus_.size(); ++i)
+    {
+      if (cpus_[i] >= 0 && cpus_[i] < CPU_SETSIZE)
+      {
+        CPU_SET(cpus_[i], &cpuset);
+      }
+      else
+      {
+        LOG_ERROR << "Thread " << name_ << " - invalid cpu " << cpus_[i];
+      }
+    }
+    pthread_attr_init(&attr);
+    pattr = &attr;
+    int ret = CPU_COUNT(&cpuset) > 0
+        ? pthread_attr_setaffinity_np(&attr, sizeof cpuset, &cpuset) : EINVAL;
+    if (ret != 0)
+    {
+      LOG_ERROR << "Thread " << name_ << " - not pinned, "
+                << strerror_tl(ret);
+      pthread_attr_destroy(pattr);
+      pattr = NULL;
+    }
+  }
+  int err = pthread_create(&pthreadId_, pattr, &detail::startThread, data);
+  if (pattr)
+  {
+    pthread_attr_destroy(pattr);
+    if (err == EINVAL)
+    {
+      // eg. none of the CPUs is online, runs unpinned rather than not at all.
+      LOG_ERROR << "Thread " << name_ << " - not pinned, "
+                << strerror_tl(err);
+      err = pthread_create(&pthreadId_, NULL, &detail::startThread, data);
+    }
+  }
+  if (err)
   {
     started_ = false;
     delete data; // or no delete?
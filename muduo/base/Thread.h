@@ -14,9 +14,14 @@
 #include <boost/shared_ptr.hpp>
 #include <pthread.h>
 
+#include <vector>
+
 namespace muduo
 {
 
+// CPU numbers a thread may run on, empty means no restriction.
+typedef std::vector<int> CpuSet;
+
 class Thread : boost::noncopyable
 {
  public:
@@ -28,6 +33,10 @@ class Thread : boost::noncopyable
 #endif
   ~Thread();
 
+  // Must be called before start(), the thread is created on these CPUs.
+  void setCpuSet(const CpuSet& cpus) { cpus_ = cpus; }
+  const CpuSet& cpuSet() const { return cpus_; }
+
   void start();//开始
   int join(); // return pthread_join() 阻塞
 
@@ -47,6 +56,7 @@ class Thread : boost::noncopyable
   boost::shared_ptr<pid_t> tid_;//CurrentThread中的ID
   ThreadFunc func_;//线程函数
   string     name_;//线程名
+  CpuSet     cpus_;
 
   static AtomicInt32 numCreated_;//初始化32位原子整数
 };
@@ -45,6 +45,10 @@ void ThreadPool::start(int numThreads)
     //新建立进程，并用bind绑定函数进行传参
     threads_.push_back(new muduo::Thread(
           boost::bind(&ThreadPool::runInThread, this), name_+id));
+    if (!cpuSets_.empty())
+    {
+      threads_[i].setCpuSet(cpuSets_[i % cpuSets_.size()]);
+    }
     //运行线程
     threads_[i].start();
   }
@@ -16,6 +16,7 @@
 #include <boost/ptr_container/ptr_vector.hpp>
 
 #include <deque>
+#include <vector>
 
 namespace muduo
 {
@@ -37,6 +38,11 @@ class ThreadPool : boost::noncopyable
   void setThreadInitCallback(const Task& cb)
   { threadInitCallback_ = cb; }
 
+  // Must be called before start().
+  // Thread i runs on cpuSets[i % cpuSets.size()].
+  void setCpuSets(const std::vector<CpuSet>& cpuSets)
+  { cpuSets_ = cpuSets; }
+
   //开启线程池
   void start(int numThreads);
   
@@ -67,6 +73,7 @@ class ThreadPool : boost::noncopyable
   Condition notFull_;      //条件变量，是否满
   string name_;            //线程名字
   Task threadInitCallback_;//线程初始化化回调函数
+  std::vector<CpuSet> cpuSets_;
 
   boost::ptr_vector<muduo::Thread> threads_;//线程队列，利用指针容器实现
   std::deque<Task> queue_;    //双向队列
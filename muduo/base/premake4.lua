@@ -10,6 +10,7 @@ project "base"
             'AsyncLogging.cc',
             'Condition.cc',
             'CountDownLatch.cc',
+            'Crc32c.cc',
             'Date.cc',
             'Exception.cc',
             'FileUtil.cc',
@@ -0,0 +1,42 @@
+#include <muduo/base/Crc32c.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+int main()
+{
+  printf("hardware accelerated: %d\n", muduo::crc32c::isHardwareAccelerated());
+
+  // RFC 3720, B.4
+  char zeros[32] = { 0 };
+  assert(muduo::crc32c::value(zeros, sizeof zeros) == 0x8a9136aa);
+  char ones[32];
+  memset(ones, 0xff, sizeof ones);
+  assert(muduo::crc32c::value(ones, sizeof ones) == 0x62a8ab43);
+
+  const char* check = "123456789";
+  assert(muduo::crc32c::value(check, strlen(check)) == 0xe3069283);
+  assert(muduo::crc32c::value("", 0) == 0);
+
+  // extend() on any split gives the same result, at any alignment
+  std::string data;
+  for (int i = 0; i < 1000; ++i)
+  {
+    data.push_back(static_cast<char>(i * 7));
+  }
+  for (size_t offset = 0; offset < 8; ++offset)
+  {
+    const char* p = data.data() + offset;
+    size_t len = data.size() - offset;
+    uint32_t whole = muduo::crc32c::value(p, len);
+    for (size_t split = 0; split <= len; split += 37)
+    {
+      uint32_t crc = muduo::crc32c::extend(0, p, split);
+      assert(muduo::crc32c::extend(crc, p + split, len - split) == whole);
+    }
+  }
+  printf("All passed.\n");
+}
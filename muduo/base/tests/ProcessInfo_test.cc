@@ -1,4 +1,6 @@
+#undef NDEBUG
 #include <muduo/base/ProcessInfo.h>
+#include <assert.h>
 #include <stdio.h>
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
@@ -14,4 +16,18 @@ int main()
   printf("threads = %zd\n", muduo::ProcessInfo::threads().size());
   printf("num threads = %d\n", muduo::ProcessInfo::numThreads());
   printf("status = %s\n", muduo::ProcessInfo::procStatus().c_str());
+  printf("numa node 0 cpus = %zd\n", muduo::ProcessInfo::numaNodeCpus(0).size());
+
+  std::vector<int> cpus = muduo::ProcessInfo::parseCpuList("0-3,8,10-11\n");
+  const int expected[] = { 0, 1, 2, 3, 8, 10, 11 };
+  assert(cpus == std::vector<int>(expected, expected + sizeof expected / sizeof expected[0]));
+  assert(muduo::ProcessInfo::parseCpuList("5").size() == 1);
+  assert(muduo::ProcessInfo::parseCpuList("").empty());
+  assert(muduo::ProcessInfo::parseCpuList("\n").empty());
+  // stops at the first malformed item
+  assert(muduo::ProcessInfo::parseCpuList("0-1,3-2,4").size() == 2);
+  assert(muduo::ProcessInfo::parseCpuList("0,-1").size() == 1);
+  assert(muduo::ProcessInfo::parseCpuList("99999999999").empty());
+  // not NUL terminated
+  assert(muduo::ProcessInfo::parseCpuList(muduo::StringPiece("1-23", 3)).size() == 2);
 }
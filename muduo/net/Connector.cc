@@ -12,6 +12,7 @@
 #include <muduo/base/Logging.h>
 #include <muduo/net/Channel.h>
 #include <muduo/net/EventLoop.h>
+#include <muduo/net/Resolver.h>
 #include <muduo/net/SocketsOps.h>
 
 #include <boost/bind.hpp>
@@ -23,20 +24,80 @@ using namespace muduo::net;
 
 const int Connector::kMaxRetryDelayMs;
 
+namespace
+{
+
+// RFC 8305 section 4, alternates address families, starting with the
+// family getaddrinfo() prefers.
+std::vector<InetAddress> interleave(const std::vector<InetAddress>& addresses)
+{
+  std::vector<InetAddress> preferred;
+  std::vector<InetAddress> others;
+  for (size_t i = 0; i < addresses.size(); ++i)
+  {
+    if (addresses[i].family() == addresses[0].family())
+    {
+      preferred.push_back(addresses[i]);
+    }
+    else
+    {
+      others.push_back(addresses[i]);
+    }
+  }
+  std::vector<InetAddress> result;
+  result.reserve(addresses.size());
+  for (size_t i = 0; i < preferred.size() || i < others.size(); ++i)
+  {
+    if (i < preferred.size())
+    {
+      result.push_back(preferred[i]);
+    }
+    if (i < others.size())
+    {
+      result.push_back(others[i]);
+    }
+  }
+  return result;
+}
+
+// the bound Channel is deleted with the functor.
+void releaseChannel(const boost::shared_ptr<Channel>&)
+{
+}
+
+}
+
 Connector::Connector(EventLoop* loop, const InetAddress& serverAddr)
   : loop_(loop),
     serverAddr_(serverAddr),
+    port_(serverAddr.toPort()),
     connect_(false),
     state_(kDisconnected),
+    nextAddress_(0),
+    retryable_(false),
     retryDelayMs_(kInitRetryDelayMs)
 {
   LOG_DEBUG << "ctor[" << this << "]";
 }
 
+Connector::Connector(EventLoop* loop, const string& host, uint16_t port)
+  : loop_(loop),
+    serverAddr_(port),
+    host_(host),
+    port_(port),
+    connect_(false),
+    state_(kDisconnected),
+    nextAddress_(0),
+    retryable_(false),
+    retryDelayMs_(kInitRetryDelayMs)
+{
+  LOG_DEBUG << "ctor[" << this << "] " << host_ << ":" << port_;
+}
+
 Connector::~Connector()
 {
   LOG_DEBUG << "dtor[" << this << "]";
-  assert(!channel_);
+  assert(channels_.empty());
 }
 
 void Connector::start()
@@ -69,52 +130,115 @@ void Connector::stop()
 void Connector::stopInLoop()
 {
   loop_->assertInLoopThread();
-  if (state_ == kConnecting)
+  if (state_ == kConnecting || state_ == kResolving)
   {
-    setState(kDisconnected);
-    int sockfd = removeAndResetChannel();
-    retry(sockfd);
+    closeAttempts();
+    retry();
   }
 }
 
 void Connector::connect()
 {
-  int sockfd = sockets::createNonblockingOrDie(serverAddr_.family());
-  int ret = sockets::connect(sockfd, serverAddr_.getSockAddr());
-  int savedErrno = (ret == 0) ? 0 : errno;
-  switch (savedErrno)
-  {
-    case 0:
-    case EINPROGRESS:
-    case EINTR:
-    case EISCONN:
-      connecting(sockfd);
-      break;
-
-    case EAGAIN:
-    case EADDRINUSE:
-    case EADDRNOTAVAIL:
-    case ECONNREFUSED:
-    case ENETUNREACH:
-      retry(sockfd);
-      break;
-
-    case EACCES:
-    case EPERM:
-    case EAFNOSUPPORT:
-    case EALREADY:
-    case EBADF:
-    case EFAULT:
-    case ENOTSOCK:
-      LOG_SYSERR << "connect error in Connector::startInLoop " << savedErrno;
-      sockets::close(sockfd);
-      break;
-
-    default:
-      LOG_SYSERR << "Unexpected error in Connector::startInLoop " << savedErrno;
-      sockets::close(sockfd);
-      // connectErrorCallback_();
-      break;
+  retryable_ = false;
+  if (host_.empty())
+  {
+    addresses_.assign(1, serverAddr_);
+    nextAddress_ = 0;
+    connectNext();
+  }
+  else
+  {
+    // resolved() may run before resolve() returns, when cached.
+    setState(kResolving);
+    boost::weak_ptr<Connector> wkConnector(shared_from_this());
+    Resolver::instance().resolve(loop_, host_, port_,
+                                 boost::bind(&Connector::onResolved, wkConnector, _1));
+  }
+}
+
+void Connector::onResolved(const boost::weak_ptr<Connector>& wkConnector,
+                           const std::vector<InetAddress>& addresses)
+{
+  boost::shared_ptr<Connector> connector(wkConnector.lock());
+  if (connector)
+  {
+    connector->resolved(addresses);
+  }
+}
+
+void Connector::resolved(const std::vector<InetAddress>& addresses)
+{
+  loop_->assertInLoopThread();
+  if (state_ != kResolving)
+  {
+    // stopped meanwhile
+    return;
+  }
+  if (addresses.empty())
+  {
+    LOG_WARN << "Connector::resolved - can't resolve " << host_;
+    retryable_ = true;
+  }
+  addresses_ = interleave(addresses);
+  nextAddress_ = 0;
+  connectNext();
+}
+
+void Connector::connectNext()
+{
+  while (nextAddress_ < addresses_.size())
+  {
+    const InetAddress& serverAddr = addresses_[nextAddress_++];
+    int sockfd = sockets::createNonblockingOrDie(serverAddr.family());
+    int ret = sockets::connect(sockfd, serverAddr.getSockAddr());
+    int savedErrno = (ret == 0) ? 0 : errno;
+    switch (savedErrno)
+    {
+      case 0:
+      case EINPROGRESS:
+      case EINTR:
+      case EISCONN:
+        connecting(sockfd);
+        return;
+
+      case EAGAIN:
+      case EADDRINUSE:
+      case EADDRNOTAVAIL:
+      case ECONNREFUSED:
+      case ENETUNREACH:
+        retryable_ = true;
+        sockets::close(sockfd);
+        break;
+
+      case EACCES:
+      case EPERM:
+      case EAFNOSUPPORT:
+      case EALREADY:
+      case EBADF:
+      case EFAULT:
+      case ENOTSOCK:
+        LOG_SYSERR << "connect error in Connector::connectNext " << savedErrno;
+        sockets::close(sockfd);
+        break;
+
+      default:
+        LOG_SYSERR << "Unexpected error in Connector::connectNext " << savedErrno;
+        sockets::close(sockfd);
+        // connectErrorCallback_();
+        break;
+    }
+  }
+
+  if (channels_.empty())
+  {
+    if (retryable_)
+    {
+      retry();
+    }
+    else
+    {
+      setState(kDisconnected);
+    }
   }
 }
 
@@ -130,54 +254,104 @@ void Connector::restart()
 void Connector::connecting(int sockfd)
 {
   setState(kConnecting);
-  assert(!channel_);
-  channel_.reset(new Channel(loop_, sockfd));
-  channel_->setWriteCallback(
-      boost::bind(&Connector::handleWrite, this)); // FIXME: unsafe
-  channel_->setErrorCallback(
-      boost::bind(&Connector::handleError, this)); // FIXME: unsafe
+  boost::shared_ptr<Channel> channel(new Channel(loop_, sockfd));
+  channel->setWriteCallback(
+      boost::bind(&Connector::handleWrite, this, get_pointer(channel))); // FIXME: unsafe
+  channel->setErrorCallback(
+      boost::bind(&Connector::handleError, this, get_pointer(channel))); // FIXME: unsafe
 
   // channel_->tie(shared_from_this()); is not working,
   // as channel_ is not managed by shared_ptr
-  channel_->enableWriting();
+  channel->enableWriting();
+  channels_.push_back(channel);
+
+  if (nextAddress_ < addresses_.size())
+  {
+    // races the next address if this one is slow.
+    loop_->cancel(attemptTimer_);
+    attemptTimer_ = loop_->runAfter(kAttemptDelayMs/1000.0,
+                                    boost::bind(&Connector::raceNext, shared_from_this()));
+  }
 }
 
-int Connector::removeAndResetChannel()
+bool Connector::removeAndResetChannel(Channel* channel)
 {
-  channel_->disableAll();
-  channel_->remove();
-  int sockfd = channel_->fd();
-  // Can't reset channel_ here, because we are inside Channel::handleEvent
-  loop_->queueInLoop(boost::bind(&Connector::resetChannel, this)); // FIXME: unsafe
-  return sockfd;
+  for (size_t i = 0; i < channels_.size(); ++i)
+  {
+    if (get_pointer(channels_[i]) == channel)
+    {
+      channel->disableAll();
+      channel->remove();
+      // Can't delete channel here, because we are inside Channel::handleEvent
+      loop_->queueInLoop(boost::bind(releaseChannel, channels_[i]));
+      channels_[i] = channels_.back();
+      channels_.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+void Connector::closeAttempts()
+{
+  loop_->cancel(attemptTimer_);
+  while (!channels_.empty())
+  {
+    int sockfd = channels_.back()->fd();
+    removeAndResetChannel(get_pointer(channels_.back()));
+    sockets::close(sockfd);
+  }
 }
 
-void Connector::resetChannel()
+void Connector::raceNext()
 {
-  channel_.reset();
+  if (state_ == kConnecting)
+  {
+    connectNext();
+  }
 }
 
-void Connector::handleWrite()
+void Connector::attemptFailed(int sockfd)
+{
+  sockets::close(sockfd);
+  retryable_ = true;
+  // next address at once, instead of after kAttemptDelayMs, but not
+  // while the failed Channel is still handling its events.
+  loop_->cancel(attemptTimer_);
+  loop_->queueInLoop(boost::bind(&Connector::raceNext, shared_from_this()));
+}
+
+void Connector::handleWrite(Channel* channel)
 {
   LOG_TRACE << "Connector::handleWrite " << state_;
 
   if (state_ == kConnecting)
   {
-    int sockfd = removeAndResetChannel();
+    if (!removeAndResetChannel(channel))
+    {
+      return;  // failed in handleError() of the same event
+    }
+    int sockfd = channel->fd();
     int err = sockets::getSocketError(sockfd);
     if (err)
     {
       LOG_WARN << "Connector::handleWrite - SO_ERROR = "
                << err << " " << strerror_tl(err);
-      retry(sockfd);
+      attemptFailed(sockfd);
     }
     else if (sockets::isSelfConnect(sockfd))
     {
       LOG_WARN << "Connector::handleWrite - Self connect";
-      retry(sockfd);
+      attemptFailed(sockfd);
     }
     else
     {
+      // the first one connected wins, others are dropped.
+      closeAttempts();
+      if (!host_.empty())
+      {
+        serverAddr_ = InetAddress(sockets::getPeerAddr(sockfd));
+      }
       setState(kConnected);
       if (connect_)
       {
@@ -196,25 +370,25 @@ void Connector::handleWrite()
   }
 }
 
-void Connector::handleError()
+void Connector::handleError(Channel* channel)
 {
   LOG_ERROR << "Connector::handleError state=" << state_;
-  if (state_ == kConnecting)
+  if (state_ == kConnecting && removeAndResetChannel(channel))
   {
-    int sockfd = removeAndResetChannel();
+    int sockfd = channel->fd();
     int err = sockets::getSocketError(sockfd);
     LOG_TRACE << "SO_ERROR = " << err << " " << strerror_tl(err);
-    retry(sockfd);
+    attemptFailed(sockfd);
   }
 }
 
-void Connector::retry(int sockfd)
+void Connector::retry()
 {
-  sockets::close(sockfd);
   setState(kDisconnected);
   if (connect_)
   {
-    LOG_INFO << "Connector::retry - Retry connecting to " << serverAddr_.toIpPort()
+    LOG_INFO << "Connector::retry - Retry connecting to "
+             << (host_.empty() ? serverAddr_.toIpPort() : host_)
              << " in " << retryDelayMs_ << " milliseconds. ";
     loop_->runAfter(retryDelayMs_/1000.0,
                     boost::bind(&Connector::startInLoop, shared_from_this()));
@@ -225,4 +399,3 @@ void Connector::retry(int sockfd)
     LOG_DEBUG << "do not connect";
   }
 }
-
@@ -12,11 +12,15 @@
 #define MUDUO_NET_CONNECTOR_H
 
 #include <muduo/net/InetAddress.h>
+#include <muduo/net/TimerId.h>
 
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
-#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <vector>
 
 namespace muduo
 {
@@ -33,6 +37,9 @@ class Connector : boost::noncopyable,
   typedef boost::function<void (int sockfd)> NewConnectionCallback;
 
   Connector(EventLoop* loop, const InetAddress& serverAddr);
+  // Resolves host with Resolver on every (re)connect, then races its
+  // IPv6 and IPv4 addresses, Happy Eyeballs (RFC 8305).
+  Connector(EventLoop* loop, const string& host, uint16_t port);
   ~Connector();
 
   void setNewConnectionCallback(const NewConnectionCallback& cb)
@@ -42,29 +49,49 @@ class Connector : boost::noncopyable,
   void restart();  // must be called in loop thread
   void stop();  // can be called in any thread
 
+  // with host, the address last connected to.
   const InetAddress& serverAddress() const { return serverAddr_; }
+  const string& host() const { return host_; }
 
  private:
-  enum States { kDisconnected, kConnecting, kConnected };
+  enum States { kDisconnected, kResolving, kConnecting, kConnected };
   static const int kMaxRetryDelayMs = 30*1000;
   static const int kInitRetryDelayMs = 500;
+  static const int kAttemptDelayMs = 250;  // before racing the next address
 
   void setState(States s) { state_ = s; }
   void startInLoop();
   void stopInLoop();
   void connect();
+  static void onResolved(const boost::weak_ptr<Connector>& wkConnector,
+                         const std::vector<InetAddress>& addresses);
+  void resolved(const std::vector<InetAddress>& addresses);
+  // tries addresses_ in order until one is connecting, retry() if all failed.
+  void connectNext();
+  void raceNext();
   void connecting(int sockfd);
-  void handleWrite();
-  void handleError();
-  void retry(int sockfd);
-  int removeAndResetChannel();
-  void resetChannel();
+  void attemptFailed(int sockfd);
+  // callbacks are bound to their Channel, as a closed fd may be reused
+  // by the next attempt.
+  void handleWrite(Channel* channel);
+  void handleError(Channel* channel);
+  void retry();
+  // returns false if channel has been removed.
+  bool removeAndResetChannel(Channel* channel);
+  void closeAttempts();
 
   EventLoop* loop_;
   InetAddress serverAddr_;
+  const string host_;
+  const uint16_t port_;
   bool connect_; // atomic
   States state_;  // FIXME: use atomic variable
-  boost::scoped_ptr<Channel> channel_;
+  // addresses of this round, and their connecting sockets.
+  std::vector<InetAddress> addresses_;
+  size_t nextAddress_;
+  bool retryable_;  // some address failed in a way worth retrying
+  std::vector<boost::shared_ptr<Channel> > channels_;
+  TimerId attemptTimer_;
   NewConnectionCallback newConnectionCallback_;
   int retryDelayMs_;
 };
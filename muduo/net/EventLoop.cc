@@ -12,6 +12,7 @@
 #include <muduo/base/Mutex.h>
 #include <muduo/net/Channel.h>
 #include <muduo/net/Poller.h>
+#include <muduo/net/Resolver.h>
 #include <muduo/net/SocketsOps.h>
 #include <muduo/net/TimerQueue.h>
 
@@ -68,7 +69,10 @@ EventLoop::EventLoop()
     quit_(false),
     eventHandling_(false),
     callingPendingFunctors_(false),
+    callingIterationEndFunctors_(false),
     iteration_(0),
+    busyPollUs_(0),
+    lastActiveUs_(0),
     threadId_(CurrentThread::tid()),
     poller_(Poller::newDefaultPoller(this)),
     timerQueue_(new TimerQueue(this)),
@@ -97,6 +101,11 @@ EventLoop::~EventLoop()
 {
   LOG_DEBUG << "EventLoop " << this << " of thread " << threadId_
             << " destructs in thread " << CurrentThread::tid();
+  // hostnames being resolved for us would call back into a dead loop.
+  if (Resolver::used())
+  {
+    Resolver::instance().cancel(this);
+  }
   wakeupChannel_->disableAll();
   wakeupChannel_->remove();
   ::close(wakeupFd_);
@@ -115,9 +124,19 @@ void EventLoop::loop()
   while (!quit_)
   {
     activeChannels_.clear();
+    int timeoutMs = kPollTimeMs;
+    if (busyPollUs_ > 0
+        && pollReturnTime_.microSecondsSinceEpoch() - lastActiveUs_ < busyPollUs_)
+    {
+      timeoutMs = 0;  // still spinning
+    }
     //EventLoop主要阻塞在此处
-    pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+    pollReturnTime_ = poller_->poll(timeoutMs, &activeChannels_);
     ++iteration_;
+    if (!activeChannels_.empty())
+    {
+      lastActiveUs_ = pollReturnTime_.microSecondsSinceEpoch();
+    }
     
     if (Logger::logLevel() <= Logger::TRACE)
     {
@@ -141,6 +160,7 @@ void EventLoop::loop()
     
     //执行任务回调
     doPendingFunctors();
+    doIterationEndFunctors();
   }
 
   LOG_TRACE << "EventLoop " << this << " stop looping";
@@ -184,7 +204,7 @@ void EventLoop::queueInLoop(const Functor& cb)
   pendingFunctors_.push_back(cb);
   }
 
-  if (!isInLoopThread() || callingPendingFunctors_)
+  if (!isInLoopThread() || callingPendingFunctors_ || callingIterationEndFunctors_)
   {
     wakeup();
   }
@@ -197,6 +217,16 @@ size_t EventLoop::queueSize() const
   return pendingFunctors_.size();
 }
 
+void EventLoop::runAtIterationEnd(const Functor& cb)
+{
+  assertInLoopThread();
+  iterationEndFunctors_.push_back(cb);
+  if (!looping_ || callingIterationEndFunctors_)
+  {
+    wakeup();
+  }
+}
+
 TimerId EventLoop::runAt(const Timestamp& time, const TimerCallback& cb)
 {
   return timerQueue_->addTimer(cb, time, 0.0);
@@ -235,7 +265,7 @@ void EventLoop::queueInLoop(Functor&& cb)
   pendingFunctors_.push_back(std::move(cb));  // emplace_back
   }
 
-  if (!isInLoopThread() || callingPendingFunctors_)
+  if (!isInLoopThread() || callingPendingFunctors_ || callingIterationEndFunctors_)
   {
     wakeup();
   }
@@ -341,6 +371,18 @@ void EventLoop::doPendingFunctors()
   callingPendingFunctors_ = false;
 }
 
+void EventLoop::doIterationEndFunctors()
+{
+  std::vector<Functor> functors;
+  callingIterationEndFunctors_ = true;
+  functors.swap(iterationEndFunctors_);
+  for (size_t i = 0; i < functors.size(); ++i)
+  {
+    functors[i]();
+  }
+  callingIterationEndFunctors_ = false;
+}
+
 void EventLoop::printActiveChannels() const
 {
   for (ChannelList::const_iterator it = activeChannels_.begin();
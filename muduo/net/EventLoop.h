@@ -65,6 +65,12 @@ class EventLoop : boost::noncopyable
 
   int64_t iteration() const { return iteration_; }
 
+  /// Spin-then-block: after any event, keep polling with zero timeout
+  /// for @c usec microseconds before blocking again, trading one CPU
+  /// for wakeup latency.  0 (default) always blocks.
+  /// Call before loop() or in loop thread.
+  void setBusyPoll(int usec) { busyPollUs_ = usec; }
+
   /// Runs callback immediately in the loop thread.
   /// It wakes up the loop, and run the cb.
   /// If in the same loop thread, cb is run within the function.
@@ -77,6 +83,11 @@ class EventLoop : boost::noncopyable
 
   size_t queueSize() const;
 
+  /// Runs callback at the end of this loop iteration, after pending
+  /// functors, eg. to flush output coalesced during the iteration.
+  /// In loop thread only.
+  void runAtIterationEnd(const Functor& cb);
+
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
   void runInLoop(Functor&& cb);
   void queueInLoop(Functor&& cb);
@@ -148,6 +159,7 @@ class EventLoop : boost::noncopyable
   void abortNotInLoopThread();
   void handleRead();  // waked up
   void doPendingFunctors();
+  void doIterationEndFunctors();
 
   void printActiveChannels() const; // DEBUG
 
@@ -157,7 +169,10 @@ class EventLoop : boost::noncopyable
   bool quit_; /* atomic and shared between threads, okay on x86, I guess. */
   bool eventHandling_; /* atomic */
   bool callingPendingFunctors_; /* atomic */
+  bool callingIterationEndFunctors_;
   int64_t iteration_; //执行loop循环次数
+  int busyPollUs_;
+  int64_t lastActiveUs_;  // pollReturnTime_ of last poll with events
   const pid_t threadId_;//创建 EventLoop 线程id
   Timestamp pollReturnTime_;
 
@@ -184,6 +199,7 @@ class EventLoop : boost::noncopyable
   mutable MutexLock mutex_;
   //回调函数数组
   std::vector<Functor> pendingFunctors_; // @GuardedBy mutex_
+  std::vector<Functor> iterationEndFunctors_;  // in loop thread only
 };
 
 }
@@ -32,6 +32,8 @@ class EventLoopThread : boost::noncopyable
   EventLoopThread(const ThreadInitCallback& cb = ThreadInitCallback(),
                   const string& name = string());
   ~EventLoopThread();
+  // Must be called before startLoop(), the loop is created on these CPUs.
+  void setCpuSet(const CpuSet& cpus) { thread_.setCpuSet(cpus); }
   EventLoop* startLoop();
 
  private:
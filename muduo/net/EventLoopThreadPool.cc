@@ -13,7 +13,11 @@
 
 #include <boost/bind.hpp>
 
+#include <algorithm>
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 using namespace muduo;
 using namespace muduo::net;
@@ -24,7 +28,10 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop, const string& name
     name_(nameArg),
     started_(false),
     numThreads_(0),
-    next_(0)
+    next_(0),
+    cpuNext_(0),
+    policy_(kRoundRobin),
+    seed_(static_cast<unsigned int>(::getpid()))
 {
 }
 
@@ -45,9 +52,14 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb)
     char buf[name_.size() + 32];
     snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
     EventLoopThread* t = new EventLoopThread(cb, buf);
+    if (!cpuSets_.empty())
+    {
+      t->setCpuSet(cpuSets_[i % cpuSets_.size()]);
+    }
     threads_.push_back(t);
     loops_.push_back(t->startLoop());
   }
+  loads_.resize(loops_.size());
   if (numThreads_ == 0 && cb)
   {
     cb(baseLoop_);
@@ -62,17 +74,92 @@ EventLoop* EventLoopThreadPool::getNextLoop()
 
   if (!loops_.empty())
   {
-    // round-robin
-    loop = loops_[next_];
-    ++next_;
-    if (implicit_cast<size_t>(next_) >= loops_.size())
+    switch (policy_)
     {
-      next_ = 0;
+      case kLeastConnections:
+        loop = loops_[std::min_element(loads_.begin(), loads_.end()) - loads_.begin()];
+        break;
+      case kLeastQueued:
+      {
+        size_t least = loops_[0]->queueSize();
+        loop = loops_[0];
+        for (size_t i = 1; i < loops_.size() && least > 0; ++i)
+        {
+          size_t queued = loops_[i]->queueSize();
+          if (queued < least)
+          {
+            least = queued;
+            loop = loops_[i];
+          }
+        }
+        break;
+      }
+      case kPowerOfTwoChoices:
+      {
+        // two distinct loops, so the busiest one is never picked.
+        size_t first = ::rand_r(&seed_) % loops_.size();
+        size_t second = first;
+        if (loops_.size() > 1)
+        {
+          second = (first + 1 + ::rand_r(&seed_) % (loops_.size() - 1)) % loops_.size();
+        }
+        loop = loops_[loads_[second] < loads_[first] ? second : first];
+        break;
+      }
+      default:
+        // round-robin
+        loop = loops_[next_];
+        ++next_;
+        if (implicit_cast<size_t>(next_) >= loops_.size())
+        {
+          next_ = 0;
+        }
     }
   }
   return loop;
 }
 
+void EventLoopThreadPool::updateLoad(EventLoop* loop, int delta)
+{
+  baseLoop_->assertInLoopThread();
+  for (size_t i = 0; i < loops_.size(); ++i)
+  {
+    if (loops_[i] == loop)
+    {
+      loads_[i] += delta;
+      assert(loads_[i] >= 0);
+      break;
+    }
+  }
+}
+
+EventLoop* EventLoopThreadPool::getLoopForCpu(int cpu)
+{
+  baseLoop_->assertInLoopThread();
+  if (cpu >= 0 && !cpuSets_.empty())
+  {
+    // least loaded of the loops on cpu, ties in turn.
+    const size_t n = loops_.size();
+    size_t chosen = n;
+    for (size_t k = 0; k < n; ++k)
+    {
+      size_t i = (cpuNext_ + k) % n;
+      const CpuSet& cpus = cpuSets_[i % cpuSets_.size()];
+      if ((chosen == n || loads_[i] < loads_[chosen])
+          && std::find(cpus.begin(), cpus.end(), cpu) != cpus.end())
+      {
+        chosen = i;
+      }
+    }
+    if (chosen != n)
+    {
+      cpuNext_ = chosen + 1;
+      return loops_[chosen];
+    }
+  }
+  return getNextLoop();
+}
+
 EventLoop* EventLoopThreadPool::getLoopForHash(size_t hashCode)
 {
   baseLoop_->assertInLoopThread();
@@ -11,6 +11,7 @@
 #ifndef MUDUO_NET_EVENTLOOPTHREADPOOL_H
 #define MUDUO_NET_EVENTLOOPTHREADPOOL_H
 
+#include <muduo/base/Thread.h>
 #include <muduo/base/Types.h>
 
 #include <vector>
@@ -32,15 +33,38 @@ class EventLoopThreadPool : boost::noncopyable
  public:
   typedef boost::function<void(EventLoop*)> ThreadInitCallback;
 
+  /// How getNextLoop() picks a loop.
+  enum SelectionPolicy
+  {
+    kRoundRobin,
+    kLeastConnections,   // smallest load, see updateLoad()
+    kLeastQueued,        // fewest pending functors, EventLoop::queueSize()
+    kPowerOfTwoChoices,  // less loaded of two random loops
+  };
+
   EventLoopThreadPool(EventLoop* baseLoop, const string& nameArg);
   ~EventLoopThreadPool();
   void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+  void setSelectionPolicy(SelectionPolicy policy) { policy_ = policy; }
+  /// Must be called before start().
+  /// Loop i runs on cpuSets[i % cpuSets.size()], eg. one CPU each, or
+  /// ProcessInfo::numaNodeCpus() to keep loops and their memory on a node.
+  void setCpuSets(const std::vector<CpuSet>& cpuSets) { cpuSets_ = cpuSets; }
+  bool hasCpuSets() const { return !cpuSets_.empty(); }
   void start(const ThreadInitCallback& cb = ThreadInitCallback());
 
   // valid after calling start()
-  /// round-robin
+  /// picks a loop according to the selection policy, round-robin by default
   EventLoop* getNextLoop();
 
+  /// adds delta to the load counter of loop, eg. +1 for a new connection
+  /// and -1 when it's gone.  Unknown loops are ignored.
+  void updateLoad(EventLoop* loop, int delta);
+
+  /// the least loaded loop whose CPU set has cpu, in turn if several are,
+  /// eg. SO_INCOMING_CPU of an accepted socket, or getNextLoop() if none.
+  EventLoop* getLoopForCpu(int cpu);
+
   /// with the same hash code, it will always return the same EventLoop
   EventLoop* getLoopForHash(size_t hashCode);
 
@@ -59,8 +83,13 @@ class EventLoopThreadPool : boost::noncopyable
   bool started_;  // 是否启动标志
   int numThreads_; //线程个数
   int next_; 
+  size_t cpuNext_;  // where getLoopForCpu() starts looking
+  SelectionPolicy policy_;
+  unsigned int seed_;  // for kPowerOfTwoChoices
   boost::ptr_vector<EventLoopThread> threads_; //线程指针
   std::vector<EventLoop*> loops_;
+  std::vector<int> loads_;  // per loop, in base loop thread only
+  std::vector<CpuSet> cpuSets_;
 };
 
 }
@@ -144,3 +144,36 @@ bool InetAddress::resolve(StringArg hostname, InetAddress* out)
     return false;
   }
 }
+
+std::vector<InetAddress> InetAddress::resolveAll(StringArg hostname, uint16_t port)
+{
+  std::vector<InetAddress> result;
+  struct addrinfo hints;
+  bzero(&hints, sizeof hints);
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* res = NULL;
+  int ret = ::getaddrinfo(hostname.c_str(), NULL, &hints, &res);
+  if (ret != 0)
+  {
+    LOG_ERROR << "InetAddress::resolveAll " << hostname.c_str() << " - " << gai_strerror(ret);
+    return result;
+  }
+  for (struct addrinfo* ai = res; ai != NULL; ai = ai->ai_next)
+  {
+    if (ai->ai_family == AF_INET)
+    {
+      InetAddress addr(*sockets::sockaddr_in_cast(ai->ai_addr));
+      addr.addr_.sin_port = sockets::hostToNetwork16(port);
+      result.push_back(addr);
+    }
+    else if (ai->ai_family == AF_INET6)
+    {
+      InetAddress addr(*sockets::sockaddr_in6_cast(ai->ai_addr));
+      addr.addr6_.sin6_port = sockets::hostToNetwork16(port);
+      result.push_back(addr);
+    }
+  }
+  ::freeaddrinfo(res);
+  return result;
+}
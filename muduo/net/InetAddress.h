@@ -16,6 +16,8 @@
 
 #include <netinet/in.h>
 
+#include <vector>
+
 namespace muduo
 {
 namespace net
@@ -67,7 +69,10 @@ class InetAddress : public muduo::copyable
   // return true on success.
   // thread safe
   static bool resolve(StringArg hostname, InetAddress* result);
-  // static std::vector<InetAddress> resolveAll(const char* hostname, uint16_t port = 0);
+  // resolve hostname to all its IPv4 and IPv6 addresses, with port,
+  // in getaddrinfo() order.  return empty vector on failure.
+  // thread safe, but blocking, use Resolver in IO threads.
+  static std::vector<InetAddress> resolveAll(StringArg hostname, uint16_t port = 0);
 
  private:
   union
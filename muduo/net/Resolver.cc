@@ -0,0 +1,222 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include <muduo/net/Resolver.h>
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Logging.h>
+#include <muduo/base/Singleton.h>
+#include <muduo/base/ThreadPool.h>
+#include <muduo/net/Endian.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/SocketsOps.h>
+
+#include <boost/bind.hpp>
+
+#include <arpa/inet.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+AtomicInt32 g_used;
+
+bool parseIp(const string& hostname, uint16_t port, Resolver::AddressList* addresses)
+{
+  struct in6_addr buf;
+  if (::inet_pton(AF_INET, hostname.c_str(), &buf) == 1)
+  {
+    addresses->push_back(InetAddress(hostname, port));
+    return true;
+  }
+  else if (::inet_pton(AF_INET6, hostname.c_str(), &buf) == 1)
+  {
+    addresses->push_back(InetAddress(hostname, port, true));
+    return true;
+  }
+  return false;
+}
+
+}
+
+Resolver& Resolver::instance()
+{
+  return Singleton<Resolver>::instance();
+}
+
+bool Resolver::used()
+{
+  return g_used.get() != 0;
+}
+
+Resolver::Resolver()
+  : numThreads_(2),
+    ttl_(60.0),
+    negativeTtl_(5.0)
+{
+}
+
+Resolver::~Resolver()
+{
+  if (pool_)
+  {
+    pool_->stop();
+  }
+}
+
+void Resolver::resolve(EventLoop* loop, const string& hostname, uint16_t port, const Callback& cb)
+{
+  AddressList addresses;
+  if (parseIp(hostname, port, &addresses))
+  {
+    loop->runInLoop(boost::bind(cb, addresses));
+    return;
+  }
+
+  if (!used())
+  {
+    g_used.getAndSet(1);
+  }
+  Waiter waiter = { loop, port, cb };
+  bool cached = false;
+  ThreadPool* pool = NULL;
+  {
+    MutexLockGuard lock(mutex_);
+    Timestamp now(Timestamp::now());
+    if (!(now < nextPrune_))
+    {
+      prune(now);
+      nextPrune_ = addTime(now, ttl_);
+    }
+    Entry& entry = entries_[hostname];
+    if (entry.pending)
+    {
+      entry.waiters.push_back(waiter);
+    }
+    else if (entry.expiration.valid() && now < entry.expiration)
+    {
+      cached = true;
+      addresses = entry.addresses;
+    }
+    else
+    {
+      entry.pending = true;
+      entry.waiters.push_back(waiter);
+      if (!pool_)
+      {
+        pool_.reset(new ThreadPool("Resolver"));
+        pool_->start(numThreads_);
+      }
+      pool = get_pointer(pool_);
+    }
+  }
+
+  if (cached)
+  {
+    deliver(waiter, addresses);
+  }
+  else if (pool)
+  {
+    pool->run(boost::bind(&Resolver::lookup, this, hostname));
+  }
+}
+
+void Resolver::setCacheTtl(double seconds, double negativeSeconds)
+{
+  MutexLockGuard lock(mutex_);
+  ttl_ = seconds;
+  negativeTtl_ = negativeSeconds;
+}
+
+void Resolver::clearCache()
+{
+  MutexLockGuard lock(mutex_);
+  EntryMap::iterator it = entries_.begin();
+  while (it != entries_.end())
+  {
+    if (it->second.pending)
+    {
+      ++it;
+    }
+    else
+    {
+      entries_.erase(it++);
+    }
+  }
+}
+
+void Resolver::cancel(EventLoop* loop)
+{
+  MutexLockGuard lock(mutex_);
+  for (EntryMap::iterator it = entries_.begin(); it != entries_.end(); ++it)
+  {
+    std::vector<Waiter>& waiters = it->second.waiters;
+    for (size_t i = 0; i < waiters.size(); )
+    {
+      if (waiters[i].loop == loop)
+      {
+        waiters[i] = waiters.back();
+        waiters.pop_back();
+      }
+      else
+      {
+        ++i;
+      }
+    }
+  }
+}
+
+void Resolver::prune(Timestamp now)
+{
+  mutex_.assertLocked();
+  EntryMap::iterator it = entries_.begin();
+  while (it != entries_.end())
+  {
+    if (!it->second.pending && !(now < it->second.expiration))
+    {
+      entries_.erase(it++);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+void Resolver::lookup(const string& hostname)
+{
+  AddressList addresses = InetAddress::resolveAll(hostname);
+  LOG_DEBUG << "Resolver::lookup " << hostname << " " << addresses.size() << " addresses";
+  MutexLockGuard lock(mutex_);
+  Entry& entry = entries_[hostname];
+  entry.addresses = addresses;
+  entry.expiration = addTime(Timestamp::now(), addresses.empty() ? negativeTtl_ : ttl_);
+  entry.pending = false;
+  // with mutex_ held, so cancel() can't return while a loop is used.
+  for (size_t i = 0; i < entry.waiters.size(); ++i)
+  {
+    deliver(entry.waiters[i], addresses);
+  }
+  entry.waiters.clear();
+}
+
+void Resolver::deliver(const Waiter& waiter, const AddressList& addresses)
+{
+  AddressList result(addresses);
+  for (size_t i = 0; i < result.size(); ++i)
+  {
+    // sin_port and sin6_port are at the same offset
+    struct sockaddr_in6 addr = *sockets::sockaddr_in6_cast(result[i].getSockAddr());
+    addr.sin6_port = sockets::hostToNetwork16(waiter.port);
+    result[i].setSockAddrInet6(addr);
+  }
+  waiter.loop->runInLoop(boost::bind(waiter.cb, result));
+}
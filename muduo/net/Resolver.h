@@ -0,0 +1,124 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_RESOLVER_H
+#define MUDUO_NET_RESOLVER_H
+
+#include <muduo/base/Mutex.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/base/Types.h>
+#include <muduo/net/InetAddress.h>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <map>
+#include <vector>
+
+namespace muduo
+{
+
+class ThreadPool;
+
+namespace net
+{
+
+class EventLoop;
+
+///
+/// Asynchronous hostname resolver with a cache, shared by all loops.
+///
+/// getaddrinfo() runs in resolver threads, IO threads never block on DNS.
+/// Concurrent lookups of one hostname, eg. a reconnect storm, are merged
+/// into one.
+class Resolver : boost::noncopyable
+{
+ public:
+  typedef std::vector<InetAddress> AddressList;
+  // addresses in getaddrinfo() order, empty on failure.
+  typedef boost::function<void (const AddressList&)> Callback;
+
+  /// The process wide resolver.
+  static Resolver& instance();
+
+  /// Whether resolve() has ever been called, lets EventLoop's destructor
+  /// skip cancel() without constructing instance().
+  static bool used();
+
+  Resolver();
+  ~Resolver();
+
+  /// Resolves hostname to IPv4 and IPv6 addresses with port,
+  /// cb runs in loop thread.  IP address strings and cached hostnames
+  /// call back at once.
+  /// Thread safe.
+  void resolve(EventLoop* loop, const string& hostname, uint16_t port, const Callback& cb);
+
+  /// getaddrinfo() doesn't tell DNS TTLs, so addresses are cached for
+  /// seconds, failures for negativeSeconds.
+  /// Thread safe.
+  void setCacheTtl(double seconds, double negativeSeconds);
+
+  /// Must be called before the first resolve().
+  void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+
+  /// Forgets cached results, lookups in progress still complete.
+  /// Thread safe.
+  void clearCache();
+
+  /// Drops callbacks of lookups in progress to loop, none runs after
+  /// this returns.  EventLoop's destructor calls it once used().
+  /// Thread safe.
+  void cancel(EventLoop* loop);
+
+  // for Singleton, instance() lives until exit, resolver threads may
+  // still be in getaddrinfo().
+  void no_destroy();
+
+ private:
+  struct Waiter
+  {
+    EventLoop* loop;
+    uint16_t port;
+    Callback cb;
+  };
+
+  struct Entry
+  {
+    Entry() : pending(false) { }
+
+    AddressList addresses;  // port 0
+    Timestamp expiration;
+    bool pending;
+    std::vector<Waiter> waiters;
+  };
+
+  typedef std::map<string, Entry> EntryMap;
+
+  // in resolver thread
+  void lookup(const string& hostname);
+  static void deliver(const Waiter& waiter, const AddressList& addresses);
+  // erases expired entries, with mutex_ held
+  void prune(Timestamp now);
+
+  MutexLock mutex_;
+  int numThreads_;
+  double ttl_;
+  double negativeTtl_;
+  boost::scoped_ptr<ThreadPool> pool_;  // @GuardedBy mutex_, started by first lookup
+  EntryMap entries_;  // @GuardedBy mutex_
+  Timestamp nextPrune_;  // @GuardedBy mutex_
+};
+
+}
+}
+
+#endif  // MUDUO_NET_RESOLVER_H
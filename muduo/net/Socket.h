@@ -81,6 +81,18 @@ class Socket : boost::noncopyable
   ///
   void setKeepAlive(bool on);
 
+  ///
+  /// Busy poll the device queue for up to usec on blocking reads
+  /// (SO_BUSY_POLL), raising it above net.core.busy_read needs CAP_NET_ADMIN.
+  ///
+  void setBusyPoll(int usec);
+
+  ///
+  /// Enable/disable SO_ZEROCOPY, needed by sockets::sendZeroCopy().
+  /// returns false if not supported.
+  ///
+  bool setZeroCopy(bool on);
+
  private:
   const int sockfd_;
 };
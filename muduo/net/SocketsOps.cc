@@ -17,7 +17,10 @@
 #include <stdio.h>  // snprintf
 #include <strings.h>  // bzero
 #include <sys/socket.h>
+#include <sys/uio.h>  // readv
 #include <unistd.h>
+#include <linux/errqueue.h>  // sock_extended_err
+#include <netinet/in.h>
 
 using namespace muduo;
 using namespace muduo::net;
@@ -96,6 +99,26 @@ int sockets::createNonblockingOrDie(sa_family_t family)
 #endif
   return sockfd;
 }
+
+int sockets::createUdpNonblockingOrDie(sa_family_t family)
+{
+#if VALGRIND
+  int sockfd = ::socket(family, SOCK_DGRAM, IPPROTO_UDP);
+  if (sockfd < 0)
+  {
+    LOG_SYSFATAL << "sockets::createUdpNonblockingOrDie";
+  }
+
+  setNonBlockAndCloseOnExec(sockfd);
+#else
+  int sockfd = ::socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+  if (sockfd < 0)
+  {
+    LOG_SYSFATAL << "sockets::createUdpNonblockingOrDie";
+  }
+#endif
+  return sockfd;
+}
 //绑定地址
 void sockets::bindOrDie(int sockfd, const struct sockaddr* addr)
 {
@@ -186,6 +209,75 @@ ssize_t sockets::write(int sockfd, const void *buf, size_t count)
   return ::write(sockfd, buf, count);
 }
 
+ssize_t sockets::writev(int sockfd, const struct iovec *iov, int iovcnt)
+{
+  return ::writev(sockfd, iov, iovcnt);
+}
+
+int sockets::createPipe(int pipefd[2], int size)
+{
+  if (::pipe2(pipefd, O_NONBLOCK | O_CLOEXEC) < 0)
+  {
+    LOG_SYSERR << "sockets::createPipe";
+    return -1;
+  }
+  // best effort, capped by /proc/sys/fs/pipe-max-size.
+  ::fcntl(pipefd[1], F_SETPIPE_SZ, size);
+  int capacity = ::fcntl(pipefd[1], F_GETPIPE_SZ);
+  return capacity > 0 ? capacity : 65536;
+}
+
+ssize_t sockets::splice(int fdIn, int fdOut, size_t len)
+{
+  return ::splice(fdIn, NULL, fdOut, NULL, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+}
+
+ssize_t sockets::sendZeroCopy(int sockfd, const struct iovec* iov, int iovcnt)
+{
+#ifdef MSG_ZEROCOPY
+  struct msghdr msg;
+  bzero(&msg, sizeof msg);
+  msg.msg_iov = const_cast<struct iovec*>(iov);
+  msg.msg_iovlen = iovcnt;
+  return ::sendmsg(sockfd, &msg, MSG_ZEROCOPY);
+#else
+  errno = EOPNOTSUPP;
+  return -1;
+#endif
+}
+
+bool sockets::readZeroCopyCompletion(int sockfd, uint32_t* lo, uint32_t* hi, bool* copied)
+{
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+  char control[128];
+  struct msghdr msg;
+  bzero(&msg, sizeof msg);
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof control;
+  if (::recvmsg(sockfd, &msg, MSG_ERRQUEUE) < 0)
+  {
+    return false;
+  }
+  for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+  {
+    if ((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+        || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+    {
+      struct sock_extended_err serr;
+      memcpy(&serr, CMSG_DATA(cm), sizeof serr);
+      if (serr.ee_errno == 0 && serr.ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+      {
+        *lo = serr.ee_info;
+        *hi = serr.ee_data;
+        *copied = (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+        return true;
+      }
+    }
+  }
+#endif
+  return false;
+}
+
 //关闭socket
 void sockets::close(int sockfd)
 {
@@ -271,6 +363,21 @@ int sockets::getSocketError(int sockfd)
   }
 }
 
+int sockets::getIncomingCpu(int sockfd)
+{
+#ifdef SO_INCOMING_CPU
+  int cpu = -1;
+  socklen_t optlen = static_cast<socklen_t>(sizeof cpu);
+  if (::getsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &optlen) == 0)
+  {
+    return cpu;
+  }
+#else
+  (void)sockfd;
+#endif
+  return -1;
+}
+
 struct sockaddr_in6 sockets::getLocalAddr(int sockfd)
 {
   struct sockaddr_in6 localaddr;
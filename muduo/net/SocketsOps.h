@@ -26,6 +26,8 @@ namespace sockets
 
 //创建非阻塞socket
 int createNonblockingOrDie(sa_family_t family);
+/// Same, but a UDP socket.
+int createUdpNonblockingOrDie(sa_family_t family);
 
 //封装底层API
 int  connect(int sockfd, const struct sockaddr* addr);
@@ -35,6 +37,19 @@ int  accept(int sockfd, struct sockaddr_in6* addr);
 ssize_t read(int sockfd, void *buf, size_t count);
 ssize_t readv(int sockfd, const struct iovec *iov, int iovcnt);
 ssize_t write(int sockfd, const void *buf, size_t count);
+ssize_t writev(int sockfd, const struct iovec *iov, int iovcnt);
+// a non-blocking close-on-exec pipe of about size bytes, for splice().
+// returns its capacity, -1 on error.
+int createPipe(int pipefd[2], int size);
+// moves up to len bytes from fdIn to fdOut in kernel, one of them a pipe.
+ssize_t splice(int fdIn, int fdOut, size_t len);
+// sendmsg() with MSG_ZEROCOPY, the pages must stay untouched until the
+// call's completion is read by readZeroCopyCompletion().
+ssize_t sendZeroCopy(int sockfd, const struct iovec* iov, int iovcnt);
+// reads a completion from the error queue, sendZeroCopy() calls numbered
+// *lo to *hi are done, *copied if the kernel had to copy after all.
+// returns false if there is none.
+bool readZeroCopyCompletion(int sockfd, uint32_t* lo, uint32_t* hi, bool* copied);
 void close(int sockfd);
 void shutdownWrite(int sockfd);
 
@@ -50,6 +65,8 @@ void fromIpPort(const char* ip, uint16_t port,
                 struct sockaddr_in6* addr);
 
 int getSocketError(int sockfd);
+// CPU which handled the socket's last received packet, -1 if unknown.
+int getIncomingCpu(int sockfd);
 
 const struct sockaddr* sockaddr_cast(const struct sockaddr_in* addr);
 const struct sockaddr* sockaddr_cast(const struct sockaddr_in6* addr);
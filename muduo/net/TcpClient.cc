@@ -26,12 +26,6 @@ using namespace muduo::net;
 // {
 // }
 
-// TcpClient::TcpClient(EventLoop* loop, const string& host, uint16_t port)
-//   : loop_(CHECK_NOTNULL(loop)),
-//     serverAddr_(host, port)
-// {
-// }
-
 namespace muduo
 {
 namespace net
@@ -72,6 +66,26 @@ TcpClient::TcpClient(EventLoop* loop,
            << "] - connector " << get_pointer(connector_);
 }
 
+TcpClient::TcpClient(EventLoop* loop,
+                     const string& host,
+                     uint16_t port,
+                     const string& nameArg)
+  : loop_(CHECK_NOTNULL(loop)),
+    connector_(new Connector(loop, host, port)),
+    name_(nameArg),
+    connectionCallback_(defaultConnectionCallback),
+    messageCallback_(defaultMessageCallback),
+    retry_(false),
+    connect_(true),
+    nextConnId_(1)
+{
+  connector_->setNewConnectionCallback(
+      boost::bind(&TcpClient::newConnection, this, _1));
+  LOG_INFO << "TcpClient::TcpClient[" << name_
+           << "] - connector " << get_pointer(connector_)
+           << " " << host << ":" << port;
+}
+
 TcpClient::~TcpClient()
 {
   LOG_INFO << "TcpClient::~TcpClient[" << name_
@@ -107,7 +121,8 @@ void TcpClient::connect()
 {
   // FIXME: check state
   LOG_INFO << "TcpClient::connect[" << name_ << "] - connecting to "
-           << connector_->serverAddress().toIpPort();
+           << (connector_->host().empty() ? connector_->serverAddress().toIpPort()
+                                          : connector_->host());
   connect_ = true;
   connector_->start();
 }
@@ -28,10 +28,15 @@ class TcpClient : boost::noncopyable
 {
  public:
   // TcpClient(EventLoop* loop);
-  // TcpClient(EventLoop* loop, const string& host, uint16_t port);
   TcpClient(EventLoop* loop,
             const InetAddress& serverAddr,
             const string& nameArg);
+  // host is resolved asynchronously on every connect and reconnect,
+  // see Connector.
+  TcpClient(EventLoop* loop,
+            const string& host,
+            uint16_t port,
+            const string& nameArg);
   ~TcpClient();  // force out-line dtor, for scoped_ptr members.
 
   void connect();
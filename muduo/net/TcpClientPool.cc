@@ -0,0 +1,408 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include <muduo/net/TcpClientPool.h>
+
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/TcpClient.h>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <algorithm>
+
+#include <stdio.h>  // snprintf
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const int kVirtualNodes = 100;  // ring positions per backend
+
+// FNV-1a, then MurmurHash3 finalizer to spread similar keys over the ring.
+uint64_t hashKey(const StringPiece& key)
+{
+  uint64_t h = 14695981039346656037ULL;
+  for (int i = 0; i < key.size(); ++i)
+  {
+    h ^= static_cast<unsigned char>(key[i]);
+    h *= 1099511628211ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+}
+
+struct TcpClientPool::Connection
+{
+  Connection() : backend(0), outstanding(0) { }
+
+  boost::shared_ptr<TcpClient> client;
+  size_t backend;
+  TcpConnectionPtr conn;  // null when not connected
+  int outstanding;
+};
+
+struct TcpClientPool::Backend
+{
+  Backend() : failures(0), ejections(0) { }
+
+  std::vector<Connection> connections;
+  int failures;  // in a row
+  int ejections;  // in a row
+  Timestamp ejectedUntil;
+};
+
+struct TcpClientPool::LoopPool
+{
+  LoopPool() : loop(NULL), index(0), next(0), stopped(false) { }
+
+  EventLoop* loop;
+  size_t index;
+  std::vector<Backend> backends;
+  std::map<const TcpConnection*, Connection*> connected;
+  size_t next;  // first backend to look at, spreads ties
+  bool stopped;
+};
+
+TcpClientPool::TcpClientPool(const std::vector<EventLoop*>& loops,
+                             const std::vector<InetAddress>& backends,
+                             const string& nameArg)
+  : loops_(loops),
+    backends_(backends),
+    name_(nameArg),
+    connectionCallback_(defaultConnectionCallback),
+    messageCallback_(defaultMessageCallback),
+    connectionsPerBackend_(1),
+    policy_(kLeastOutstanding),
+    maxFailures_(5),
+    ejectSeconds_(10.0)
+{
+  for (size_t i = 0; i < backends_.size(); ++i)
+  {
+    for (int v = 0; v < kVirtualNodes; ++v)
+    {
+      char buf[64];
+      snprintf(buf, sizeof buf, "%s#%d", backends_[i].toIpPort().c_str(), v);
+      ring_.push_back(std::make_pair(hashKey(buf), i));
+    }
+  }
+  std::sort(ring_.begin(), ring_.end());
+
+  for (size_t i = 0; i < loops_.size(); ++i)
+  {
+    LoopPool* pool = new LoopPool;
+    pool->loop = loops_[i];
+    pool->index = i;
+    pool->backends.resize(backends_.size());
+    pools_.push_back(pool);
+    poolOfLoop_[loops_[i]] = pool;
+  }
+}
+
+TcpClientPool::~TcpClientPool()
+{
+  // connections call back into this, close them in their loops and wait.
+  CountDownLatch latch(static_cast<int>(pools_.size()));
+  for (size_t i = 0; i < pools_.size(); ++i)
+  {
+    pools_[i].loop->runInLoop(
+        boost::bind(&TcpClientPool::destroyInLoop, this, &pools_[i], &latch));
+  }
+  latch.wait();
+}
+
+void TcpClientPool::start()
+{
+  for (size_t i = 0; i < pools_.size(); ++i)
+  {
+    pools_[i].loop->runInLoop(
+        boost::bind(&TcpClientPool::startInLoop, this, &pools_[i]));
+  }
+}
+
+void TcpClientPool::startInLoop(LoopPool* pool)
+{
+  pool->loop->assertInLoopThread();
+  for (size_t b = 0; b < pool->backends.size(); ++b)
+  {
+    Backend& backend = pool->backends[b];
+    backend.connections.resize(connectionsPerBackend_);
+    for (size_t c = 0; c < backend.connections.size(); ++c)
+    {
+      char buf[64];
+      snprintf(buf, sizeof buf, "-%s#%zu.%zu", backends_[b].toIpPort().c_str(), pool->index, c);
+      Connection& connection = backend.connections[c];
+      connection.backend = b;
+      connection.client.reset(new TcpClient(pool->loop, backends_[b], name_ + buf));
+      connection.client->setConnectionCallback(
+          boost::bind(&TcpClientPool::onConnection, this, pool, b, c, _1));
+      connection.client->setMessageCallback(messageCallback_);
+      connection.client->enableRetry();
+      connection.client->connect();
+    }
+  }
+}
+
+void TcpClientPool::stop()
+{
+  for (size_t i = 0; i < pools_.size(); ++i)
+  {
+    pools_[i].loop->runInLoop(
+        boost::bind(&TcpClientPool::stopInLoop, this, &pools_[i]));
+  }
+}
+
+void TcpClientPool::stopInLoop(LoopPool* pool)
+{
+  pool->loop->assertInLoopThread();
+  pool->stopped = true;
+  for (size_t b = 0; b < pool->backends.size(); ++b)
+  {
+    std::vector<Connection>& connections = pool->backends[b].connections;
+    for (size_t c = 0; c < connections.size(); ++c)
+    {
+      connections[c].client->disconnect();
+      connections[c].client->stop();
+    }
+  }
+}
+
+void TcpClientPool::destroyInLoop(LoopPool* pool, CountDownLatch* latch)
+{
+  pool->loop->assertInLoopThread();
+  pool->stopped = true;
+  pool->connected.clear();
+  for (size_t b = 0; b < pool->backends.size(); ++b)
+  {
+    std::vector<Connection>& connections = pool->backends[b].connections;
+    for (size_t c = 0; c < connections.size(); ++c)
+    {
+      if (connections[c].conn)
+      {
+        // nothing that follows may reach this or the owner's callbacks
+        connections[c].conn->setConnectionCallback(defaultConnectionCallback);
+        connections[c].conn->setMessageCallback(defaultMessageCallback);
+        connections[c].conn.reset();
+      }
+      connections[c].client.reset();  // force closes its connection
+    }
+  }
+  latch->countDown();
+}
+
+void TcpClientPool::onConnection(LoopPool* pool, size_t backend, size_t index,
+                                 const TcpConnectionPtr& conn)
+{
+  pool->loop->assertInLoopThread();
+  Connection& connection = pool->backends[backend].connections[index];
+  if (conn->connected())
+  {
+    connection.conn = conn;
+    connection.outstanding = 0;
+    pool->connected[get_pointer(conn)] = &connection;
+  }
+  else
+  {
+    pool->connected.erase(get_pointer(conn));
+    if (connection.conn == conn)
+    {
+      connection.conn.reset();
+      connection.outstanding = 0;
+    }
+    if (!pool->stopped)
+    {
+      onFailure(pool, &pool->backends[backend]);
+    }
+  }
+  connectionCallback_(conn);
+}
+
+void TcpClientPool::onFailure(LoopPool* pool, Backend* backend)
+{
+  if (maxFailures_ <= 0 || ++backend->failures < maxFailures_)
+  {
+    return;
+  }
+  backend->failures = 0;
+  double seconds = ejectSeconds_ * (1 << std::min(backend->ejections, 5));
+  ++backend->ejections;
+  backend->ejectedUntil = addTime(Timestamp::now(), seconds);
+  LOG_WARN << "TcpClientPool[" << name_ << "] - ejects "
+           << backends_[backend - &pool->backends[0]].toIpPort()
+           << " for " << seconds << " seconds";
+}
+
+TcpClientPool::LoopPool* TcpClientPool::currentLoopPool()
+{
+  LoopMap::iterator it = poolOfLoop_.find(EventLoop::getEventLoopOfCurrentThread());
+  if (it == poolOfLoop_.end())
+  {
+    LOG_FATAL << "TcpClientPool[" << name_ << "] - not in one of its loops";
+  }
+  return it->second;
+}
+
+TcpClientPool::Connection* TcpClientPool::findConnection(LoopPool* pool,
+                                                         const TcpConnectionPtr& conn)
+{
+  std::map<const TcpConnection*, Connection*>::iterator it
+    = pool->connected.find(get_pointer(conn));
+  return it != pool->connected.end() ? it->second : NULL;
+}
+
+void TcpClientPool::requestStarted(const TcpConnectionPtr& conn)
+{
+  Connection* connection = findConnection(currentLoopPool(), conn);
+  if (connection)
+  {
+    ++connection->outstanding;
+  }
+}
+
+void TcpClientPool::requestFinished(const TcpConnectionPtr& conn, bool success)
+{
+  LoopPool* pool = currentLoopPool();
+  Connection* connection = findConnection(pool, conn);
+  if (connection)
+  {
+    if (connection->outstanding > 0)
+    {
+      --connection->outstanding;
+    }
+    Backend* backend = &pool->backends[connection->backend];
+    if (success)
+    {
+      backend->failures = 0;
+      backend->ejections = 0;
+    }
+    else
+    {
+      onFailure(pool, backend);
+    }
+  }
+}
+
+bool TcpClientPool::available(const Backend& backend, Timestamp now, bool skipEjected)
+{
+  return !skipEjected
+      || !backend.ejectedUntil.valid()
+      || !(now < backend.ejectedUntil);
+}
+
+TcpClientPool::Connection* TcpClientPool::leastOutstanding(Backend* backend)
+{
+  Connection* best = NULL;
+  for (size_t c = 0; c < backend->connections.size(); ++c)
+  {
+    Connection* connection = &backend->connections[c];
+    if (connection->conn && (!best || connection->outstanding < best->outstanding))
+    {
+      best = connection;
+    }
+  }
+  return best;
+}
+
+TcpConnectionPtr TcpClientPool::leastOutstanding(LoopPool* pool, bool skipEjected)
+{
+  Timestamp now(Timestamp::now());
+  Connection* best = NULL;
+  size_t numBackends = pool->backends.size();
+  for (size_t i = 0; i < numBackends; ++i)
+  {
+    Backend* backend = &pool->backends[(pool->next + i) % numBackends];
+    if (available(*backend, now, skipEjected))
+    {
+      Connection* connection = leastOutstanding(backend);
+      if (connection && (!best || connection->outstanding < best->outstanding))
+      {
+        best = connection;
+      }
+    }
+  }
+  if (numBackends > 0)
+  {
+    pool->next = (pool->next + 1) % numBackends;
+  }
+  return best ? best->conn : TcpConnectionPtr();
+}
+
+TcpConnectionPtr TcpClientPool::hashed(LoopPool* pool, uint64_t hash, bool skipEjected)
+{
+  Timestamp now(Timestamp::now());
+  std::vector<bool> tried(pool->backends.size());
+  std::vector<std::pair<uint64_t, size_t> >::const_iterator it
+    = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(hash, static_cast<size_t>(0)));
+  // clockwise from key, to the first backend that's up.
+  for (size_t i = 0; i < ring_.size(); ++i, ++it)
+  {
+    if (it == ring_.end())
+    {
+      it = ring_.begin();
+    }
+    size_t b = it->second;
+    if (!tried[b])
+    {
+      tried[b] = true;
+      Backend* backend = &pool->backends[b];
+      if (available(*backend, now, skipEjected))
+      {
+        Connection* connection = leastOutstanding(backend);
+        if (connection)
+        {
+          return connection->conn;
+        }
+      }
+    }
+  }
+  return TcpConnectionPtr();
+}
+
+TcpConnectionPtr TcpClientPool::getConnection()
+{
+  LoopPool* pool = currentLoopPool();
+  TcpConnectionPtr conn = leastOutstanding(pool, true);
+  if (!conn)
+  {
+    // all ejected, better than nothing.
+    conn = leastOutstanding(pool, false);
+  }
+  return conn;
+}
+
+TcpConnectionPtr TcpClientPool::getConnection(const StringPiece& key)
+{
+  if (policy_ != kConsistentHash)
+  {
+    return getConnection();
+  }
+  LoopPool* pool = currentLoopPool();
+  uint64_t hash = hashKey(key);
+  TcpConnectionPtr conn = hashed(pool, hash, true);
+  if (!conn)
+  {
+    conn = hashed(pool, hash, false);
+  }
+  return conn;
+}
+
+int TcpClientPool::numConnected()
+{
+  return static_cast<int>(currentLoopPool()->connected.size());
+}
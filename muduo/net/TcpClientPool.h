@@ -0,0 +1,142 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_TCPCLIENTPOOL_H
+#define MUDUO_NET_TCPCLIENTPOOL_H
+
+#include <muduo/base/StringPiece.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/net/Callbacks.h>
+#include <muduo/net/InetAddress.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace muduo
+{
+
+class CountDownLatch;
+
+namespace net
+{
+
+class EventLoop;
+class TcpClient;
+
+///
+/// Connections to a set of backends, a few per backend in every loop,
+/// eg. the IO loops of a TcpServer that forwards requests.
+///
+/// Each loop has its own connections and statistics, so picking a
+/// connection is lock free but must be done in a loop thread.  Protocol
+/// code reports requests with requestStarted() and requestFinished(),
+/// which drive least outstanding request selection and outlier ejection.
+class TcpClientPool : boost::noncopyable
+{
+ public:
+  enum SelectionPolicy
+  {
+    kLeastOutstanding,  // connection with fewest requests in flight
+    kConsistentHash,    // backend by key, stable when backends go away
+  };
+
+  TcpClientPool(const std::vector<EventLoop*>& loops,
+                const std::vector<InetAddress>& backends,
+                const string& nameArg);
+  /// Closes the connections in their loops and waits for it, so the
+  /// loops must still be running, eg. destroy it before the TcpServer
+  /// whose IO threads it uses.  No callback runs after it returns.
+  ~TcpClientPool();
+
+  /// Connection and message callbacks of every pooled connection.
+  /// Must be called before start().
+  void setConnectionCallback(const ConnectionCallback& cb)
+  { connectionCallback_ = cb; }
+  void setMessageCallback(const MessageCallback& cb)
+  { messageCallback_ = cb; }
+
+  /// Must be called before start().
+  void setConnectionsPerBackend(int numConnections)
+  { connectionsPerBackend_ = numConnections; }
+  void setSelectionPolicy(SelectionPolicy policy)
+  { policy_ = policy; }
+  /// A backend with consecutiveFailures failed requests or lost
+  /// connections in a row is skipped for ejectSeconds, doubled every
+  /// time it's ejected again.  0 disables.
+  void setOutlierDetection(int consecutiveFailures, double ejectSeconds)
+  { maxFailures_ = consecutiveFailures; ejectSeconds_ = ejectSeconds; }
+
+  /// Connects all connections in all loops before traffic arrives,
+  /// they reconnect by themselves.
+  /// Thread safe.
+  void start();
+  void stop();
+
+  /// Picks a connected connection in the current loop, null if none.
+  /// Ejected backends are skipped, unless all backends are ejected.
+  /// Must be called in one of the loops.
+  TcpConnectionPtr getConnection();
+  /// kConsistentHash picks the backend by key, the same one as long as
+  /// it's healthy.  kLeastOutstanding ignores key.
+  TcpConnectionPtr getConnection(const StringPiece& key);
+
+  /// A request is sent on a pooled connection.
+  /// Must be called in conn's loop.
+  void requestStarted(const TcpConnectionPtr& conn);
+  /// Its response arrived, or it failed, eg. timed out.
+  void requestFinished(const TcpConnectionPtr& conn, bool success);
+
+  /// Number of connected connections in the current loop.
+  int numConnected();
+
+  const string& name() const { return name_; }
+
+ private:
+  struct Connection;
+  struct Backend;
+  struct LoopPool;
+  typedef std::map<EventLoop*, LoopPool*> LoopMap;
+
+  LoopPool* currentLoopPool();
+  Connection* findConnection(LoopPool* pool, const TcpConnectionPtr& conn);
+  void onConnection(LoopPool* pool, size_t backend, size_t index,
+                    const TcpConnectionPtr& conn);
+  void onFailure(LoopPool* pool, Backend* backend);
+  TcpConnectionPtr leastOutstanding(LoopPool* pool, bool skipEjected);
+  TcpConnectionPtr hashed(LoopPool* pool, uint64_t hash, bool skipEjected);
+  static Connection* leastOutstanding(Backend* backend);
+  static bool available(const Backend& backend, Timestamp now, bool skipEjected);
+  void startInLoop(LoopPool* pool);
+  void stopInLoop(LoopPool* pool);
+  void destroyInLoop(LoopPool* pool, CountDownLatch* latch);
+
+  const std::vector<EventLoop*> loops_;
+  const std::vector<InetAddress> backends_;
+  const string name_;
+  ConnectionCallback connectionCallback_;
+  MessageCallback messageCallback_;
+  int connectionsPerBackend_;
+  SelectionPolicy policy_;
+  int maxFailures_;
+  double ejectSeconds_;
+  // hash ring of backends, position and backend index, sorted.
+  std::vector<std::pair<uint64_t, size_t> > ring_;
+  boost::ptr_vector<LoopPool> pools_;
+  LoopMap poolOfLoop_;  // immutable after ctor
+};
+
+}
+}
+
+#endif  // MUDUO_NET_TCPCLIENTPOOL_H
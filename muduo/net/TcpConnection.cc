@@ -17,7 +17,10 @@
 
 #include <boost/bind.hpp>
 
+#include <algorithm>
+
 #include <errno.h>
+#include <sys/uio.h>
 
 using namespace muduo;
 using namespace muduo::net;
@@ -46,12 +49,22 @@ TcpConnection::TcpConnection(EventLoop* loop,
     name_(nameArg),
     state_(kConnecting),
     reading_(true),
+    deferredFlush_(false),
+    flushPending_(false),
     socket_(new Socket(sockfd)),
     channel_(new Channel(loop, sockfd)),
     localAddr_(localAddr),
     peerAddr_(peerAddr),
-    highWaterMark_(64*1024*1024)
+    highWaterMark_(64*1024*1024),
+    sharedBytes_(0),
+    bufferedClaimed_(0),
+    zeroCopyThreshold_(0),
+    zeroCopyNextSeq_(0),
+    splicePaused_(false),
+    pipeBytes_(0),
+    pipeCapacity_(0)
 {
+  pipe_[0] = pipe_[1] = -1;
   channel_->setReadCallback(
       boost::bind(&TcpConnection::handleRead, this, _1));
   channel_->setWriteCallback(
@@ -71,6 +84,11 @@ TcpConnection::~TcpConnection()
             << " fd=" << channel_->fd()
             << " state=" << stateToString();
   assert(state_ == kDisconnected);
+  if (pipe_[0] >= 0)
+  {
+    sockets::close(pipe_[0]);
+    sockets::close(pipe_[1]);
+  }
 }
 
 bool TcpConnection::getTcpInfo(struct tcp_info* tcpi) const
@@ -117,20 +135,67 @@ void TcpConnection::send(Buffer* buf)
   {
     if (loop_->isInLoopThread())
     {
-      sendInLoop(buf->peek(), buf->readableBytes());
-      buf->retrieveAll();
+      if (zeroCopyThreshold_ > 0 && buf->readableBytes() >= zeroCopyThreshold_)
+      {
+        // take the bytes over, they are freed after the kernel is done.
+        boost::shared_ptr<Buffer> owned(new Buffer);
+        owned->swap(*buf);
+        sendChunkInLoop(owned, owned->peek(), owned->readableBytes());
+      }
+      else
+      {
+        sendInLoop(buf->peek(), buf->readableBytes());
+        buf->retrieveAll();
+      }
     }
     else
     {
+      // the loop decides on zero copy, zeroCopyThreshold_ is its own.
+      boost::shared_ptr<Buffer> owned(new Buffer);
+      owned->swap(*buf);
       loop_->runInLoop(
-          boost::bind(&TcpConnection::sendInLoop,
+          boost::bind(&TcpConnection::sendBufferInLoop,
                       this,     // FIXME
-                      buf->retrieveAllAsString()));
-                    //std::forward<string>(message)));
+                      owned));
     }
   }
 }
 
+void TcpConnection::sendBufferInLoop(const boost::shared_ptr<Buffer>& buf)
+{
+  if (zeroCopyThreshold_ > 0 && buf->readableBytes() >= zeroCopyThreshold_)
+  {
+    sendChunkInLoop(buf, buf->peek(), buf->readableBytes());
+  }
+  else
+  {
+    sendInLoop(buf->peek(), buf->readableBytes());
+  }
+}
+
+void TcpConnection::send(const SharedMessage& message)
+{
+  if (state_ == kConnected)
+  {
+    sendChunk(message, message->data(), message->size());
+  }
+}
+
+void TcpConnection::sendChunk(const ChunkOwner& owner, const char* data, size_t len)
+{
+  if (loop_->isInLoopThread())
+  {
+    sendChunkInLoop(owner, data, len);
+  }
+  else
+  {
+    loop_->runInLoop(
+        boost::bind(&TcpConnection::sendChunkInLoop,
+                    this,     // FIXME
+                    owner, data, len));
+  }
+}
+
 void TcpConnection::sendInLoop(const StringPiece& message)
 {
   sendInLoop(message.data(), message.size());
@@ -148,7 +213,7 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     return;
   }
   // if no thing in output queue, try writing directly
-  if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+  if (!deferredFlush_ && !channel_->isWriting() && outputBytes() == 0)
   {
     nwrote = sockets::write(channel_->fd(), data, len);
     if (nwrote >= 0)
@@ -176,7 +241,7 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
   assert(remaining <= len);
   if (!faultError && remaining > 0)
   {
-    size_t oldLen = outputBuffer_.readableBytes();
+    size_t oldLen = outputBytes();
     if (oldLen + remaining >= highWaterMark_
         && oldLen < highWaterMark_
         && highWaterMarkCallback_)
@@ -184,11 +249,119 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
       loop_->queueInLoop(boost::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
     }
     outputBuffer_.append(static_cast<const char*>(data)+nwrote, remaining);
-    if (!channel_->isWriting())
+    startWriting();
+  }
+}
+
+void TcpConnection::sendChunkInLoop(const ChunkOwner& owner, const char* data, size_t len)
+{
+  loop_->assertInLoopThread();
+  if (state_ == kDisconnected)
+  {
+    LOG_WARN << "disconnected, give up writing";
+    return;
+  }
+  if (len == 0)
+  {
+    return;
+  }
+  const bool idle = !deferredFlush_ && !channel_->isWriting() && outputBytes() == 0;
+  const size_t oldLen = outputBytes();
+  SharedChunk chunk;
+  chunk.owner = owner;
+  chunk.data = data;
+  chunk.size = len;
+  chunk.offset = 0;
+  chunk.bufferedBefore = outputBuffer_.readableBytes() - bufferedClaimed_;
+  bufferedClaimed_ += chunk.bufferedBefore;
+  sharedBytes_ += len;
+  sharedChunks_.push_back(chunk);
+
+  // if no thing in output queue, try writing directly
+  if (idle)
+  {
+    ssize_t n = writeShared();
+    if (n < 0 && errno != EWOULDBLOCK)
+    {
+      LOG_SYSERR << "TcpConnection::sendChunkInLoop";
+      if (errno == EPIPE || errno == ECONNRESET) // FIXME: any others?
+      {
+        sharedChunks_.clear();
+        sharedBytes_ = 0;
+        return;
+      }
+    }
+    if (outputBytes() == 0)
+    {
+      if (writeCompleteCallback_)
+      {
+        loop_->queueInLoop(boost::bind(writeCompleteCallback_, shared_from_this()));
+      }
+      return;
+    }
+  }
+
+  const size_t newLen = outputBytes();
+  if (newLen >= highWaterMark_
+      && oldLen < highWaterMark_
+      && highWaterMarkCallback_)
+  {
+    loop_->queueInLoop(boost::bind(highWaterMarkCallback_, shared_from_this(), newLen));
+  }
+  startWriting();
+}
+
+void TcpConnection::sendOutputBuffer(size_t oldLen)
+{
+  loop_->assertInLoopThread();
+  assert(oldLen <= outputBuffer_.readableBytes());
+  if (state_ == kDisconnected)
+  {
+    LOG_WARN << "disconnected, give up writing";
+    outputBuffer_.retrieveAll();
+    return;
+  }
+  // everything queued before the append, shared and spliced bytes too
+  const size_t queuedBefore = oldLen + sharedBytes_ + pipeBytes_;
+  bool faultError = false;
+  if (!deferredFlush_ && !channel_->isWriting() && queuedBefore == 0)
+  {
+    ssize_t nwrote = sockets::write(channel_->fd(),
+                                    outputBuffer_.peek(),
+                                    outputBuffer_.readableBytes());
+    if (nwrote >= 0)
     {
-      channel_->enableWriting();
+      outputBuffer_.retrieve(nwrote);
+      if (outputBuffer_.readableBytes() == 0 && writeCompleteCallback_)
+      {
+        loop_->queueInLoop(boost::bind(writeCompleteCallback_, shared_from_this()));
+      }
+    }
+    else // nwrote < 0
+    {
+      if (errno != EWOULDBLOCK)
+      {
+        LOG_SYSERR << "TcpConnection::sendOutputBuffer";
+        if (errno == EPIPE || errno == ECONNRESET) // FIXME: any others?
+        {
+          faultError = true;
+          outputBuffer_.retrieveAll();
+        }
+      }
     }
   }
+
+  size_t newLen = outputBytes();
+  if (!faultError && newLen > 0)
+  {
+    if (newLen >= highWaterMark_
+        && queuedBefore < highWaterMark_
+        && highWaterMarkCallback_)
+    {
+      loop_->queueInLoop(boost::bind(highWaterMarkCallback_, shared_from_this(), newLen));
+    }
+    startWriting();
+  }
 }
 
 void TcpConnection::shutdown()
@@ -205,7 +378,7 @@ void TcpConnection::shutdown()
 void TcpConnection::shutdownInLoop()
 {
   loop_->assertInLoopThread();
-  if (!channel_->isWriting())
+  if (!channel_->isWriting() && !flushPending_)
   {
     // we are not writing
     socket_->shutdownWrite();
@@ -290,6 +463,43 @@ void TcpConnection::setTcpNoDelay(bool on)
   socket_->setTcpNoDelay(on);
 }
 
+void TcpConnection::setBusyPoll(int usec)
+{
+  socket_->setBusyPoll(usec);
+}
+
+void TcpConnection::setZeroCopyThreshold(size_t bytes)
+{
+  loop_->assertInLoopThread();
+  if (bytes > 0 && !socket_->setZeroCopy(true))
+  {
+    bytes = 0;
+  }
+  zeroCopyThreshold_ = bytes;
+}
+
+void TcpConnection::startSplice(const TcpConnectionPtr& peer)
+{
+  loop_->assertInLoopThread();
+  assert(peer->getLoop() == loop_);
+  const int kPipeSize = 256 * 1024;
+  if (peer->pipe_[0] < 0)
+  {
+    int capacity = sockets::createPipe(peer->pipe_, kPipeSize);
+    if (capacity < 0)
+    {
+      return;  // keeps relaying through user space
+    }
+    peer->pipeCapacity_ = capacity;
+  }
+  if (inputBuffer_.readableBytes() > 0)
+  {
+    peer->send(&inputBuffer_);
+  }
+  splicePeer_ = peer;
+  peer->spliceSource_ = shared_from_this();
+}
+
 void TcpConnection::startRead()
 {
   loop_->runInLoop(boost::bind(&TcpConnection::startReadInLoop, this));
@@ -347,6 +557,12 @@ void TcpConnection::connectDestroyed()
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
   loop_->assertInLoopThread();
+  TcpConnectionPtr peer(splicePeer_.lock());
+  if (peer)
+  {
+    handleSpliceRead(peer);
+    return;
+  }
   int savedErrno = 0;
   ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
   if (n > 0)
@@ -365,18 +581,92 @@ void TcpConnection::handleRead(Timestamp receiveTime)
   }
 }
 
+void TcpConnection::handleSpliceRead(const TcpConnectionPtr& peer)
+{
+  ssize_t n = -1;
+  bool full = peer->pipeFull();
+  if (!full)
+  {
+    n = peer->spliceFrom(channel_->fd());
+    // a pipe fills by pages, not bytes, eg. one per small skb, so EAGAIN
+    // with bytes in it means full.  Readable socket, or we'd not be here.
+    full = peer->pipeFull() || (n < 0 && errno == EAGAIN && peer->pipeBytes_ > 0);
+  }
+  if (n == 0)
+  {
+    handleClose();
+    return;
+  }
+  else if (n < 0 && errno != EAGAIN && !full)
+  {
+    LOG_SYSERR << "TcpConnection::handleSpliceRead";
+    handleError();
+  }
+  if (full)
+  {
+    // backpressure, until peer drains its pipe.
+    channel_->disableReading();
+    splicePaused_ = true;
+  }
+}
+
+ssize_t TcpConnection::spliceFrom(int fd)
+{
+  loop_->assertInLoopThread();
+  ssize_t n = sockets::splice(fd, pipe_[1], pipeCapacity_ - pipeBytes_);
+  if (n > 0)
+  {
+    const int savedErrno = errno;
+    const size_t oldLen = outputBytes();
+    pipeBytes_ += n;
+    // if no thing else in output queue, try writing directly
+    if (!deferredFlush_ && !channel_->isWriting() && oldLen == 0 && state_ != kDisconnected)
+    {
+      ssize_t nwrote = writeOutput();
+      if (nwrote < 0 && errno != EWOULDBLOCK)
+      {
+        LOG_SYSERR << "TcpConnection::spliceFrom";
+      }
+      if (outputBytes() == 0 && writeCompleteCallback_)
+      {
+        loop_->queueInLoop(boost::bind(writeCompleteCallback_, shared_from_this()));
+      }
+    }
+    const size_t newLen = outputBytes();
+    if (newLen > 0)
+    {
+      if (newLen >= highWaterMark_
+          && oldLen < highWaterMark_
+          && highWaterMarkCallback_)
+      {
+        loop_->queueInLoop(boost::bind(highWaterMarkCallback_, shared_from_this(), newLen));
+      }
+      startWriting();
+    }
+    errno = savedErrno;
+  }
+  return n;
+}
+
+void TcpConnection::resumeSpliceRead()
+{
+  loop_->assertInLoopThread();
+  splicePaused_ = false;
+  if (reading_ && state_ == kConnected && !channel_->isReading())
+  {
+    channel_->enableReading();
+  }
+}
+
 void TcpConnection::handleWrite()
 {
   loop_->assertInLoopThread();
   if (channel_->isWriting())
   {
-    ssize_t n = sockets::write(channel_->fd(),
-                               outputBuffer_.peek(),
-                               outputBuffer_.readableBytes());
+    ssize_t n = writeOutput();
     if (n > 0)
     {
-      outputBuffer_.retrieve(n);
-      if (outputBuffer_.readableBytes() == 0)
+      if (outputBytes() == 0)
       {
         channel_->disableWriting();
         if (writeCompleteCallback_)
@@ -405,6 +695,191 @@ void TcpConnection::handleWrite()
   }
 }
 
+ssize_t TcpConnection::writeOutput()
+{
+  if (!sharedChunks_.empty())
+  {
+    return writeShared();
+  }
+  if (outputBuffer_.readableBytes() == 0 && pipeBytes_ > 0)
+  {
+    ssize_t n = sockets::splice(pipe_[0], channel_->fd(), pipeBytes_);
+    if (n > 0)
+    {
+      pipeBytes_ -= n;
+      TcpConnectionPtr source(spliceSource_.lock());
+      if (source && source->splicePaused_)
+      {
+        source->resumeSpliceRead();
+      }
+    }
+    return n;
+  }
+  ssize_t n = sockets::write(channel_->fd(),
+                             outputBuffer_.peek(),
+                             outputBuffer_.readableBytes());
+  if (n > 0)
+  {
+    outputBuffer_.retrieve(n);
+  }
+  return n;
+}
+
+ssize_t TcpConnection::writeShared()
+{
+  const int kMaxIov = 64;
+  struct iovec iov[kMaxIov];
+  int iovcnt = 0;
+  ssize_t n = -1;
+  bool zeroCopied = false;
+  if (zeroCopyThreshold_ > 0)
+  {
+    // only chunks not interleaved with outputBuffer_, whose bytes are
+    // reused as soon as they are retrieved.
+    size_t bytes = 0;
+    for (size_t i = 0; i < sharedChunks_.size() && iovcnt < kMaxIov
+                       && sharedChunks_[i].bufferedBefore == 0; ++i)
+    {
+      const SharedChunk& chunk = sharedChunks_[i];
+      iov[iovcnt].iov_base = const_cast<char*>(chunk.data + chunk.offset);
+      iov[iovcnt].iov_len = chunk.size - chunk.offset;
+      bytes += iov[iovcnt].iov_len;
+      ++iovcnt;
+    }
+    if (bytes >= zeroCopyThreshold_)
+    {
+      n = sockets::sendZeroCopy(channel_->fd(), iov, iovcnt);
+      zeroCopied = n > 0 || errno != ENOBUFS;  // ENOBUFS: out of optmem, copy
+    }
+    iovcnt = 0;
+  }
+
+  if (zeroCopied)
+  {
+    // hold every chunk this call touched until its completion.
+    size_t left = n > 0 ? n : 0;
+    for (size_t i = 0; left > 0; ++i)
+    {
+      const SharedChunk& chunk = sharedChunks_[i];
+      zeroCopyPending_.push_back(std::make_pair(zeroCopyNextSeq_, chunk.owner));
+      left -= std::min(left, chunk.size - chunk.offset);
+    }
+    if (n > 0)
+    {
+      ++zeroCopyNextSeq_;
+    }
+  }
+  else
+  {
+    const char* buffered = outputBuffer_.peek();
+    size_t i = 0;
+    for (; i < sharedChunks_.size() && iovcnt + 2 <= kMaxIov; ++i)
+    {
+      const SharedChunk& chunk = sharedChunks_[i];
+      if (chunk.bufferedBefore > 0)
+      {
+        iov[iovcnt].iov_base = const_cast<char*>(buffered);
+        iov[iovcnt].iov_len = chunk.bufferedBefore;
+        buffered += chunk.bufferedBefore;
+        ++iovcnt;
+      }
+      iov[iovcnt].iov_base = const_cast<char*>(chunk.data + chunk.offset);
+      iov[iovcnt].iov_len = chunk.size - chunk.offset;
+      ++iovcnt;
+    }
+    const size_t tail = outputBuffer_.readableBytes() - bufferedClaimed_;
+    if (i == sharedChunks_.size() && iovcnt < kMaxIov && tail > 0)
+    {
+      iov[iovcnt].iov_base = const_cast<char*>(buffered);
+      iov[iovcnt].iov_len = tail;
+      ++iovcnt;
+    }
+    n = sockets::writev(channel_->fd(), iov, iovcnt);
+  }
+  if (n <= 0)
+  {
+    return n;
+  }
+
+  size_t left = n;
+  while (left > 0 && !sharedChunks_.empty())
+  {
+    SharedChunk& chunk = sharedChunks_.front();
+    size_t b = std::min(left, chunk.bufferedBefore);
+    outputBuffer_.retrieve(b);
+    chunk.bufferedBefore -= b;
+    bufferedClaimed_ -= b;
+    left -= b;
+    if (chunk.bufferedBefore > 0)
+    {
+      break;
+    }
+    size_t m = std::min(left, chunk.size - chunk.offset);
+    chunk.offset += m;
+    sharedBytes_ -= m;
+    left -= m;
+    if (chunk.offset < chunk.size)
+    {
+      break;
+    }
+    sharedChunks_.pop_front();
+  }
+  outputBuffer_.retrieve(left);
+  return n;
+}
+
+void TcpConnection::startWriting()
+{
+  if (channel_->isWriting())
+  {
+    return;
+  }
+  if (!deferredFlush_)
+  {
+    channel_->enableWriting();
+  }
+  else if (!flushPending_)
+  {
+    flushPending_ = true;
+    loop_->runAtIterationEnd(
+        boost::bind(&TcpConnection::flushInLoop, shared_from_this()));
+  }
+}
+
+void TcpConnection::flushInLoop()
+{
+  loop_->assertInLoopThread();
+  flushPending_ = false;
+  if (state_ == kDisconnected || channel_->isWriting() || outputBytes() == 0)
+  {
+    return;
+  }
+  ssize_t n = writeOutput();
+  if (n < 0 && errno != EWOULDBLOCK)
+  {
+    LOG_SYSERR << "TcpConnection::flushInLoop";
+    if (errno == EPIPE || errno == ECONNRESET) // FIXME: any others?
+    {
+      return;
+    }
+  }
+  if (outputBytes() == 0)
+  {
+    if (writeCompleteCallback_)
+    {
+      loop_->queueInLoop(boost::bind(writeCompleteCallback_, shared_from_this()));
+    }
+    if (state_ == kDisconnecting)
+    {
+      shutdownInLoop();
+    }
+  }
+  else
+  {
+    channel_->enableWriting();
+  }
+}
+
 void TcpConnection::handleClose()
 {
   loop_->assertInLoopThread();
@@ -422,8 +897,40 @@ void TcpConnection::handleClose()
 
 void TcpConnection::handleError()
 {
+  // zero copy completions also make the socket report an error.
+  bool reaped = !zeroCopyPending_.empty() && reapZeroCopy();
   int err = sockets::getSocketError(channel_->fd());
+  if (reaped && err == 0)
+  {
+    return;
+  }
   LOG_ERROR << "TcpConnection::handleError [" << name_
             << "] - SO_ERROR = " << err << " " << strerror_tl(err);
 }
 
+bool TcpConnection::reapZeroCopy()
+{
+  bool reaped = false;
+  uint32_t lo = 0;
+  uint32_t hi = 0;
+  bool copied = false;
+  while (sockets::readZeroCopyCompletion(channel_->fd(), &lo, &hi, &copied))
+  {
+    reaped = true;
+    // TCP completes in order, every send up to hi is done.
+    while (!zeroCopyPending_.empty()
+           && static_cast<int32_t>(zeroCopyPending_.front().first - hi) <= 0)
+    {
+      zeroCopyPending_.pop_front();
+    }
+    if (copied && zeroCopyThreshold_ > 0)
+    {
+      // eg. loopback, the kernel copies anyway and zero copy only costs.
+      LOG_DEBUG << "TcpConnection::reapZeroCopy [" << name_
+                << "] - kernel copied, zero copy disabled";
+      zeroCopyThreshold_ = 0;
+    }
+  }
+  return reaped;
+}
+
@@ -22,6 +22,10 @@
 #include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <deque>
+#include <utility>
 
 // struct tcp_info is in <netinet/tcp.h>
 struct tcp_info;
@@ -35,6 +39,10 @@ class Channel;
 class EventLoop;
 class Socket;
 
+/// An immutable message, serialized once and queued by reference in
+/// every connection it is sent to, eg. a publish to many subscribers.
+typedef boost::shared_ptr<const string> SharedMessage;
+
 ///
 /// TCP connection, for both client and server usage.
 ///
@@ -68,11 +76,33 @@ class TcpConnection : boost::noncopyable,
   void send(const StringPiece& message);
   // void send(Buffer&& message); // C++11
   void send(Buffer* message);  // this one will swap data
+  // Queues message by reference, its bytes are shared, never copied.
+  void send(const SharedMessage& message);
+  // Zero-copy send, in loop thread only: append a message to outputBuffer()
+  // in place, then call sendOutputBuffer() with its readableBytes() before.
+  void sendOutputBuffer(size_t oldLen);
   void shutdown(); // NOT thread safe, no simultaneous calling
   // void shutdownAndForceCloseAfter(double seconds); // NOT thread safe, no simultaneous calling
   void forceClose();
   void forceCloseWithDelay(double seconds);
   void setTcpNoDelay(bool on);
+  // Deferred flush, in loop thread only: sends append to the output
+  // buffer and are written together once at the end of the loop
+  // iteration, one syscall for many small messages.
+  void setDeferredFlush(bool on) { deferredFlush_ = on; }
+  // Sends of at least bytes, shared messages and send(Buffer*), use
+  // MSG_ZEROCOPY.  Their memory is held until the kernel reports
+  // completion on the socket error queue.  0 (default) disables.
+  // In loop thread only.
+  void setZeroCopyThreshold(size_t bytes);
+  // Kernel side relay, in loop thread only: bytes read from this
+  // connection go to peer, in the same loop, through a pipe with splice(2)
+  // and never reach inputBuffer() or the message callback.  Pipe bytes
+  // count as peer's output, for its high water mark and write complete
+  // callbacks.  Don't send() to peer while splicing into it.
+  void startSplice(const TcpConnectionPtr& peer);
+  // SO_BUSY_POLL, see Socket::setBusyPoll()
+  void setBusyPoll(int usec);
   // reading or not
   void startRead();
   void stopRead();
@@ -124,6 +154,28 @@ class TcpConnection : boost::noncopyable,
   // void sendInLoop(string&& message);
   void sendInLoop(const StringPiece& message);
   void sendInLoop(const void* message, size_t len);
+  // keeps data alive while it's queued
+  typedef boost::shared_ptr<const void> ChunkOwner;
+  void sendChunk(const ChunkOwner& owner, const char* data, size_t len);
+  void sendChunkInLoop(const ChunkOwner& owner, const char* data, size_t len);
+  void sendBufferInLoop(const boost::shared_ptr<Buffer>& buf);
+  // writes as much output as possible, returns bytes written.
+  ssize_t writeOutput();
+  // writeOutput() when shared messages are queued.
+  ssize_t writeShared();
+  // enables writing, or schedules flushInLoop() in deferred flush mode.
+  void startWriting();
+  void flushInLoop();
+  // releases zero copy sends completed by the kernel, returns false if none.
+  bool reapZeroCopy();
+  // handleRead() when splicing to peer.
+  void handleSpliceRead(const boost::shared_ptr<TcpConnection>& peer);
+  // called on peer: fills its pipe from fd and writes it out, as sendInLoop().
+  ssize_t spliceFrom(int fd);
+  bool pipeFull() const { return pipeBytes_ >= pipeCapacity_; }
+  void resumeSpliceRead();
+  size_t outputBytes() const
+  { return outputBuffer_.readableBytes() + sharedBytes_ + pipeBytes_; }
   void shutdownInLoop();
   // void shutdownAndForceCloseInLoop(double seconds);
   void forceCloseInLoop();
@@ -136,6 +188,8 @@ class TcpConnection : boost::noncopyable,
   const string name_;
   StateE state_;  // FIXME: use atomic variable
   bool reading_;
+  bool deferredFlush_;
+  bool flushPending_;
   // we don't expose those classes to client.
   boost::scoped_ptr<Socket> socket_;
   boost::scoped_ptr<Channel> channel_;
@@ -149,6 +203,30 @@ class TcpConnection : boost::noncopyable,
   size_t highWaterMark_;
   Buffer inputBuffer_;
   Buffer outputBuffer_; // FIXME: use list<Buffer> as output buffer.
+  // shared messages interleaved with outputBuffer_, each one goes
+  // after bufferedBefore more bytes of outputBuffer_.
+  struct SharedChunk
+  {
+    ChunkOwner owner;
+    const char* data;
+    size_t size;
+    size_t offset;
+    size_t bufferedBefore;
+  };
+  std::deque<SharedChunk> sharedChunks_;
+  size_t sharedBytes_;      // not yet written of sharedChunks_
+  size_t bufferedClaimed_;  // sum of bufferedBefore
+  size_t zeroCopyThreshold_;
+  uint32_t zeroCopyNextSeq_;  // of the next sockets::sendZeroCopy()
+  // sent with MSG_ZEROCOPY, with sequence number, until completed.
+  std::deque<std::pair<uint32_t, ChunkOwner> > zeroCopyPending_;
+  // splice(2) relay, this -> splicePeer_, spliceSource_ -> pipe_ -> this.
+  boost::weak_ptr<TcpConnection> splicePeer_;
+  boost::weak_ptr<TcpConnection> spliceSource_;
+  bool splicePaused_;  // reading stopped while peer's pipe is full
+  int pipe_[2];
+  size_t pipeBytes_;  // after outputBuffer_ and sharedChunks_
+  size_t pipeCapacity_;
   boost::any context_;
   // FIXME: creationTime_, lastReceiveTime_
   //        bytesReceived_, bytesSent_
@@ -75,7 +75,11 @@ void TcpServer::start()
 void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 {
   loop_->assertInLoopThread();
-  EventLoop* ioLoop = threadPool_->getNextLoop();
+  // with pinned loops, keep the connection on the CPU its packets arrive.
+  EventLoop* ioLoop = threadPool_->hasCpuSets()
+      ? threadPool_->getLoopForCpu(sockets::getIncomingCpu(sockfd))
+      : threadPool_->getNextLoop();
+  threadPool_->updateLoad(ioLoop, 1);
   char buf[64];
   snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
   ++nextConnId_;
@@ -116,6 +120,7 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
   (void)n;
   assert(n == 1);
   EventLoop* ioLoop = conn->getLoop();
+  threadPool_->updateLoad(ioLoop, -1);
   ioLoop->queueInLoop(
       boost::bind(&TcpConnection::connectDestroyed, conn));
 }
@@ -63,7 +63,8 @@ class TcpServer : boost::noncopyable
   ///   this is the default value.
   /// - 1 means all I/O in another thread.
   /// - N means a thread pool with N threads, new connections
-  ///   are assigned on a round-robin basis.
+  ///   are assigned on a round-robin basis, unless another policy
+  ///   is chosen by threadPool()->setSelectionPolicy().
   void setThreadNum(int numThreads);
   void setThreadInitCallback(const ThreadInitCallback& cb)
   { threadInitCallback_ = cb; }
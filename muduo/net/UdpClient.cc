@@ -0,0 +1,50 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include <muduo/net/UdpClient.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+
+#include <boost/bind.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+UdpClient::UdpClient(EventLoop* loop,
+                     const InetAddress& serverAddr,
+                     const string& nameArg)
+  : loop_(CHECK_NOTNULL(loop)),
+    serverAddr_(serverAddr),
+    socket_(new UdpSocket(loop,
+                          InetAddress(0, false, serverAddr.family() == AF_INET6),
+                          nameArg))
+{
+  socket_->connect(serverAddr_);
+}
+
+UdpClient::~UdpClient()
+{
+  // the functor keeps socket alive until it has left its loop
+  loop_->runInLoop(boost::bind(&UdpSocket::stopInLoop, socket_));
+}
+
+void UdpClient::start()
+{
+  socket_->start();
+}
+
+void UdpClient::send(const StringPiece& message)
+{
+  socket_->send(message);
+}
+
+void UdpClient::send(Buffer* message)
+{
+  socket_->send(message->retrieveAllAsString());
+}
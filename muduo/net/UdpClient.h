@@ -0,0 +1,63 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_UDPCLIENT_H
+#define MUDUO_NET_UDPCLIENT_H
+
+#include <muduo/base/Types.h>
+#include <muduo/net/UdpSocket.h>
+
+#include <boost/noncopyable.hpp>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+
+///
+/// UDP client, a UdpSocket connected to one server.
+///
+/// There is no connection to set up, datagrams may be sent right away.
+class UdpClient : boost::noncopyable
+{
+ public:
+  UdpClient(EventLoop* loop,
+            const InetAddress& serverAddr,
+            const string& nameArg);
+  ~UdpClient();
+
+  EventLoop* getLoop() const { return loop_; }
+  const string& name() const { return socket_->name(); }
+  const InetAddress& serverAddress() const { return serverAddr_; }
+  const UdpSocketPtr& socket() const { return socket_; }
+
+  /// Not thread safe, call before start().
+  void setDatagramCallback(const DatagramCallback& cb)
+  { socket_->setDatagramCallback(cb); }
+
+  /// Starts receiving, thread safe.
+  void start();
+
+  /// Thread safe.
+  void send(const StringPiece& message);
+  void send(Buffer* message);
+
+ private:
+  EventLoop* loop_;
+  const InetAddress serverAddr_;
+  UdpSocketPtr socket_;
+};
+
+}
+}
+
+#endif  // MUDUO_NET_UDPCLIENT_H
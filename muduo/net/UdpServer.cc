@@ -0,0 +1,83 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include <muduo/net/UdpServer.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopThreadPool.h>
+
+#include <boost/bind.hpp>
+
+#include <stdio.h>  // snprintf
+
+using namespace muduo;
+using namespace muduo::net;
+
+UdpServer::UdpServer(EventLoop* loop,
+                     const InetAddress& listenAddr,
+                     const string& nameArg)
+  : loop_(CHECK_NOTNULL(loop)),
+    listenAddr_(listenAddr),
+    ipPort_(listenAddr.toIpPort()),
+    name_(nameArg),
+    threadPool_(new EventLoopThreadPool(loop, name_)),
+    maxDatagramSize_(UdpSocket::kDefaultMaxDatagramSize),
+    gro_(false),
+    gso_(false)
+{
+}
+
+UdpServer::~UdpServer()
+{
+  loop_->assertInLoopThread();
+  LOG_TRACE << "UdpServer::~UdpServer [" << name_ << "] destructing";
+
+  for (size_t i = 0; i < sockets_.size(); ++i)
+  {
+    // the functor keeps socket alive until it has left its loop
+    sockets_[i]->getLoop()->runInLoop(
+        boost::bind(&UdpSocket::stopInLoop, sockets_[i]));
+  }
+}
+
+void UdpServer::setThreadNum(int numThreads)
+{
+  assert(0 <= numThreads);
+  threadPool_->setThreadNum(numThreads);
+}
+
+void UdpServer::start()
+{
+  loop_->assertInLoopThread();
+  if (started_.getAndSet(1) == 0)
+  {
+    threadPool_->start(threadInitCallback_);
+
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+      char buf[64];
+      snprintf(buf, sizeof buf, "-%s#%zd", ipPort_.c_str(), i);
+      UdpSocketPtr socket(new UdpSocket(loops[i], listenAddr_, name_ + buf,
+                                        loops.size() > 1));
+      socket->setDatagramCallback(datagramCallback_);
+      socket->setMaxDatagramSize(maxDatagramSize_);
+      if (gro_ && !socket->setGro(true))
+      {
+        LOG_WARN << "UdpServer::start [" << name_ << "] - GRO is not supported";
+      }
+      if (gso_ && !socket->setGso(true))
+      {
+        LOG_WARN << "UdpServer::start [" << name_ << "] - GSO is not supported";
+      }
+      socket->start();
+      sockets_.push_back(socket);
+    }
+  }
+}
@@ -0,0 +1,93 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_UDPSERVER_H
+#define MUDUO_NET_UDPSERVER_H
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Types.h>
+#include <muduo/net/UdpSocket.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+class EventLoopThreadPool;
+
+///
+/// UDP server, supports single-threaded and thread-pool models.
+///
+/// With a thread pool, every IO loop has its own UdpSocket bound to the
+/// listen address with SO_REUSEPORT, and the kernel spreads datagrams
+/// among them by hash of the peer address.
+class UdpServer : boost::noncopyable
+{
+ public:
+  typedef boost::function<void(EventLoop*)> ThreadInitCallback;
+
+  UdpServer(EventLoop* loop,
+            const InetAddress& listenAddr,
+            const string& nameArg);
+  ~UdpServer();
+
+  const string& ipPort() const { return ipPort_; }
+  const string& name() const { return name_; }
+  EventLoop* getLoop() const { return loop_; }
+
+  /// Set the number of threads for handling input.
+  /// Must be called before @c start
+  /// - 0 means one socket in loop's thread, this is the default value.
+  /// - N means a thread pool with N threads, and N sockets.
+  void setThreadNum(int numThreads);
+  void setThreadInitCallback(const ThreadInitCallback& cb)
+  { threadInitCallback_ = cb; }
+
+  /// Not thread safe, call before start().
+  void setDatagramCallback(const DatagramCallback& cb)
+  { datagramCallback_ = cb; }
+  void setMaxDatagramSize(size_t size) { maxDatagramSize_ = size; }
+  void setGro(bool on) { gro_ = on; }
+  void setGso(bool on) { gso_ = on; }
+
+  /// Starts the server if it's not started.
+  ///
+  /// It's harmless to call it multiple times.
+  /// Must be called in loop's thread.
+  void start();
+
+  /// valid after calling start(), one for each IO loop
+  const std::vector<UdpSocketPtr>& sockets() const { return sockets_; }
+
+ private:
+  EventLoop* loop_;
+  const InetAddress listenAddr_;
+  const string ipPort_;
+  const string name_;
+  boost::shared_ptr<EventLoopThreadPool> threadPool_;
+  DatagramCallback datagramCallback_;
+  ThreadInitCallback threadInitCallback_;
+  size_t maxDatagramSize_;
+  bool gro_;
+  bool gso_;
+  AtomicInt32 started_;
+  std::vector<UdpSocketPtr> sockets_;
+};
+
+}
+}
+
+#endif  // MUDUO_NET_UDPSERVER_H
@@ -0,0 +1,469 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include <muduo/net/UdpSocket.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/Channel.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/Socket.h>
+#include <muduo/net/SocketsOps.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const size_t kGroBufferSize = 65536;
+const size_t kMaxUdpPayload = 65507;
+const size_t kMaxGsoSegments = 64;  // UDP_MAX_SEGMENTS of kernel
+
+void defaultDatagramCallback(UdpSocket* socket,
+                             Buffer* datagram,
+                             const InetAddress& peer,
+                             Timestamp)
+{
+  LOG_TRACE << socket->name() << " discards " << datagram->readableBytes()
+            << " bytes from " << peer.toIpPort();
+}
+
+int64_t datagramsOf(size_t length, size_t segmentSize)
+{
+  return segmentSize == 0 ? 1 : static_cast<int64_t>((length + segmentSize - 1) / segmentSize);
+}
+
+}
+
+UdpSocket::UdpSocket(EventLoop* loop,
+                     const InetAddress& localAddr,
+                     const string& nameArg,
+                     bool reusePort)
+  : loop_(CHECK_NOTNULL(loop)),
+    name_(nameArg),
+    socket_(new Socket(sockets::createUdpNonblockingOrDie(localAddr.family()))),
+    channel_(new Channel(loop, socket_->fd())),
+    datagramCallback_(defaultDatagramCallback),
+    maxDatagramSize_(kDefaultMaxDatagramSize),
+    started_(false),
+    connected_(false),
+    gro_(false),
+    gso_(false),
+    batching_(false),
+    inputs_(kBatchSize),
+    inputPeers_(kBatchSize),
+    inputMsgs_(kBatchSize),
+    inputIov_(kBatchSize),
+    numReceived_(0),
+    numSent_(0),
+    numDropped_(0),
+    numErrors_(0)
+{
+  if (reusePort)
+  {
+    socket_->setReusePort(true);
+  }
+  socket_->bindAddress(localAddr);
+  channel_->setReadCallback(
+      boost::bind(&UdpSocket::handleRead, this, _1));
+  // eg. ICMP port unreachable on a connected socket, stays pending until read
+  channel_->setErrorCallback(
+      boost::bind(&UdpSocket::handleError, this));
+}
+
+UdpSocket::~UdpSocket()
+{
+  assert(!started_);
+  LOG_DEBUG << "UdpSocket::dtor[" << name_ << "] received " << numReceived_
+            << " sent " << numSent_ << " dropped " << numDropped_
+            << " errors " << numErrors_;
+}
+
+void UdpSocket::connect(const InetAddress& peerAddr)
+{
+  if (sockets::connect(socket_->fd(), peerAddr.getSockAddr()) < 0)
+  {
+    LOG_SYSERR << "UdpSocket::connect[" << name_ << "] " << peerAddr.toIpPort();
+  }
+  else
+  {
+    connected_ = true;
+  }
+}
+
+void UdpSocket::setMaxDatagramSize(size_t size)
+{
+  assert(!started_);
+  maxDatagramSize_ = size;
+}
+
+bool UdpSocket::setGro(bool on)
+{
+#ifdef UDP_GRO
+  int optval = on ? 1 : 0;
+  if (::setsockopt(socket_->fd(), IPPROTO_UDP, UDP_GRO,
+                   &optval, static_cast<socklen_t>(sizeof optval)) < 0)
+  {
+    LOG_SYSERR << "UdpSocket::setGro[" << name_ << "]";
+    return false;
+  }
+  gro_ = on;
+  return true;
+#else
+  return !on;
+#endif
+}
+
+bool UdpSocket::setGso(bool on)
+{
+#ifdef UDP_SEGMENT
+  int optval = 0;
+  socklen_t optlen = static_cast<socklen_t>(sizeof optval);
+  // probes the kernel, the segment size is given per message
+  if (on && ::getsockopt(socket_->fd(), IPPROTO_UDP, UDP_SEGMENT, &optval, &optlen) < 0)
+  {
+    LOG_SYSERR << "UdpSocket::setGso[" << name_ << "]";
+    return false;
+  }
+  gso_ = on;
+  return true;
+#else
+  return !on;
+#endif
+}
+
+void UdpSocket::start()
+{
+  loop_->runInLoop(
+      boost::bind(&UdpSocket::startInLoop, this));
+}
+
+void UdpSocket::startInLoop()
+{
+  loop_->assertInLoopThread();
+  if (!started_)
+  {
+    started_ = true;
+    channel_->enableReading();
+  }
+}
+
+void UdpSocket::stopInLoop()
+{
+  loop_->assertInLoopThread();
+  if (started_)
+  {
+    started_ = false;
+    channel_->disableAll();
+    channel_->remove();
+  }
+}
+
+void UdpSocket::handleError()
+{
+  int err = sockets::getSocketError(socket_->fd());
+  ++numErrors_;
+  LOG_WARN << "UdpSocket::handleError[" << name_ << "] - SO_ERROR = "
+           << err << " " << strerror_tl(err);
+}
+
+void UdpSocket::handleRead(Timestamp receiveTime)
+{
+  loop_->assertInLoopThread();
+  const size_t bufferSize = gro_ ? kGroBufferSize : maxDatagramSize_;
+  const size_t controlLen = CMSG_SPACE(sizeof(int));
+  inputControl_.resize(kBatchSize * controlLen);
+  for (int i = 0; i < kBatchSize; ++i)
+  {
+    Buffer& input = inputs_[i];
+    input.retrieveAll();
+    input.ensureWritableBytes(bufferSize);
+    inputIov_[i].iov_base = input.beginWrite();
+    inputIov_[i].iov_len = bufferSize;
+
+    struct msghdr& msg = inputMsgs_[i].msg_hdr;
+    bzero(&msg, sizeof msg);
+    msg.msg_name = &inputPeers_[i];
+    msg.msg_namelen = static_cast<socklen_t>(sizeof inputPeers_[i]);
+    msg.msg_iov = &inputIov_[i];
+    msg.msg_iovlen = 1;
+    if (gro_)
+    {
+      msg.msg_control = &inputControl_[i * controlLen];
+      msg.msg_controllen = controlLen;
+    }
+  }
+
+  int n = ::recvmmsg(socket_->fd(), &inputMsgs_[0], kBatchSize, 0, NULL);
+  if (n < 0)
+  {
+    if (errno != EAGAIN && errno != EINTR)
+    {
+      LOG_SYSERR << "UdpSocket::handleRead[" << name_ << "]";
+    }
+    return;
+  }
+
+  batching_ = true;
+  for (int i = 0; i < n; ++i)
+  {
+    struct msghdr& msg = inputMsgs_[i].msg_hdr;
+    if (msg.msg_flags & MSG_TRUNC)
+    {
+      ++numDropped_;
+      continue;
+    }
+    inputs_[i].hasWritten(inputMsgs_[i].msg_len);
+
+    size_t segmentSize = 0;
+#ifdef UDP_GRO
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+      if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO)
+      {
+        int gso = 0;
+        memcpy(&gso, CMSG_DATA(cmsg), sizeof gso);
+        segmentSize = static_cast<size_t>(gso);
+      }
+    }
+#endif
+    deliver(&inputs_[i], segmentSize, InetAddress(inputPeers_[i]), receiveTime);
+  }
+  batching_ = false;
+  flush();
+}
+
+void UdpSocket::deliver(Buffer* datagram,
+                        size_t segmentSize,
+                        const InetAddress& peer,
+                        Timestamp receiveTime)
+{
+  if (segmentSize == 0 || datagram->readableBytes() <= segmentSize)
+  {
+    ++numReceived_;
+    datagramCallback_(this, datagram, peer, receiveTime);
+    return;
+  }
+
+  // coalesced by GRO
+  while (datagram->readableBytes() > 0)
+  {
+    const size_t len = std::min(segmentSize, datagram->readableBytes());
+    segment_.retrieveAll();
+    segment_.append(datagram->peek(), len);
+    datagram->retrieve(len);
+    ++numReceived_;
+    datagramCallback_(this, &segment_, peer, receiveTime);
+  }
+}
+
+void UdpSocket::send(const InetAddress& peer, const StringPiece& message)
+{
+  if (loop_->isInLoopThread())
+  {
+    queue(peer.getSockAddr(), message.data(), message.size(), 0);
+  }
+  else
+  {
+    loop_->runInLoop(
+        boost::bind(&UdpSocket::sendInLoop, this, peer, true, message.as_string(), 0));
+  }
+}
+
+void UdpSocket::send(const InetAddress& peer, Buffer* message)
+{
+  if (loop_->isInLoopThread())
+  {
+    queue(peer.getSockAddr(), message->peek(), message->readableBytes(), 0);
+    message->retrieveAll();
+  }
+  else
+  {
+    loop_->runInLoop(
+        boost::bind(&UdpSocket::sendInLoop, this, peer, true, message->retrieveAllAsString(), 0));
+  }
+}
+
+void UdpSocket::send(const StringPiece& message)
+{
+  assert(connected_);
+  if (loop_->isInLoopThread())
+  {
+    queue(NULL, message.data(), message.size(), 0);
+  }
+  else
+  {
+    loop_->runInLoop(
+        boost::bind(&UdpSocket::sendInLoop, this, InetAddress(), false, message.as_string(), 0));
+  }
+}
+
+void UdpSocket::sendSegments(const InetAddress& peer,
+                             const StringPiece& data,
+                             size_t segmentSize)
+{
+  assert(segmentSize > 0);
+  if (loop_->isInLoopThread())
+  {
+    queue(peer.getSockAddr(), data.data(), data.size(), segmentSize);
+  }
+  else
+  {
+    loop_->runInLoop(
+        boost::bind(&UdpSocket::sendInLoop, this, peer, true, data.as_string(), segmentSize));
+  }
+}
+
+void UdpSocket::sendInLoop(const InetAddress& peer,
+                           bool toPeer,
+                           const string& data,
+                           size_t segmentSize)
+{
+  queue(toPeer ? peer.getSockAddr() : NULL, data.data(), data.size(), segmentSize);
+}
+
+void UdpSocket::queue(const struct sockaddr* peer,
+                      const char* data,
+                      size_t len,
+                      size_t segmentSize)
+{
+  loop_->assertInLoopThread();
+  if (segmentSize == 0 || segmentSize >= len)
+  {
+    segmentSize = len > 0 ? len : 1;
+  }
+  if (segmentSize > kMaxUdpPayload)
+  {
+    LOG_ERROR << "UdpSocket::queue[" << name_ << "] datagram of "
+              << segmentSize << " bytes is too long";
+    ++numDropped_;
+    return;
+  }
+
+  // one Pending for each datagram, or each train of them with GSO
+  size_t train = segmentSize;
+  if (gso_)
+  {
+    train *= std::min(kMaxGsoSegments, kMaxUdpPayload / segmentSize);
+  }
+  size_t offset = 0;
+  do
+  {
+    Pending p;
+    p.offset = output_.readableBytes();
+    p.length = std::min(train, len - offset);
+    p.hasPeer = peer != NULL;
+    if (peer)
+    {
+      // InetAddress always holds a sockaddr_in6
+      memcpy(&p.peer, peer, sizeof p.peer);
+    }
+    p.segmentSize = p.length > segmentSize ? static_cast<uint16_t>(segmentSize) : 0;
+    output_.append(data + offset, p.length);
+    pending_.push_back(p);
+    offset += p.length;
+  } while (offset < len);
+
+  if (!batching_)
+  {
+    flush();
+  }
+}
+
+// Datagrams are dropped if the socket buffer is full, as UDP does.
+void UdpSocket::flush()
+{
+  const size_t n = pending_.size();
+  if (n == 0)
+  {
+    return;
+  }
+
+  const size_t controlLen = CMSG_SPACE(sizeof(uint16_t));
+  outputMsgs_.resize(n);
+  outputIov_.resize(n);
+  outputControl_.resize(n * controlLen);
+  for (size_t i = 0; i < n; ++i)
+  {
+    Pending& p = pending_[i];
+    outputIov_[i].iov_base = const_cast<char*>(output_.peek() + p.offset);
+    outputIov_[i].iov_len = p.length;
+
+    struct msghdr& msg = outputMsgs_[i].msg_hdr;
+    bzero(&msg, sizeof msg);
+    if (p.hasPeer)
+    {
+      msg.msg_name = &p.peer;
+      msg.msg_namelen = static_cast<socklen_t>(p.peer.sin6_family == AF_INET6
+                                               ? sizeof(struct sockaddr_in6)
+                                               : sizeof(struct sockaddr_in));
+    }
+    msg.msg_iov = &outputIov_[i];
+    msg.msg_iovlen = 1;
+#ifdef UDP_SEGMENT
+    if (p.segmentSize > 0)
+    {
+      msg.msg_control = &outputControl_[i * controlLen];
+      msg.msg_controllen = controlLen;
+      struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level = IPPROTO_UDP;
+      cmsg->cmsg_type = UDP_SEGMENT;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      memcpy(CMSG_DATA(cmsg), &p.segmentSize, sizeof p.segmentSize);
+    }
+#endif
+  }
+
+  size_t sent = 0;
+  while (sent < n)
+  {
+    int nw = ::sendmmsg(socket_->fd(), &outputMsgs_[sent],
+                        static_cast<unsigned int>(n - sent), 0);
+    if (nw > 0)
+    {
+      for (int i = 0; i < nw; ++i)
+      {
+        numSent_ += datagramsOf(pending_[sent + i].length, pending_[sent + i].segmentSize);
+      }
+      sent += nw;
+    }
+    else if (errno == EINTR)
+    {
+      continue;
+    }
+    else if (errno == EAGAIN)
+    {
+      for (; sent < n; ++sent)
+      {
+        numDropped_ += datagramsOf(pending_[sent].length, pending_[sent].segmentSize);
+      }
+    }
+    else
+    {
+      // eg. ECONNREFUSED of a connected socket, skips this one
+      LOG_SYSERR << "UdpSocket::flush[" << name_ << "]";
+      numDropped_ += datagramsOf(pending_[sent].length, pending_[sent].segmentSize);
+      ++sent;
+    }
+  }
+
+  pending_.clear();
+  output_.retrieveAll();
+  if (output_.internalCapacity() > kGroBufferSize * 16)
+  {
+    output_.shrink(0);
+  }
+}
@@ -0,0 +1,167 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_UDPSOCKET_H
+#define MUDUO_NET_UDPSOCKET_H
+
+#include <muduo/base/StringPiece.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/base/Types.h>
+#include <muduo/net/Buffer.h>
+#include <muduo/net/InetAddress.h>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace muduo
+{
+namespace net
+{
+
+class Channel;
+class EventLoop;
+class Socket;
+class UdpSocket;
+
+typedef boost::shared_ptr<UdpSocket> UdpSocketPtr;
+/// the datagram may be retrieved or swapped, it's reset after return.
+typedef boost::function<void (UdpSocket*,
+                              Buffer*,
+                              const InetAddress& peer,
+                              Timestamp)> DatagramCallback;
+
+///
+/// A UDP socket, served in one loop.
+///
+/// Datagrams are read in batches of kBatchSize with recvmmsg(), each is
+/// passed to the datagram callback in its own Buffer.  Datagrams sent in
+/// the callback are queued and written with one sendmmsg() after the
+/// batch, others are written at once.  Like UDP itself, datagrams that
+/// don't fit in the socket buffer are dropped, and counted.
+///
+/// With GRO, the kernel may coalesce datagrams of a peer into one read,
+/// they are split again before calling back.  With GSO, sendSegments()
+/// passes a train of equal sized datagrams to the kernel in one go.
+class UdpSocket : boost::noncopyable
+{
+ public:
+  static const int kBatchSize = 32;
+  static const size_t kDefaultMaxDatagramSize = 2048;
+
+  UdpSocket(EventLoop* loop,
+            const InetAddress& localAddr,
+            const string& name,
+            bool reusePort = false);
+  ~UdpSocket();  // force out-line dtor, for scoped_ptr members.
+
+  EventLoop* getLoop() const { return loop_; }
+  const string& name() const { return name_; }
+
+  /// Sends to peerAddr by default and only receives from it, for clients.
+  void connect(const InetAddress& peerAddr);
+
+  /// Not thread safe, call before start().
+  void setDatagramCallback(const DatagramCallback& cb)
+  { datagramCallback_ = cb; }
+  /// Longer datagrams are dropped.
+  void setMaxDatagramSize(size_t size);
+  /// Returns false if not supported by the kernel.
+  bool setGro(bool on);
+  bool setGso(bool on);
+
+  /// Thread safe.
+  void start();
+  /// Must be called in loop, before destructing a started socket.
+  void stopInLoop();
+
+  /// Thread safe, but the socket must outlive sends from other threads.
+  void send(const InetAddress& peer, const StringPiece& message);
+  /// Retrieves all of message.
+  void send(const InetAddress& peer, Buffer* message);
+  /// To the connected peer.
+  void send(const StringPiece& message);
+  /// Sends data as datagrams of segmentSize bytes, the last one may be
+  /// shorter.  Without GSO, it's the same as sending them one by one.
+  void sendSegments(const InetAddress& peer,
+                    const StringPiece& data,
+                    size_t segmentSize);
+
+  int64_t numReceived() const { return numReceived_; }
+  int64_t numSent() const { return numSent_; }
+  int64_t numDropped() const { return numDropped_; }
+  /// Errors reported by the socket, eg. the connected peer is unreachable.
+  int64_t numErrors() const { return numErrors_; }
+
+ private:
+  // a queued datagram, or a train of them with GSO
+  struct Pending
+  {
+    size_t offset;  // in output_
+    size_t length;
+    struct sockaddr_in6 peer;
+    bool hasPeer;   // false for the connected peer
+    uint16_t segmentSize;  // 0 for a single datagram
+  };
+
+  void startInLoop();
+  void handleRead(Timestamp receiveTime);
+  void handleError();
+  void deliver(Buffer* datagram, size_t segmentSize, const InetAddress& peer,
+               Timestamp receiveTime);
+  void sendInLoop(const InetAddress& peer, bool toPeer, const string& data,
+                  size_t segmentSize);
+  void queue(const struct sockaddr* peer, const char* data, size_t len,
+             size_t segmentSize);
+  void flush();
+
+  EventLoop* loop_;
+  const string name_;
+  boost::scoped_ptr<Socket> socket_;
+  boost::scoped_ptr<Channel> channel_;
+  DatagramCallback datagramCallback_;
+  size_t maxDatagramSize_;
+  bool started_;
+  bool connected_;
+  bool gro_;
+  bool gso_;
+  bool batching_;  // in handleRead(), sends are queued
+
+  // one batch of reads, GRO reads need a large buffer
+  std::vector<Buffer> inputs_;
+  std::vector<struct sockaddr_in6> inputPeers_;
+  std::vector<struct mmsghdr> inputMsgs_;
+  std::vector<struct iovec> inputIov_;
+  std::vector<char> inputControl_;
+  Buffer segment_;
+
+  // one batch of writes
+  Buffer output_;
+  std::vector<Pending> pending_;
+  std::vector<struct mmsghdr> outputMsgs_;
+  std::vector<struct iovec> outputIov_;
+  std::vector<char> outputControl_;
+
+  int64_t numReceived_;
+  int64_t numSent_;
+  int64_t numDropped_;
+  int64_t numErrors_;
+};
+
+}
+}
+
+#endif  // MUDUO_NET_UDPSOCKET_H
@@ -141,6 +141,62 @@ class ZlibOutputStream : boost::noncopyable
   int bufferSize_;
 };
 
+// Compresses whole messages, one at a time.
+// The deflate state is reset instead of freed between messages,
+// so its window and hash chains are allocated once per object.
+// Not thread safe, usually kept per thread.
+class ZlibDeflater : boost::noncopyable
+{
+ public:
+  enum Format
+  {
+    kZlib = 15,       // RFC 1950, aka HTTP "deflate"
+    kGzip = 15 + 16,  // RFC 1952
+  };
+
+  explicit ZlibDeflater(Format format, int level = Z_DEFAULT_COMPRESSION)
+    : zerror_(Z_OK)
+  {
+    bzero(&zstream_, sizeof zstream_);
+    zerror_ = deflateInit2(&zstream_, level, Z_DEFLATED, format, 8, Z_DEFAULT_STRATEGY);
+  }
+
+  ~ZlibDeflater()
+  {
+    if (zerror_ == Z_OK)
+    {
+      deflateEnd(&zstream_);
+    }
+  }
+
+  int zlibErrorCode() const { return zerror_; }
+
+  // Appends compressed input to output, returns false on error.
+  bool compress(StringPiece input, Buffer* output)
+  {
+    if (zerror_ != Z_OK)
+      return false;
+
+    size_t bound = deflateBound(&zstream_, input.size());
+    output->ensureWritableBytes(bound);
+    void* in = const_cast<char*>(input.data());
+    zstream_.next_in = static_cast<Bytef*>(in);
+    zstream_.avail_in = input.size();
+    zstream_.next_out = reinterpret_cast<Bytef*>(output->beginWrite());
+    zstream_.avail_out = static_cast<uInt>(bound);
+    int error = ::deflate(&zstream_, Z_FINISH);
+    output->hasWritten(bound - zstream_.avail_out);
+    zstream_.next_in = NULL;
+    zstream_.next_out = NULL;
+    zerror_ = deflateReset(&zstream_);
+    return error == Z_STREAM_END && zerror_ == Z_OK;
+  }
+
+ private:
+  z_stream zstream_;
+  int zerror_;
+};
+
 }
 }
 
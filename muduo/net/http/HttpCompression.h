@@ -0,0 +1,45 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_HTTP_HTTPCOMPRESSION_H
+#define MUDUO_NET_HTTP_HTTPCOMPRESSION_H
+
+#include <muduo/base/Types.h>
+
+#include <stddef.h>
+
+namespace muduo
+{
+namespace net
+{
+
+class HttpRequest;
+class HttpResponse;
+
+namespace detail
+{
+
+// Only available when built with zlib, ie. HAVE_ZLIB.
+
+// Returns the preferred coding in an Accept-Encoding header value,
+// ZlibDeflater::kGzip or kZlib, or 0 if neither gzip nor deflate is
+// acceptable.  Explicitly listed codings override "*".
+int chooseContentEncoding(const string& acceptEncoding);
+
+// Compresses resp's body in place if it is at least threshold bytes,
+// not encoded yet and req accepts gzip or deflate.  Such a response
+// carries "Vary: Accept-Encoding" even if it is sent uncompressed.
+void compressResponse(const HttpRequest& req, size_t threshold, HttpResponse* resp);
+
+}
+}
+}
+
+#endif  // MUDUO_NET_HTTP_HTTPCOMPRESSION_H
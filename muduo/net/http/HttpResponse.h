@@ -32,6 +32,7 @@ class HttpResponse : public muduo::copyable
     k301MovedPermanently = 301,
     k400BadRequest = 400,
     k404NotFound = 404,
+    k405MethodNotAllowed = 405,
   };
 
   explicit HttpResponse(bool close)
@@ -59,9 +60,15 @@ class HttpResponse : public muduo::copyable
   void addHeader(const string& key, const string& value)
   { headers_[key] = value; }
 
+  bool hasHeader(const string& key) const
+  { return headers_.find(key) != headers_.end(); }
+
   void setBody(const string& body)
   { body_ = body; }
 
+  const string& body() const
+  { return body_; }
+
   void appendToBuffer(Buffer* output) const;
 
  private:
@@ -0,0 +1,301 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include <muduo/net/http/HttpRouter.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/http/HttpResponse.h>
+
+#include <algorithm>
+
+#include <string.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+HttpRouter::HttpRouter()
+  : numRoutes_(0)
+{
+  newNode(kStatic);  // root
+}
+
+HttpRouter::~HttpRouter()
+{
+}
+
+int HttpRouter::newNode(NodeType type)
+{
+  nodes_.push_back(Node(type));
+  return static_cast<int>(nodes_.size() - 1);
+}
+
+bool HttpRouter::add(HttpRequest::Method method,
+                     const string& pattern,
+                     const Handler& handler)
+{
+  if (method == HttpRequest::kInvalid || pattern.empty() || pattern[0] != '/')
+  {
+    LOG_ERROR << "HttpRouter::add - invalid route " << pattern;
+    return false;
+  }
+
+  const char* const start = pattern.data();
+  const char* const end = start + pattern.size();
+  const char* p = start;
+  int node = 0;
+  int numParams = 0;
+  while (p < end)
+  {
+    // wildcards only start a path segment
+    const char* wild = p;
+    while (wild < end && !((*wild == ':' || *wild == '*') && wild[-1] == '/'))
+    {
+      ++wild;
+    }
+    if (wild > p)
+    {
+      node = insertStatic(node, p, wild);
+    }
+    if (wild == end)
+    {
+      break;
+    }
+
+    const char* nameEnd = std::find(wild + 1, end, '/');
+    if (nameEnd == wild + 1 || ++numParams > kMaxParams)
+    {
+      LOG_ERROR << "HttpRouter::add - bad wildcard in " << pattern;
+      return false;
+    }
+    string name(wild + 1, nameEnd);
+    bool catchAll = *wild == '*';
+    if (catchAll && nameEnd != end)
+    {
+      LOG_ERROR << "HttpRouter::add - catch-all must be last in " << pattern;
+      return false;
+    }
+
+    int child = catchAll ? nodes_[node].catchAllChild : nodes_[node].paramChild;
+    if (child < 0)
+    {
+      child = newNode(catchAll ? kCatchAll : kParam);
+      nodes_[child].prefix = name;
+      if (catchAll)
+      {
+        nodes_[node].catchAllChild = child;
+      }
+      else
+      {
+        nodes_[node].paramChild = child;
+      }
+    }
+    else if (nodes_[child].prefix != name)
+    {
+      LOG_ERROR << "HttpRouter::add - wildcard " << name << " in " << pattern
+                << " conflicts with " << nodes_[child].prefix;
+      return false;
+    }
+    node = child;
+    p = nameEnd;
+  }
+
+  Node& n = nodes_[node];
+  if (n.handlers[method])
+  {
+    LOG_ERROR << "HttpRouter::add - duplicated route " << pattern;
+    return false;
+  }
+  n.handlers[method] = handler;
+  n.hasHandler = true;
+  ++numRoutes_;
+  return true;
+}
+
+// Inserts static text [begin, end) below node, splitting edges as needed.
+// Returns the node that ends with the text.
+int HttpRouter::insertStatic(int node, const char* begin, const char* end)
+{
+  while (begin < end)
+  {
+    size_t pos = nodes_[node].indices.find(*begin);
+    if (pos == string::npos)
+    {
+      int child = newNode(kStatic);
+      nodes_[child].prefix.assign(begin, end);
+      nodes_[node].indices.push_back(*begin);
+      nodes_[node].children.push_back(child);
+      return child;
+    }
+
+    int child = nodes_[node].children[pos];
+    size_t common = 0;
+    {
+      const string& prefix = nodes_[child].prefix;
+      size_t len = std::min(prefix.size(), static_cast<size_t>(end - begin));
+      while (common < len && prefix[common] == begin[common])
+      {
+        ++common;
+      }
+    }
+
+    if (common < nodes_[child].prefix.size())
+    {
+      int mid = newNode(kStatic);
+      Node& c = nodes_[child];
+      Node& m = nodes_[mid];
+      m.prefix.assign(c.prefix, 0, common);
+      c.prefix.erase(0, common);
+      m.indices.push_back(c.prefix[0]);
+      m.children.push_back(child);
+      nodes_[node].children[pos] = mid;
+      child = mid;
+    }
+    node = child;
+    begin += common;
+  }
+  return node;
+}
+
+// Routes without a handler for method don't stop the search, a sibling
+// parameter or catch-all may have one.  The first of them is kept in
+// *fallback, for 405.
+bool HttpRouter::match(int node,
+                       const char* begin,
+                       const char* end,
+                       HttpRequest::Method method,
+                       Params* params,
+                       int* result,
+                       int* fallback) const
+{
+  const Node& n = nodes_[node];
+  if (begin == end && n.hasHandler)
+  {
+    if (n.handlers[method])
+    {
+      *result = node;
+      return true;
+    }
+    if (*fallback < 0)
+    {
+      *fallback = node;
+    }
+  }
+
+  if (begin < end)
+  {
+    const void* idx = memchr(n.indices.data(), *begin, n.indices.size());
+    if (idx)
+    {
+      int child = n.children[static_cast<const char*>(idx) - n.indices.data()];
+      const string& prefix = nodes_[child].prefix;
+      if (static_cast<size_t>(end - begin) >= prefix.size()
+          && memcmp(begin, prefix.data(), prefix.size()) == 0
+          && match(child, begin + prefix.size(), end, method, params, result, fallback))
+      {
+        return true;
+      }
+    }
+
+    if (n.paramChild >= 0 && params->size_ < kMaxParams)
+    {
+      const char* slash = static_cast<const char*>(memchr(begin, '/', end - begin));
+      if (slash == NULL)
+      {
+        slash = end;
+      }
+      if (slash > begin)
+      {
+        int saved = params->size_;
+        params->names_[saved] = nodes_[n.paramChild].prefix;
+        params->values_[saved] = StringPiece(begin, static_cast<int>(slash - begin));
+        params->size_ = saved + 1;
+        if (match(n.paramChild, slash, end, method, params, result, fallback))
+        {
+          return true;
+        }
+        params->size_ = saved;
+      }
+    }
+  }
+
+  if (n.catchAllChild >= 0 && params->size_ < kMaxParams)
+  {
+    if (!nodes_[n.catchAllChild].handlers[method])
+    {
+      if (*fallback < 0)
+      {
+        *fallback = n.catchAllChild;
+      }
+      return false;
+    }
+    int saved = params->size_;
+    params->names_[saved] = nodes_[n.catchAllChild].prefix;
+    params->values_[saved] = StringPiece(begin, static_cast<int>(end - begin));
+    params->size_ = saved + 1;
+    *result = n.catchAllChild;
+    return true;
+  }
+  return false;
+}
+
+const HttpRouter::Handler* HttpRouter::find(HttpRequest::Method method,
+                                            StringPiece path,
+                                            Params* params,
+                                            bool* methodAllowed) const
+{
+  assert(0 <= method && method < kNumMethods);
+  params->size_ = 0;
+  int node = -1;
+  int fallback = -1;
+  if (match(0, path.data(), path.data() + path.size(), method, params, &node, &fallback))
+  {
+    *methodAllowed = true;
+    return &nodes_[node].handlers[method];
+  }
+  // the path matches, but only routes of other methods
+  *methodAllowed = fallback < 0;
+  return NULL;
+}
+
+void HttpRouter::route(const HttpRequest& req, HttpResponse* resp) const
+{
+  Params params;
+  bool methodAllowed = true;
+  const Handler* handler = find(req.method(), req.path(), &params, &methodAllowed);
+  if (handler)
+  {
+    (*handler)(req, params, resp);
+  }
+  else if (!methodAllowed)
+  {
+    static const char* const kMethodNames[kNumMethods] =
+      { "", "GET", "POST", "HEAD", "PUT", "DELETE" };
+    string allow;
+    for (int m = HttpRequest::kGet; m < kNumMethods; ++m)
+    {
+      if (find(static_cast<HttpRequest::Method>(m), req.path(), &params, &methodAllowed))
+      {
+        if (!allow.empty())
+        {
+          allow += ", ";
+        }
+        allow += kMethodNames[m];
+      }
+    }
+    resp->setStatusCode(HttpResponse::k405MethodNotAllowed);
+    resp->setStatusMessage("Method Not Allowed");
+    resp->addHeader("Allow", allow);
+  }
+  else
+  {
+    resp->setStatusCode(HttpResponse::k404NotFound);
+    resp->setStatusMessage("Not Found");
+    resp->setCloseConnection(true);
+  }
+}
@@ -0,0 +1,148 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_HTTP_HTTPROUTER_H
+#define MUDUO_NET_HTTP_HTTPROUTER_H
+
+#include <muduo/base/StringPiece.h>
+#include <muduo/base/Types.h>
+#include <muduo/net/http/HttpRequest.h>
+
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace muduo
+{
+namespace net
+{
+
+class HttpResponse;
+
+/// Radix tree of request paths, with per-method handlers.
+///
+/// Patterns are made of static text, named parameters and an optional
+/// trailing catch-all, e.g. "/users/:id/posts" or "/static/*filepath".
+/// A parameter matches one non-empty path segment, a catch-all matches the
+/// rest of the path.  Static text takes priority over parameters, which
+/// take priority over catch-alls.
+///
+/// Matching walks the tree once and never allocates, parameter values
+/// are StringPieces into HttpRequest::path().
+///
+/// Not thread safe, routes must be added before HttpServer::start().
+/// route() may be called concurrently from any number of IO threads.
+class HttpRouter : boost::noncopyable
+{
+ public:
+  static const int kMaxParams = 8;
+
+  class Params // copyable
+  {
+   public:
+    Params()
+      : size_(0)
+    {
+    }
+
+    int size() const { return size_; }
+    StringPiece name(int i) const { return names_[i]; }
+    StringPiece value(int i) const { return values_[i]; }
+
+    /// returns empty StringPiece if not found
+    StringPiece get(StringPiece name) const
+    {
+      for (int i = 0; i < size_; ++i)
+      {
+        if (names_[i] == name)
+        {
+          return values_[i];
+        }
+      }
+      return StringPiece();
+    }
+
+   private:
+    friend class HttpRouter;
+    int size_;
+    StringPiece names_[kMaxParams];
+    StringPiece values_[kMaxParams];
+  };
+
+  typedef boost::function<void (const HttpRequest&,
+                                const Params&,
+                                HttpResponse*)> Handler;
+
+  HttpRouter();
+  ~HttpRouter();
+
+  /// Returns false if pattern is malformed or conflicts with an existing route.
+  bool add(HttpRequest::Method method, const string& pattern, const Handler& handler);
+
+  bool get(const string& pattern, const Handler& handler)
+  { return add(HttpRequest::kGet, pattern, handler); }
+
+  bool post(const string& pattern, const Handler& handler)
+  { return add(HttpRequest::kPost, pattern, handler); }
+
+  /// Looks up a handler for method and path.
+  /// Returns NULL if not found, sets *methodAllowed to false if path
+  /// matched but no handler was registered for method.  A static route
+  /// without method doesn't hide a parameter or catch-all one that has it.
+  const Handler* find(HttpRequest::Method method,
+                      StringPiece path,
+                      Params* params,
+                      bool* methodAllowed) const;
+
+  /// Dispatches req, replies 404 or 405 with an Allow header if no route matches.
+  /// Suitable for HttpServer::setHttpCallback().
+  void route(const HttpRequest& req, HttpResponse* resp) const;
+
+  size_t numRoutes() const { return numRoutes_; }
+
+ private:
+  static const int kNumMethods = HttpRequest::kDelete + 1;
+
+  enum NodeType { kStatic, kParam, kCatchAll };
+
+  struct Node
+  {
+    Node(NodeType t)
+      : type(t),
+        paramChild(-1),
+        catchAllChild(-1),
+        hasHandler(false)
+    {
+    }
+
+    NodeType type;
+    string prefix;            // for kStatic, or parameter name
+    string indices;           // first byte of each static child
+    std::vector<int> children;
+    int paramChild;
+    int catchAllChild;
+    bool hasHandler;
+    Handler handlers[kNumMethods];
+  };
+
+  int insertStatic(int node, const char* begin, const char* end);
+  int newNode(NodeType type);
+  bool match(int node, const char* begin, const char* end,
+             HttpRequest::Method method, Params* params,
+             int* result, int* fallback) const;
+
+  std::vector<Node> nodes_;
+  size_t numRoutes_;
+};
+
+}
+}
+
+#endif  // MUDUO_NET_HTTP_HTTPROUTER_H
@@ -14,8 +14,17 @@
 #include <muduo/net/http/HttpRequest.h>
 #include <muduo/net/http/HttpResponse.h>
 
+#ifdef HAVE_ZLIB
+#include <muduo/base/ThreadLocalSingleton.h>
+#include <muduo/net/http/HttpCompression.h>
+#include <muduo/net/ZlibStream.h>
+#endif
+
 #include <boost/bind.hpp>
 
+#include <ctype.h>
+#include <strings.h>
+
 using namespace muduo;
 using namespace muduo::net;
 
@@ -33,6 +42,100 @@ void defaultHttpCallback(const HttpRequest&, HttpResponse* resp)
   resp->setCloseConnection(true);
 }
 
+#ifdef HAVE_ZLIB
+// deflate states are kept per IO thread, and reused for every response.
+struct HttpCompressors : boost::noncopyable
+{
+  HttpCompressors()
+    : gzip(ZlibDeflater::kGzip),
+      deflate(ZlibDeflater::kZlib)
+  {
+  }
+
+  ZlibDeflater gzip;
+  ZlibDeflater deflate;
+  Buffer output;
+};
+
+// gzip is preferred over deflate.
+int chooseContentEncoding(const string& acceptEncoding)
+{
+  // -1 not listed, 0 refused, 1 acceptable
+  int gzip = -1;
+  int deflate = -1;
+  int any = -1;
+  const char* p = acceptEncoding.c_str();
+  while (*p)
+  {
+    const char* comma = strchr(p, ',');
+    const char* end = comma ? comma : p + strlen(p);
+    while (p < end && isspace(static_cast<unsigned char>(*p)))
+      ++p;
+    const char* semicolon = static_cast<const char*>(memchr(p, ';', end - p));
+    const char* nameEnd = semicolon ? semicolon : end;
+    while (nameEnd > p && isspace(static_cast<unsigned char>(nameEnd[-1])))
+      --nameEnd;
+    size_t len = nameEnd - p;
+
+    bool acceptable = true;
+    if (semicolon)
+    {
+      const char* q = strstr(semicolon, "q=");
+      if (q && q < end)
+      {
+        acceptable = strtod(q + 2, NULL) > 0;
+      }
+    }
+    if (len == 4 && strncasecmp(p, "gzip", len) == 0)
+      gzip = acceptable;
+    else if (len == 7 && strncasecmp(p, "deflate", len) == 0)
+      deflate = acceptable;
+    else if (len == 1 && *p == '*')
+      any = acceptable;
+
+    p = comma ? comma + 1 : end;
+  }
+  if (gzip < 0)
+    gzip = any;
+  if (deflate < 0)
+    deflate = any;
+  return gzip > 0 ? ZlibDeflater::kGzip : (deflate > 0 ? ZlibDeflater::kZlib : 0);
+}
+
+void compressResponse(const HttpRequest& req, size_t threshold, HttpResponse* resp)
+{
+  if (resp->body().size() < threshold || resp->hasHeader("Content-Encoding"))
+  {
+    return;
+  }
+
+  // the body depends on Accept-Encoding from here on, whether or not
+  // this request gets it compressed, so caches must key on it.
+  resp->addHeader("Vary", "Accept-Encoding");
+  int format = chooseContentEncoding(req.getHeader("Accept-Encoding"));
+  if (format == 0)
+  {
+    return;
+  }
+
+  HttpCompressors& compressors = ThreadLocalSingleton<HttpCompressors>::instance();
+  ZlibDeflater& deflater = format == ZlibDeflater::kGzip
+    ? compressors.gzip : compressors.deflate;
+  Buffer* output = &compressors.output;
+  output->retrieveAll();
+  if (deflater.compress(resp->body(), output)
+      && output->readableBytes() < resp->body().size())
+  {
+    resp->setBody(output->retrieveAllAsString());
+    resp->addHeader("Content-Encoding", format == ZlibDeflater::kGzip ? "gzip" : "deflate");
+  }
+  else
+  {
+    LOG_DEBUG << "skip compression, zlib error " << deflater.zlibErrorCode();
+  }
+}
+#endif
+
 }
 }
 }
@@ -42,7 +145,8 @@ HttpServer::HttpServer(EventLoop* loop,
                        const string& name,
                        TcpServer::Option option)
   : server_(loop, listenAddr, name, option),
-    httpCallback_(detail::defaultHttpCallback)
+    httpCallback_(detail::defaultHttpCallback),
+    compressionThreshold_(0)
 {
   server_.setConnectionCallback(
       boost::bind(&HttpServer::onConnection, this, _1));
@@ -58,6 +162,13 @@ void HttpServer::start()
 {
   LOG_WARN << "HttpServer[" << server_.name()
     << "] starts listenning on " << server_.ipPort();
+#ifndef HAVE_ZLIB
+  if (compressionThreshold_ > 0)
+  {
+    LOG_WARN << "HttpServer[" << server_.name()
+      << "] built without zlib, response compression is disabled";
+  }
+#endif
   server_.start();
 }
 
@@ -95,6 +206,12 @@ void HttpServer::onRequest(const TcpConnectionPtr& conn, const HttpRequest& req)
     (req.getVersion() == HttpRequest::kHttp10 && connection != "Keep-Alive");
   HttpResponse response(close);
   httpCallback_(req, &response);
+#ifdef HAVE_ZLIB
+  if (compressionThreshold_ > 0)
+  {
+    detail::compressResponse(req, compressionThreshold_, &response);
+  }
+#endif
   Buffer buf;
   response.appendToBuffer(&buf);
   conn->send(&buf);
@@ -47,6 +47,15 @@ class HttpServer : boost::noncopyable
     httpCallback_ = cb;
   }
 
+  /// Compresses response bodies of at least minBytes with gzip or deflate,
+  /// when the client sends a matching Accept-Encoding.
+  /// 0 disables compression, which is the default.
+  /// Not thread safe, call before start().
+  void setCompressionThreshold(size_t minBytes)
+  {
+    compressionThreshold_ = minBytes;
+  }
+
   void setThreadNum(int numThreads)
   {
     server_.setThreadNum(numThreads);
@@ -63,6 +72,7 @@ class HttpServer : boost::noncopyable
 
   TcpServer server_;
   HttpCallback httpCallback_;
+  size_t compressionThreshold_;
 };
 
 }
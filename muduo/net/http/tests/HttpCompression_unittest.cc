@@ -0,0 +1,118 @@
+#include <muduo/net/http/HttpCompression.h>
+#include <muduo/net/http/HttpRequest.h>
+#include <muduo/net/http/HttpResponse.h>
+#include <muduo/net/Buffer.h>
+#include <muduo/net/ZlibStream.h>
+
+//#define BOOST_TEST_MODULE HttpCompressionTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <zlib.h>
+
+using muduo::string;
+using muduo::net::Buffer;
+using muduo::net::HttpRequest;
+using muduo::net::HttpResponse;
+using muduo::net::ZlibDeflater;
+using muduo::net::detail::chooseContentEncoding;
+using muduo::net::detail::compressResponse;
+
+namespace
+{
+
+void setAcceptEncoding(HttpRequest* req, const string& value)
+{
+  string line = "Accept-Encoding: " + value;
+  req->addHeader(line.data(), line.data() + 15, line.data() + line.size());
+}
+
+string render(const HttpResponse& resp)
+{
+  Buffer buf;
+  resp.appendToBuffer(&buf);
+  return buf.retrieveAllAsString();
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(testChooseContentEncoding)
+{
+  BOOST_CHECK_EQUAL(chooseContentEncoding(""), 0);
+  BOOST_CHECK_EQUAL(chooseContentEncoding("identity"), 0);
+  BOOST_CHECK_EQUAL(chooseContentEncoding("gzip"), ZlibDeflater::kGzip);
+  BOOST_CHECK_EQUAL(chooseContentEncoding("deflate"), ZlibDeflater::kZlib);
+  BOOST_CHECK_EQUAL(chooseContentEncoding("deflate, gzip"), ZlibDeflater::kGzip);
+  BOOST_CHECK_EQUAL(chooseContentEncoding(" GZIP ;q=0.5 , br"), ZlibDeflater::kGzip);
+  BOOST_CHECK_EQUAL(chooseContentEncoding("gzip;q=0, deflate"), ZlibDeflater::kZlib);
+  BOOST_CHECK_EQUAL(chooseContentEncoding("gzip;q=0, deflate;q=0"), 0);
+  BOOST_CHECK_EQUAL(chooseContentEncoding("*"), ZlibDeflater::kGzip);
+  BOOST_CHECK_EQUAL(chooseContentEncoding("*;q=0"), 0);
+  BOOST_CHECK_EQUAL(chooseContentEncoding("*;q=0, deflate"), ZlibDeflater::kZlib);
+
+  // explicit codings win over the wildcard, in either order
+  BOOST_CHECK_EQUAL(chooseContentEncoding("gzip;q=0, *"), ZlibDeflater::kZlib);
+  BOOST_CHECK_EQUAL(chooseContentEncoding("*, gzip;q=0"), ZlibDeflater::kZlib);
+  BOOST_CHECK_EQUAL(chooseContentEncoding("*, gzip;q=0, deflate;q=0"), 0);
+  BOOST_CHECK_EQUAL(chooseContentEncoding("\xa0\xff, gzip\xa0"), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testCompressResponse)
+{
+  string body;
+  for (int i = 0; i < 1000; ++i)
+  {
+    body += "muduo is a multithreaded C++ network library. ";
+  }
+
+  HttpRequest req;
+  setAcceptEncoding(&req, "deflate");
+
+  HttpResponse small(false);
+  small.setBody("tiny");
+  compressResponse(req, 1024, &small);
+  BOOST_CHECK(!small.hasHeader("Content-Encoding"));
+  BOOST_CHECK_EQUAL(small.body(), "tiny");
+
+  HttpResponse resp(false);
+  resp.setBody(body);
+  compressResponse(req, 1024, &resp);
+  BOOST_CHECK(resp.hasHeader("Content-Encoding"));
+  BOOST_CHECK(resp.hasHeader("Vary"));
+  BOOST_CHECK(resp.body().size() < body.size());
+  BOOST_CHECK(render(resp).find("\r\nContent-Encoding: deflate\r\n") != string::npos);
+
+  string inflated(body.size(), '\0');
+  uLongf len = static_cast<uLongf>(inflated.size());
+  BOOST_CHECK_EQUAL(uncompress(reinterpret_cast<Bytef*>(&*inflated.begin()), &len,
+                               reinterpret_cast<const Bytef*>(resp.body().data()),
+                               static_cast<uLong>(resp.body().size())), Z_OK);
+  BOOST_CHECK_EQUAL(len, body.size());
+  BOOST_CHECK(inflated == body);
+
+  // already encoded, left alone
+  string encoded = resp.body();
+  compressResponse(req, 1024, &resp);
+  BOOST_CHECK(resp.body() == encoded);
+
+  HttpRequest gzipReq;
+  setAcceptEncoding(&gzipReq, "deflate;q=0, *");
+  HttpResponse gzipped(false);
+  gzipped.setBody(body);
+  compressResponse(gzipReq, 1024, &gzipped);
+  BOOST_CHECK(render(gzipped).find("\r\nContent-Encoding: gzip\r\n") != string::npos);
+  BOOST_CHECK(gzipped.body().size() > 2
+              && static_cast<unsigned char>(gzipped.body()[0]) == 0x1f
+              && static_cast<unsigned char>(gzipped.body()[1]) == 0x8b);
+
+  HttpRequest refused;
+  setAcceptEncoding(&refused, "gzip;q=0, deflate;q=0");
+  HttpResponse plain(false);
+  plain.setBody(body);
+  compressResponse(refused, 1024, &plain);
+  BOOST_CHECK(!plain.hasHeader("Content-Encoding"));
+  BOOST_CHECK(plain.hasHeader("Vary"));
+  BOOST_CHECK(plain.body() == body);
+  BOOST_CHECK(!small.hasHeader("Vary"));
+}
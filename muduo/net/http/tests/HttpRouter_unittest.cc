@@ -0,0 +1,157 @@
+#include <muduo/net/http/HttpRouter.h>
+#include <muduo/net/http/HttpResponse.h>
+#include <muduo/net/Buffer.h>
+
+//#define BOOST_TEST_MODULE HttpRouterTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using muduo::string;
+using muduo::StringPiece;
+using muduo::net::HttpRequest;
+using muduo::net::HttpResponse;
+using muduo::net::HttpRouter;
+
+namespace
+{
+
+void noop(const HttpRequest&, const HttpRouter::Params&, HttpResponse*)
+{
+}
+
+const HttpRouter::Handler* lookup(const HttpRouter& router,
+                                  HttpRequest::Method method,
+                                  const char* path,
+                                  HttpRouter::Params* params)
+{
+  bool methodAllowed = true;
+  return router.find(method, path, params, &methodAllowed);
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(testStaticRoutes)
+{
+  HttpRouter router;
+  BOOST_CHECK(router.get("/", noop));
+  BOOST_CHECK(router.get("/users", noop));
+  BOOST_CHECK(router.get("/user", noop));
+  BOOST_CHECK(router.get("/uploads", noop));
+  BOOST_CHECK(!router.get("/users", noop));
+  BOOST_CHECK_EQUAL(router.numRoutes(), 4u);
+
+  HttpRouter::Params params;
+  BOOST_CHECK(lookup(router, HttpRequest::kGet, "/", &params));
+  BOOST_CHECK(lookup(router, HttpRequest::kGet, "/users", &params));
+  BOOST_CHECK(lookup(router, HttpRequest::kGet, "/user", &params));
+  BOOST_CHECK(lookup(router, HttpRequest::kGet, "/uploads", &params));
+  BOOST_CHECK(!lookup(router, HttpRequest::kGet, "/use", &params));
+  BOOST_CHECK(!lookup(router, HttpRequest::kGet, "/usersx", &params));
+  BOOST_CHECK_EQUAL(params.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testParams)
+{
+  HttpRouter router;
+  BOOST_CHECK(router.get("/users/:id", noop));
+  BOOST_CHECK(router.get("/users/:id/posts/:post", noop));
+  BOOST_CHECK(router.get("/users/new", noop));
+  BOOST_CHECK(router.get("/static/*filepath", noop));
+  BOOST_CHECK(!router.get("/users/:name", noop));
+  BOOST_CHECK(!router.get("/files/*path/more", noop));
+
+  HttpRouter::Params params;
+  BOOST_CHECK(lookup(router, HttpRequest::kGet, "/users/42", &params));
+  BOOST_CHECK_EQUAL(params.size(), 1);
+  BOOST_CHECK(params.get("id") == StringPiece("42"));
+
+  BOOST_CHECK(lookup(router, HttpRequest::kGet, "/users/new", &params));
+  BOOST_CHECK_EQUAL(params.size(), 0);
+
+  // falls back to parameter when static branch does not match all the way
+  BOOST_CHECK(lookup(router, HttpRequest::kGet, "/users/newbie", &params));
+  BOOST_CHECK(params.get("id") == StringPiece("newbie"));
+
+  BOOST_CHECK(lookup(router, HttpRequest::kGet, "/users/7/posts/hello", &params));
+  BOOST_CHECK_EQUAL(params.size(), 2);
+  BOOST_CHECK(params.get("id") == StringPiece("7"));
+  BOOST_CHECK(params.get("post") == StringPiece("hello"));
+
+  BOOST_CHECK(lookup(router, HttpRequest::kGet, "/static/css/site.css", &params));
+  BOOST_CHECK(params.get("filepath") == StringPiece("css/site.css"));
+
+  BOOST_CHECK(!lookup(router, HttpRequest::kGet, "/users/", &params));
+  BOOST_CHECK(!lookup(router, HttpRequest::kGet, "/users/7/posts", &params));
+}
+
+BOOST_AUTO_TEST_CASE(testMethods)
+{
+  HttpRouter router;
+  BOOST_CHECK(router.get("/items/:id", noop));
+  BOOST_CHECK(router.add(HttpRequest::kDelete, "/items/:id", noop));
+
+  HttpRouter::Params params;
+  bool methodAllowed = false;
+  BOOST_CHECK(router.find(HttpRequest::kDelete, "/items/1", &params, &methodAllowed));
+  BOOST_CHECK(methodAllowed);
+  BOOST_CHECK(!router.find(HttpRequest::kPost, "/items/1", &params, &methodAllowed));
+  BOOST_CHECK(!methodAllowed);
+  BOOST_CHECK(!router.find(HttpRequest::kPost, "/nothing", &params, &methodAllowed));
+  BOOST_CHECK(methodAllowed);
+
+  HttpRequest req;
+  req.setMethod("POST", "POST" + 4);
+  string path("/items/1");
+  req.setPath(path.data(), path.data() + path.size());
+  HttpResponse resp(false);
+  router.route(req, &resp);
+  BOOST_CHECK(!resp.closeConnection());
+
+  muduo::net::Buffer buf;
+  resp.appendToBuffer(&buf);
+  string response = buf.retrieveAllAsString();
+  BOOST_CHECK(response.find("HTTP/1.1 405 Method Not Allowed\r\n") == 0);
+  BOOST_CHECK(response.find("\r\nAllow: GET, DELETE\r\n") != string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(testMethodBacktracking)
+{
+  HttpRouter router;
+  BOOST_CHECK(router.get("/users/new", noop));
+  BOOST_CHECK(router.add(HttpRequest::kDelete, "/users/:id", noop));
+  BOOST_CHECK(router.get("/static/logo", noop));
+  BOOST_CHECK(router.post("/static/*file", noop));
+
+  HttpRouter::Params params;
+  bool methodAllowed = false;
+  BOOST_CHECK(router.find(HttpRequest::kDelete, "/users/new", &params, &methodAllowed));
+  BOOST_CHECK(methodAllowed);
+  BOOST_CHECK(params.get("id") == StringPiece("new"));
+
+  BOOST_CHECK(router.find(HttpRequest::kGet, "/users/new", &params, &methodAllowed));
+  BOOST_CHECK_EQUAL(params.size(), 0);
+
+  BOOST_CHECK(!router.find(HttpRequest::kGet, "/users/7", &params, &methodAllowed));
+  BOOST_CHECK(!methodAllowed);
+  BOOST_CHECK(!router.find(HttpRequest::kPut, "/users/new", &params, &methodAllowed));
+  BOOST_CHECK(!methodAllowed);
+
+  BOOST_CHECK(router.find(HttpRequest::kPost, "/static/logo", &params, &methodAllowed));
+  BOOST_CHECK(params.get("file") == StringPiece("logo"));
+  BOOST_CHECK(!router.find(HttpRequest::kDelete, "/static/logo", &params, &methodAllowed));
+  BOOST_CHECK(!methodAllowed);
+
+  HttpRequest req;
+  req.setMethod("PUT", "PUT" + 3);
+  string path("/users/new");
+  req.setPath(path.data(), path.data() + path.size());
+  HttpResponse resp(false);
+  router.route(req, &resp);
+
+  muduo::net::Buffer buf;
+  resp.appendToBuffer(&buf);
+  string response = buf.retrieveAllAsString();
+  BOOST_CHECK(response.find("HTTP/1.1 405 Method Not Allowed\r\n") == 0);
+  BOOST_CHECK(response.find("\r\nAllow: GET, DELETE\r\n") != string::npos);
+}
@@ -19,6 +19,9 @@ project "net"
         'TcpConnection.h',
         'TcpServer.h',
         'TimerId.h',
+        'UdpClient.h',
+        'UdpServer.h',
+        'UdpSocket.h',
     }
 
     files {
@@ -41,5 +44,8 @@ project "net"
         'TcpServer.cc',
         'Timer.cc',
         'TimerQueue.cc',
+        'UdpClient.cc',
+        'UdpServer.cc',
+        'UdpSocket.cc',
      }
 
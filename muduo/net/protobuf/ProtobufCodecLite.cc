@@ -9,12 +9,18 @@
 #include <muduo/net/protobuf/ProtobufCodecLite.h>
 // #include <muduo/net/protobuf/BufferStream.h>
 
+#include <muduo/base/Crc32c.h>
 #include <muduo/base/Logging.h>
+#include <muduo/base/ThreadLocalSingleton.h>
 #include <muduo/net/Endian.h>
+#include <muduo/net/EventLoop.h>
 #include <muduo/net/TcpConnection.h>
 #include <muduo/net/protorpc/google-inl.h>
 
 #include <google/protobuf/message.h>
+#if GOOGLE_PROTOBUF_VERSION >= 3000000
+#include <google/protobuf/arena.h>
+#endif
 #include <zlib.h>
 
 using namespace muduo;
@@ -28,31 +34,113 @@ namespace
     return 0;
   }
   int __attribute__ ((unused)) dummy = ProtobufVersionCheck();
+
+#if GOOGLE_PROTOBUF_VERSION >= 3000000
+  // One arena per IO thread, its first block is reused across Reset().
+  struct ThreadArena : boost::noncopyable
+  {
+    static const size_t kInitialBlockSize = 64*1024;
+
+    static google::protobuf::ArenaOptions options(char* block)
+    {
+      google::protobuf::ArenaOptions opt;
+      opt.initial_block = block;
+      opt.initial_block_size = kInitialBlockSize;
+      return opt;
+    }
+
+    ThreadArena()
+      : arena(options(block)),
+        depth(0)
+    {
+    }
+
+    char block[kInitialBlockSize];
+    google::protobuf::Arena arena;
+    int depth;  // callbacks may parse on the same thread
+  };
+
+  void noDelete(google::protobuf::Message*)
+  {
+  }
+#endif
+}
+
+void ProtobufCodecLite::setUseArena(bool on)
+{
+#if GOOGLE_PROTOBUF_VERSION >= 3000000
+  useArena_ = on;
+#else
+  LOG_WARN << "ProtobufCodecLite::setUseArena - needs protobuf 3, ignored";
+#endif
+}
+
+google::protobuf::Arena* ProtobufCodecLite::callbackArena() const
+{
+#if GOOGLE_PROTOBUF_VERSION >= 3000000
+  if (useArena_)
+  {
+    ThreadArena* arena = ThreadLocalSingleton<ThreadArena>::pointer();
+    if (arena && arena->depth > 0)
+    {
+      return &arena->arena;
+    }
+  }
+#endif
+  return NULL;
 }
 
 void ProtobufCodecLite::send(const TcpConnectionPtr& conn,
                              const ::google::protobuf::Message& message)
 {
-  // FIXME: serialize to TcpConnection::outputBuffer()
-  muduo::net::Buffer buf;
-  fillEmptyBuffer(&buf, message);
-  conn->send(&buf);
+  if (conn->getLoop()->isInLoopThread())
+  {
+    // serialize straight into the connection's output buffer
+    if (conn->connected())
+    {
+      Buffer* output = conn->outputBuffer();
+      size_t oldLen = output->readableBytes();
+      appendToBuffer(output, message);
+      conn->sendOutputBuffer(oldLen);
+    }
+  }
+  else
+  {
+    muduo::net::Buffer buf;
+    fillEmptyBuffer(&buf, message);
+    conn->send(&buf);
+  }
 }
 
 void ProtobufCodecLite::fillEmptyBuffer(muduo::net::Buffer* buf,
                                         const google::protobuf::Message& message)
 {
   assert(buf->readableBytes() == 0);
+  appendToBuffer(buf, message);
+}
+
+void ProtobufCodecLite::appendToBuffer(muduo::net::Buffer* buf,
+                                       const google::protobuf::Message& message)
+{
   // FIXME: can we move serialization & checksum to other thread?
+  // every append may reallocate, so the frame is found by its offset.
+  const size_t offset = buf->readableBytes();
+  buf->appendInt32(0);  // length, filled in below
   buf->append(tag_);
 
   int byte_size = serializeToBuffer(message, buf);
 
-  int32_t checkSum = checksum(buf->peek(), static_cast<int>(buf->readableBytes()));
+  const int len = static_cast<int>(tag_.size()) + byte_size + kChecksumLen;
+  int32_t checkSum = checksum(checksumType_,
+                              buf->peek() + offset + kHeaderLen,
+                              len - kChecksumLen);
   buf->appendInt32(checkSum);
-  assert(buf->readableBytes() == tag_.size() + byte_size + kChecksumLen); (void) byte_size;
-  int32_t len = sockets::hostToNetwork32(static_cast<int32_t>(buf->readableBytes()));
-  buf->prepend(&len, sizeof len);
+  assert(buf->readableBytes() == offset + kHeaderLen + len);
+
+  uint32_t header = static_cast<uint32_t>(checksumType_) << kChecksumTypeShift
+                  | static_cast<uint32_t>(len);
+  int32_t be32 = sockets::hostToNetwork32(static_cast<int32_t>(header));
+  ::memcpy(const_cast<char*>(buf->peek()) + offset, &be32, sizeof be32);
 }
 
 void ProtobufCodecLite::onMessage(const TcpConnectionPtr& conn,
@@ -61,12 +149,19 @@ void ProtobufCodecLite::onMessage(const TcpConnectionPtr& conn,
 {
   while (buf->readableBytes() >= static_cast<uint32_t>(kMinMessageLen+kHeaderLen))
   {
-    const int32_t len = buf->peekInt32();
+    const uint32_t header = static_cast<uint32_t>(buf->peekInt32());
+    const int32_t len = static_cast<int32_t>(header & kLengthMask);
+    const uint32_t type = header >> kChecksumTypeShift;
     if (len > kMaxMessageLen || len < kMinMessageLen)
     {
       errorCallback_(conn, buf, receiveTime, kInvalidLength);
       break;
     }
+    else if (type > kNoChecksum)
+    {
+      errorCallback_(conn, buf, receiveTime, kCheckSumError);
+      break;
+    }
     else if (buf->readableBytes() >= implicit_cast<size_t>(kHeaderLen+len))
     {
       if (rawCb_ && !rawCb_(conn, StringPiece(buf->peek(), kHeaderLen+len), receiveTime))
@@ -74,16 +169,49 @@ void ProtobufCodecLite::onMessage(const TcpConnectionPtr& conn,
         buf->retrieve(kHeaderLen+len);
         continue;
       }
+#if GOOGLE_PROTOBUF_VERSION >= 3000000
+      ThreadArena* arena = NULL;
+      MessagePtr message;
+      if (useArena_)
+      {
+        arena = &ThreadLocalSingleton<ThreadArena>::instance();
+        ++arena->depth;
+        message.reset(prototype_->New(&arena->arena), noDelete);
+      }
+      else
+      {
+        message.reset(prototype_->New());
+      }
+#else
       MessagePtr message(prototype_->New());
+#endif
       // FIXME: can we move deserialization & callback to other thread?
-      ErrorCode errorCode = parse(buf->peek()+kHeaderLen, len, message.get());
+      ErrorCode errorCode = parse(static_cast<ChecksumType>(type),
+                                  buf->peek()+kHeaderLen, len, message.get());
       if (errorCode == kNoError)
       {
+        if (followPeerChecksum_)
+        {
+          // latched once, before the first message is handed to any
+          // thread that may send replies, so send() never races with it.
+          checksumType_ = static_cast<ChecksumType>(type);
+          followPeerChecksum_ = false;
+        }
         // FIXME: try { } catch (...) { }
         messageCallback_(conn, message, receiveTime);
         buf->retrieve(kHeaderLen+len);
       }
-      else
+#if GOOGLE_PROTOBUF_VERSION >= 3000000
+      if (arena)
+      {
+        message.reset();
+        if (--arena->depth == 0)
+        {
+          arena->arena.Reset();
+        }
+      }
+#endif
+      if (errorCode != kNoError)
       {
         errorCallback_(conn, buf, receiveTime, errorCode);
         break;
@@ -181,21 +309,51 @@ int32_t ProtobufCodecLite::checksum(const void* buf, int len)
       ::adler32(1, static_cast<const Bytef*>(buf), len));
 }
 
+int32_t ProtobufCodecLite::checksum(ChecksumType type, const void* buf, int len)
+{
+  switch (type)
+  {
+   case kCrc32c:
+     return static_cast<int32_t>(crc32c::value(buf, len));
+   case kNoChecksum:
+     return 0;
+   default:
+     return checksum(buf, len);
+  }
+}
+
 bool ProtobufCodecLite::validateChecksum(const char* buf, int len)
 {
+  return validateChecksum(kAdler32, buf, len);
+}
+
+bool ProtobufCodecLite::validateChecksum(ChecksumType type, const char* buf, int len)
+{
+  if (type == kNoChecksum)
+  {
+    return true;
+  }
   // check sum
   int32_t expectedCheckSum = asInt32(buf + len - kChecksumLen);
-  int32_t checkSum = checksum(buf, len - kChecksumLen);
+  int32_t checkSum = checksum(type, buf, len - kChecksumLen);
   return checkSum == expectedCheckSum;
 }
 
 ProtobufCodecLite::ErrorCode ProtobufCodecLite::parse(const char* buf,
                                                       int len,
                                                       ::google::protobuf::Message* message)
+{
+  return parse(kAdler32, buf, len, message);
+}
+
+ProtobufCodecLite::ErrorCode ProtobufCodecLite::parse(ChecksumType type,
+                                                      const char* buf,
+                                                      int len,
+                                                      ::google::protobuf::Message* message)
 {
   ErrorCode error = kNoError;
 
-  if (validateChecksum(buf, len))
+  if (validateChecksum(type, buf, len))
   {
     if (memcmp(buf, tag_.data(), tag_.size()) == 0)
     {
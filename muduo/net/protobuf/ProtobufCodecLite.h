@@ -34,6 +34,7 @@ namespace google
 {
 namespace protobuf
 {
+class Arena;
 class Message;
 }
 }
@@ -65,6 +66,17 @@ class ProtobufCodecLite : boost::noncopyable
   const static int kChecksumLen = sizeof(int32_t);
   const static int kMaxMessageLen = 64*1024*1024; // same as codec_stream.h kDefaultTotalBytesLimit
 
+  // The top 4 bits of the length field carry the checksum type,
+  // kAdler32 (0) frames are identical to the original wire format.
+  enum ChecksumType
+  {
+    kAdler32 = 0,
+    kCrc32c = 1,
+    kNoChecksum = 2,  // for trusted links, eg. loopback
+  };
+  const static int kChecksumTypeShift = 28;
+  const static uint32_t kLengthMask = (1u << kChecksumTypeShift) - 1;
+
   enum ErrorCode
   {
     kNoError = 0,
@@ -99,7 +111,10 @@ class ProtobufCodecLite : boost::noncopyable
       messageCallback_(messageCb),
       rawCb_(rawCb),
       errorCallback_(errorCb),
-      kMinMessageLen(tagArg.size() + kChecksumLen)
+      kMinMessageLen(tagArg.size() + kChecksumLen),
+      useArena_(false),
+      checksumType_(kAdler32),
+      followPeerChecksum_(false)
   {
   }
 
@@ -107,6 +122,30 @@ class ProtobufCodecLite : boost::noncopyable
 
   const string& tag() const { return tag_; }
 
+  /// Parses incoming messages into a per-thread google::protobuf::Arena,
+  /// which is reset after the message callback returns, so a message with
+  /// many fields costs no malloc/free per field.
+  /// The MessagePtr passed to the callback must not be kept after it returns.
+  /// Requires protobuf 3.0 or later. Not thread safe, set before receiving.
+  void setUseArena(bool on);
+  bool useArena() const { return useArena_; }
+
+  /// The arena the message being handed to the callback lives in, NULL
+  /// if arenas are off or no callback is running in this thread.
+  /// Messages created in it are gone once the callback returns.
+  ::google::protobuf::Arena* callbackArena() const;
+
+  /// Checksum type of outgoing frames, kAdler32 by default.
+  /// Incoming frames of every type are accepted, but peers built before
+  /// checksum types existed only understand kAdler32.
+  void setChecksumType(ChecksumType type) { checksumType_ = type; }
+  ChecksumType checksumType() const { return checksumType_; }
+
+  /// Sends with the checksum type of the first frame received,
+  /// so a server answers each client in its own format.
+  /// Only for a codec per connection.
+  void setFollowPeerChecksum(bool on) { followPeerChecksum_ = on; }
+
   void send(const TcpConnectionPtr& conn,
             const ::google::protobuf::Message& message);
 
@@ -121,10 +160,15 @@ class ProtobufCodecLite : boost::noncopyable
 
   // public for unit tests
   ErrorCode parse(const char* buf, int len, ::google::protobuf::Message* message);
+  ErrorCode parse(ChecksumType type, const char* buf, int len, ::google::protobuf::Message* message);
   void fillEmptyBuffer(muduo::net::Buffer* buf, const google::protobuf::Message& message);
+  // appends one frame after what's readable in buf, serializing in place.
+  void appendToBuffer(muduo::net::Buffer* buf, const google::protobuf::Message& message);
 
   static int32_t checksum(const void* buf, int len);
+  static int32_t checksum(ChecksumType type, const void* buf, int len);
   static bool validateChecksum(const char* buf, int len);
+  static bool validateChecksum(ChecksumType type, const char* buf, int len);
   static int32_t asInt32(const char* buf);
   static void defaultErrorCallback(const TcpConnectionPtr&,
                                    Buffer*,
@@ -138,6 +182,9 @@ class ProtobufCodecLite : boost::noncopyable
   RawMessageCallback rawCb_;
   ErrorCallback errorCallback_;
   const int kMinMessageLen;
+  bool useArena_;
+  ChecksumType checksumType_;
+  bool followPeerChecksum_;
 };
 
 template<typename MSG, const char* TAG, typename CODEC=ProtobufCodecLite>  // TAG must be a variable with external linkage, not a string literal
@@ -168,6 +215,13 @@ class ProtobufCodecLiteT
 
   const string& tag() const { return codec_.tag(); }
 
+  void setUseArena(bool on) { codec_.setUseArena(on); }
+  bool useArena() const { return codec_.useArena(); }
+  ::google::protobuf::Arena* callbackArena() const { return codec_.callbackArena(); }
+
+  void setChecksumType(ProtobufCodecLite::ChecksumType type) { codec_.setChecksumType(type); }
+  void setFollowPeerChecksum(bool on) { codec_.setFollowPeerChecksum(on); }
+
   void send(const TcpConnectionPtr& conn,
             const MSG& message)
   {
@@ -194,6 +248,11 @@ class ProtobufCodecLiteT
     codec_.fillEmptyBuffer(buf, message);
   }
 
+  void appendToBuffer(muduo::net::Buffer* buf, const MSG& message)
+  {
+    codec_.appendToBuffer(buf, message);
+  }
+
  private:
   ProtobufMessageCallback messageCallback_;
   CODEC codec_;
@@ -9,6 +9,12 @@
 #include <muduo/net/protorpc/RpcChannel.h>
 
 #include <muduo/base/Logging.h>
+#include <muduo/base/WeakCallback.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/base/ThreadPool.h>
+#include <muduo/net/TcpConnection.h>
+#include <muduo/net/protorpc/RpcController.h>
+#include <muduo/net/protorpc/RpcExecutor.h>
 #include <muduo/net/protorpc/rpc.pb.h>
 
 #include <google/protobuf/descriptor.h>
@@ -19,8 +25,41 @@
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+
+void failCall(google::protobuf::RpcController* controller, ErrorCode error)
+{
+  if (controller)
+  {
+    RpcController* rpcController = dynamic_cast<RpcController*>(controller);
+    if (rpcController)
+    {
+      rpcController->setErrorCode(error);
+    }
+    controller->SetFailed(ErrorCode_Name(error));
+  }
+}
+
+google::protobuf::Message* newMessage(const google::protobuf::Message& prototype,
+                                      google::protobuf::Arena* arena)
+{
+#if GOOGLE_PROTOBUF_VERSION >= 3000000
+  return prototype.New(arena);
+#else
+  assert(arena == NULL);
+  return prototype.New();
+#endif
+}
+
+}
+
 RpcChannel::RpcChannel()
   : codec_(boost::bind(&RpcChannel::onRpcMessage, this, _1, _2, _3)),
+    sequence_(0),
+    callTimeout_(0),
+    expireTimerArmed_(false),
+    flushQueued_(false),
     services_(NULL)
 {
   LOG_INFO << "RpcChannel::ctor - " << this;
@@ -29,6 +68,10 @@ RpcChannel::RpcChannel()
 RpcChannel::RpcChannel(const TcpConnectionPtr& conn)
   : codec_(boost::bind(&RpcChannel::onRpcMessage, this, _1, _2, _3)),
     conn_(conn),
+    sequence_(0),
+    callTimeout_(0),
+    expireTimerArmed_(false),
+    flushQueued_(false),
     services_(NULL)
 {
   LOG_INFO << "RpcChannel::ctor - " << this;
@@ -37,11 +80,13 @@ RpcChannel::RpcChannel(const TcpConnectionPtr& conn)
 RpcChannel::~RpcChannel()
 {
   LOG_INFO << "RpcChannel::dtor - " << this;
-  for (std::map<int64_t, OutstandingCall>::iterator it = outstandings_.begin(); it != outstandings_.end(); ++it)
+  for (std::vector<OutstandingCall>::iterator it = outstandings_.begin(); it != outstandings_.end(); ++it)
   {
-    OutstandingCall out = it->second;
-    delete out.response;
-    delete out.done;
+    if (it->id != 0)
+    {
+      delete it->response;
+      delete it->done;
+    }
   }
 }
 
@@ -56,20 +101,152 @@ void RpcChannel::CallMethod(const ::google::protobuf::MethodDescriptor* method,
                             ::google::protobuf::Message* response,
                             ::google::protobuf::Closure* done)
 {
+  // serialize in caller's thread, the rest happens in conn_'s loop.
+  std::string requestBytes = request->SerializeAsString(); // FIXME: error check
+  EventLoop* loop = conn_->getLoop();
+  if (loop->isInLoopThread())
+  {
+    callMethodInLoop(method, controller, requestBytes, response, done);
+  }
+  else
+  {
+    loop->runInLoop(
+        boost::bind(&RpcChannel::callMethodInLoop, shared_from_this(),
+                    method, controller, requestBytes, response, done));
+  }
+}
+
+void RpcChannel::callMethodInLoop(const ::google::protobuf::MethodDescriptor* method,
+                                  ::google::protobuf::RpcController* controller,
+                                  const std::string& request,
+                                  ::google::protobuf::Message* response,
+                                  ::google::protobuf::Closure* done)
+{
+  EventLoop* loop = conn_->getLoop();
+  loop->assertInLoopThread();
+
+  uint32_t slot = 0;
+  if (freeSlots_.empty())
+  {
+    slot = static_cast<uint32_t>(outstandings_.size());
+    outstandings_.push_back(OutstandingCall());
+  }
+  else
+  {
+    slot = freeSlots_.back();
+    freeSlots_.pop_back();
+  }
+  if (++sequence_ == 0)
+  {
+    ++sequence_;  // id 0 marks a free slot
+  }
+  int64_t id = static_cast<int64_t>(static_cast<uint64_t>(sequence_) << kSlotBits | slot);
+  OutstandingCall out = { id, controller, response, done };
+  outstandings_[slot] = out;
+
+  if (callTimeout_ > 0)
+  {
+    addDeadline(addTime(loop->pollReturnTime(), callTimeout_), id);
+  }
+
   RpcMessage message;
   message.set_type(REQUEST);
-  int64_t id = id_.incrementAndGet();
   message.set_id(id);
   message.set_service(method->service()->full_name());
   message.set_method(method->name());
-  message.set_request(request->SerializeAsString()); // FIXME: error check
+  message.set_request(request);
+  sendMessage(message);
+}
 
-  OutstandingCall out = { response, done };
+void RpcChannel::sendMessage(const RpcMessage& message)
+{
+  EventLoop* loop = conn_->getLoop();
+  if (loop->isInLoopThread())
   {
-  MutexLockGuard lock(mutex_);
-  outstandings_[id] = out;
+    codec_.appendToBuffer(&pendingOutput_, message);
+    if (!flushQueued_)
+    {
+      // runs after the current batch of events or functors
+      flushQueued_ = true;
+      loop->queueInLoop(boost::bind(&RpcChannel::flushPendingOutput, shared_from_this()));
+    }
+  }
+  else
+  {
+    codec_.send(conn_, message);
+  }
+}
+
+void RpcChannel::flushPendingOutput()
+{
+  flushQueued_ = false;
+  if (pendingOutput_.readableBytes() > 0)
+  {
+    conn_->send(&pendingOutput_);
+  }
+}
+
+void RpcChannel::addDeadline(Timestamp deadline, int64_t id)
+{
+  while (!deadlines_.empty() && !isOutstanding(deadlines_.front().second))
+  {
+    deadlines_.pop_front();
+  }
+  // a slow call at the front holds back the ones answered after it,
+  // compact them when they outnumber the outstanding calls.
+  const size_t outstanding = outstandings_.size() - freeSlots_.size();
+  if (deadlines_.size() > 2 * outstanding + 16)
+  {
+    std::deque<std::pair<Timestamp, int64_t> >::iterator last = deadlines_.begin();
+    for (std::deque<std::pair<Timestamp, int64_t> >::iterator it = deadlines_.begin();
+         it != deadlines_.end(); ++it)
+    {
+      if (isOutstanding(it->second))
+      {
+        *last++ = *it;
+      }
+    }
+    deadlines_.erase(last, deadlines_.end());
+  }
+
+  deadlines_.push_back(std::make_pair(deadline, id));
+  if (!expireTimerArmed_)
+  {
+    conn_->getLoop()->runAt(deadline,
+                            makeWeakCallback(shared_from_this(), &RpcChannel::expireCalls));
+    expireTimerArmed_ = true;
+  }
+}
+
+void RpcChannel::expireCalls()
+{
+  expireTimerArmed_ = false;
+  Timestamp now = Timestamp::now();
+  while (!deadlines_.empty() && !(now < deadlines_.front().first))
+  {
+    int64_t id = deadlines_.front().second;
+    deadlines_.pop_front();
+    if (isOutstanding(id))
+    {
+      uint32_t slot = static_cast<uint32_t>(id);
+      OutstandingCall out = outstandings_[slot];
+      outstandings_[slot].id = 0;
+      freeSlots_.push_back(slot);
+      LOG_WARN << "RpcChannel::expireCalls - call " << id << " timed out";
+      boost::scoped_ptr<google::protobuf::Message> d(out.response);
+      failCall(out.controller, TIMEOUT);
+      if (out.done)
+      {
+        out.done->Run();
+      }
+    }
+  }
+  if (!deadlines_.empty())
+  {
+    conn_->getLoop()->runAt(deadlines_.front().first,
+                            makeWeakCallback(shared_from_this(), &RpcChannel::expireCalls));
+    expireTimerArmed_ = true;
   }
-  codec_.send(conn_, message);
 }
 
 void RpcChannel::onMessage(const TcpConnectionPtr& conn,
@@ -91,16 +268,13 @@ void RpcChannel::onRpcMessage(const TcpConnectionPtr& conn,
     int64_t id = message.id();
     assert(message.has_response() || message.has_error());
 
-    OutstandingCall out = { NULL, NULL };
-
+    OutstandingCall out = { 0, NULL, NULL, NULL };
+    uint32_t slot = static_cast<uint32_t>(id);
+    if (slot < outstandings_.size() && outstandings_[slot].id == id)
     {
-      MutexLockGuard lock(mutex_);
-      std::map<int64_t, OutstandingCall>::iterator it = outstandings_.find(id);
-      if (it != outstandings_.end())
-      {
-        out = it->second;
-        outstandings_.erase(it);
-      }
+      out = outstandings_[slot];
+      outstandings_[slot].id = 0;
+      freeSlots_.push_back(slot);
     }
 
     if (out.response)
@@ -110,6 +284,10 @@ void RpcChannel::onRpcMessage(const TcpConnectionPtr& conn,
       {
         out.response->ParseFromString(message.response());
       }
+      else
+      {
+        failCall(out.controller, message.error());
+      }
       if (out.done)
       {
         out.done->Run();
@@ -132,19 +310,51 @@ void RpcChannel::onRpcMessage(const TcpConnectionPtr& conn,
           = desc->FindMethodByName(message.method());
         if (method)
         {
-          boost::scoped_ptr<google::protobuf::Message> request(service->GetRequestPrototype(method).New());
-          if (request->ParseFromString(message.request()))
+          RpcExecutor* executor = executorSelector_ ? executorSelector_(method) : NULL;
+          if (executor == NULL)
           {
-            google::protobuf::Message* response = service->GetResponsePrototype(method).New();
-            // response is deleted in doneCallback
-            int64_t id = message.id();
-            service->CallMethod(method, NULL, get_pointer(request), response,
-                                NewCallback(this, &RpcChannel::doneCallback, response, id));
-            error = NO_ERROR;
+            // the request dies when CallMethod() returns, like messagePtr
+            google::protobuf::Arena* arena = codec_.callbackArena();
+            google::protobuf::Message* request = newMessage(service->GetRequestPrototype(method), arena);
+            boost::scoped_ptr<google::protobuf::Message> d(arena ? NULL : request);
+            if (request->ParseFromString(message.request()))
+            {
+              google::protobuf::Message* response = service->GetResponsePrototype(method).New();
+              // response is deleted in doneCallback
+              int64_t id = message.id();
+              service->CallMethod(method, NULL, request, response,
+                                  NewCallback(this, &RpcChannel::doneCallback, response, id));
+              error = NO_ERROR;
+            }
+            else
+            {
+              error = INVALID_REQUEST;
+            }
+          }
+          else if (!executor->tryAcquire())
+          {
+            error = OVERLOADED;
           }
           else
           {
-            error = INVALID_REQUEST;
+            if (executor->pool())
+            {
+              // request is parsed in the pool too
+              RpcMessagePtr pooled(messagePtr);
+              if (codec_.useArena())
+              {
+                // arena messages are gone once this callback returns
+                pooled.reset(new RpcMessage(message));
+              }
+              executor->pool()->run(
+                  boost::bind(&RpcChannel::callServiceMethod, shared_from_this(),
+                              service, method, pooled, executor, receiveTime));
+            }
+            else
+            {
+              callServiceMethod(service, method, messagePtr, executor, receiveTime);
+            }
+            error = NO_ERROR;
           }
         }
         else
@@ -167,7 +377,7 @@ void RpcChannel::onRpcMessage(const TcpConnectionPtr& conn,
       response.set_type(RESPONSE);
       response.set_id(message.id());
       response.set_error(error);
-      codec_.send(conn_, response);
+      sendMessage(response);
     }
   }
   else if (message.type() == ERROR)
@@ -175,6 +385,69 @@ void RpcChannel::onRpcMessage(const TcpConnectionPtr& conn,
   }
 }
 
+// Replies and releases the executor slot when a service method is done.
+class RpcChannel::ExecutorDoneClosure : public ::google::protobuf::Closure
+{
+ public:
+  ExecutorDoneClosure(const RpcChannelPtr& channel,
+                      ::google::protobuf::Message* response,
+                      int64_t id,
+                      RpcExecutor* executor)
+    : channel_(channel),
+      response_(response),
+      id_(id),
+      executor_(executor)
+  {
+  }
+
+  virtual void Run()
+  {
+    channel_->doneCallback(response_, id_);
+    executor_->release();
+    delete this;
+  }
+
+ private:
+  RpcChannelPtr channel_;
+  ::google::protobuf::Message* response_;
+  int64_t id_;
+  RpcExecutor* executor_;
+};
+
+void RpcChannel::callServiceMethod(google::protobuf::Service* service,
+                                   const google::protobuf::MethodDescriptor* method,
+                                   const RpcMessagePtr& message,
+                                   RpcExecutor* executor,
+                                   Timestamp enqueued)
+{
+  if (executor->pool())
+  {
+    executor->recordQueueTime(enqueued, Timestamp::now());
+  }
+
+  int64_t id = message->id();
+  // inline in the IO thread, the codec's arena outlives the call
+  google::protobuf::Arena* arena = executor->pool() ? NULL : codec_.callbackArena();
+  google::protobuf::Message* request = newMessage(service->GetRequestPrototype(method), arena);
+  boost::scoped_ptr<google::protobuf::Message> d(arena ? NULL : request);
+  if (request->ParseFromString(message->request()))
+  {
+    google::protobuf::Message* response = service->GetResponsePrototype(method).New();
+    // response is deleted in doneCallback
+    service->CallMethod(method, NULL, request, response,
+                        new ExecutorDoneClosure(shared_from_this(), response, id, executor));
+  }
+  else
+  {
+    executor->release();
+    RpcMessage reply;
+    reply.set_type(RESPONSE);
+    reply.set_id(id);
+    reply.set_error(INVALID_REQUEST);
+    sendMessage(reply);
+  }
+}
+
 void RpcChannel::doneCallback(::google::protobuf::Message* response, int64_t id)
 {
   boost::scoped_ptr<google::protobuf::Message> d(response);
@@ -182,6 +455,6 @@ void RpcChannel::doneCallback(::google::protobuf::Message* response, int64_t id)
   message.set_type(RESPONSE);
   message.set_id(id);
   message.set_response(response->SerializeAsString()); // FIXME: error check
-  codec_.send(conn_, message);
+  sendMessage(message);
 }
 
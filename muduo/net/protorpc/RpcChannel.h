@@ -11,15 +11,18 @@
 #ifndef MUDUO_NET_PROTORPC_RPCCHANNEL_H
 #define MUDUO_NET_PROTORPC_RPCCHANNEL_H
 
-#include <muduo/base/Atomic.h>
-#include <muduo/base/Mutex.h>
+#include <muduo/net/Buffer.h>
 #include <muduo/net/protorpc/RpcCodec.h>
 
 #include <google/protobuf/service.h>
 
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 
+#include <deque>
 #include <map>
+#include <vector>
 
 // Service and RpcChannel classes are incorporated from
 // google/protobuf/service.h
@@ -81,6 +84,8 @@ namespace muduo
 namespace net
 {
 
+class RpcExecutor;
+
 // Abstract interface for an RPC channel.  An RpcChannel represents a
 // communication line to a Service which can be used to call that Service's
 // methods.  The Service may be running on another machine.  Normally, you
@@ -90,9 +95,14 @@ namespace net
 //   RpcChannel* channel = new MyRpcChannel("remotehost.example.com:1234");
 //   MyService* service = new MyService::Stub(channel);
 //   service->MyMethod(request, &response, callback);
-class RpcChannel : public ::google::protobuf::RpcChannel
+class RpcChannel : public ::google::protobuf::RpcChannel,
+                   public boost::enable_shared_from_this<RpcChannel>
 {
  public:
+  /// Returns the executor of a method, NULL to run it inline without limit.
+  typedef boost::function<RpcExecutor* (const ::google::protobuf::MethodDescriptor*)>
+      ExecutorSelector;
+
   RpcChannel();
 
   explicit RpcChannel(const TcpConnectionPtr& conn);
@@ -109,6 +119,45 @@ class RpcChannel : public ::google::protobuf::RpcChannel
     services_ = services;
   }
 
+  /// Server side, channel must be owned by a RpcChannelPtr
+  /// when selector returns executors.
+  void setExecutorSelector(const ExecutorSelector& selector)
+  {
+    executorSelector_ = selector;
+  }
+
+  /// Parses incoming RpcMessages into a per-thread arena, and the
+  /// requests of methods run in the IO thread too, so a service must
+  /// not keep its request after CallMethod() returns.
+  /// See ProtobufCodecLite::setUseArena().
+  void setUseArena(bool on)
+  {
+    codec_.setUseArena(on);
+  }
+
+  /// Checksum of outgoing frames, see ProtobufCodecLite::setChecksumType().
+  void setChecksumType(ProtobufCodecLite::ChecksumType type)
+  {
+    codec_.setChecksumType(type);
+  }
+
+  /// Answers in the checksum type of the peer's first frame, latched
+  /// then for the connection, set by RpcServer.
+  void setFollowPeerChecksum(bool on)
+  {
+    codec_.setFollowPeerChecksum(on);
+  }
+
+  /// Fails outstanding calls that get no response in seconds,
+  /// their done closures run with an untouched response, and the
+  /// controller, if any, is failed with TIMEOUT, see RpcController.
+  /// 0 means wait forever, which is the default.
+  /// Not thread safe, set it before calling any method.
+  void setCallTimeout(double seconds)
+  {
+    callTimeout_ = seconds;
+  }
+
   // Call the given method of the remote service.  The signature of this
   // procedure looks the same as Service::CallMethod(), but the requirements
   // are less strict in one important way:  the request and response objects
@@ -131,20 +180,59 @@ class RpcChannel : public ::google::protobuf::RpcChannel
 
   void doneCallback(::google::protobuf::Message* response, int64_t id);
 
+  void callServiceMethod(::google::protobuf::Service* service,
+                         const ::google::protobuf::MethodDescriptor* method,
+                         const RpcMessagePtr& message,
+                         RpcExecutor* executor,
+                         Timestamp enqueued);
+  class ExecutorDoneClosure;
+
+  void callMethodInLoop(const ::google::protobuf::MethodDescriptor* method,
+                        ::google::protobuf::RpcController* controller,
+                        const std::string& request,
+                        ::google::protobuf::Message* response,
+                        ::google::protobuf::Closure* done);
+  void sendMessage(const RpcMessage& message);
+  void flushPendingOutput();
+  bool isOutstanding(int64_t id) const
+  {
+    uint32_t slot = static_cast<uint32_t>(id);
+    return slot < outstandings_.size() && outstandings_[slot].id == id;
+  }
+  void addDeadline(Timestamp deadline, int64_t id);
+  void expireCalls();
+
+  // id is (sequence << 32 | slot index), slot is free when id == 0
   struct OutstandingCall
   {
+    int64_t id;
+    ::google::protobuf::RpcController* controller;
     ::google::protobuf::Message* response;
     ::google::protobuf::Closure* done;
   };
 
+  static const int kSlotBits = 32;
+
   RpcCodec codec_;
   TcpConnectionPtr conn_;
-  AtomicInt64 id_;
 
-  MutexLock mutex_;
-  std::map<int64_t, OutstandingCall> outstandings_;
+  // following members are only accessed in conn_'s loop thread, no locking.
+  uint32_t sequence_;
+  std::vector<OutstandingCall> outstandings_;
+  std::vector<uint32_t> freeSlots_;
+
+  double callTimeout_;
+  // calls share one timeout, so their deadlines are in issuing order.
+  // Entries of answered calls are dropped as new ones are added.
+  std::deque<std::pair<Timestamp, int64_t> > deadlines_;
+  bool expireTimerArmed_;  // holds a weak callback, no need to cancel
+
+  // requests and responses made in one loop iteration go out in one send().
+  Buffer pendingOutput_;
+  bool flushQueued_;
 
   const std::map<std::string, ::google::protobuf::Service*>* services_;
+  ExecutorSelector executorSelector_;
 };
 typedef boost::shared_ptr<RpcChannel> RpcChannelPtr;
 
@@ -23,6 +23,20 @@ void messageCallback(const TcpConnectionPtr&,
   g_msgptr = msg;
 }
 
+uint64_t g_arenaMessages = 0;
+void arenaMessageCallback(const TcpConnectionPtr&,
+                          const MessagePtr& msg,
+                          Timestamp)
+{
+  // arena messages are only valid during the callback
+  assert(msg->GetArena() != NULL);
+  const RpcMessage* rpc = dynamic_cast<const RpcMessage*>(get_pointer(msg));
+  assert(rpc != NULL);
+  assert(rpc->type() == REQUEST);
+  assert(rpc->id() == 2 + g_arenaMessages);
+  ++g_arenaMessages;
+}
+
 void print(const Buffer& buf)
 {
   printf("encoded to %zd bytes\n", buf.readableBytes());
@@ -77,5 +91,64 @@ int main()
   assert(g_msgptr->DebugString() == message.DebugString());
   }
 
+  {
+  // old peers only see kAdler32 frames, other types set the top bits of length
+  ProtobufCodecLite::ChecksumType types[] = { ProtobufCodecLite::kCrc32c,
+                                              ProtobufCodecLite::kNoChecksum };
+  for (size_t i = 0; i < sizeof types / sizeof types[0]; ++i)
+  {
+  Buffer buf;
+  ProtobufCodecLite codec(&RpcMessage::default_instance(), "RPC0", messageCallback);
+  codec.setChecksumType(types[i]);
+  codec.fillEmptyBuffer(&buf, message);
+  assert(static_cast<uint32_t>(buf.peekInt32()) >> ProtobufCodecLite::kChecksumTypeShift
+         == static_cast<uint32_t>(types[i]));
+  assert(buf.toStringPiece().as_string() != expected);
+
+  ProtobufCodecLite receiver(&RpcMessage::default_instance(), "RPC0", messageCallback);
+  receiver.setFollowPeerChecksum(true);
+  g_msgptr.reset();
+  receiver.onMessage(TcpConnectionPtr(), &buf, Timestamp::now());
+  assert(g_msgptr);
+  assert(g_msgptr->DebugString() == message.DebugString());
+  assert(receiver.checksumType() == types[i]);
+  g_msgptr.reset();
+  }
+  }
+
+  {
+  // frames appended in place match fillEmptyBuffer()
+  Buffer buf;
+  buf.append("pending");
+  buf.retrieve(3);
+  ProtobufCodecLite codec(&RpcMessage::default_instance(), "RPC0", messageCallback);
+  codec.appendToBuffer(&buf, message);
+  codec.appendToBuffer(&buf, message);
+  assert(buf.toStringPiece().as_string() == "ding" + expected + expected);
+  buf.retrieve(4);
+  g_msgptr.reset();
+  codec.onMessage(TcpConnectionPtr(), &buf, Timestamp::now());
+  assert(g_msgptr);
+  assert(g_msgptr->DebugString() == message.DebugString());
+  assert(buf.readableBytes() == 0);
+  g_msgptr.reset();
+  }
+
+  {
+  Buffer buf;
+  ProtobufCodecLite codec(&RpcMessage::default_instance(), "RPC0", arenaMessageCallback);
+  codec.setUseArena(true);
+  for (int i = 0; i < 3; ++i)
+  {
+    Buffer frame;
+    message.set_id(2 + i);
+    codec.fillEmptyBuffer(&frame, message);
+    buf.append(frame.peek(), frame.readableBytes());
+  }
+  codec.onMessage(TcpConnectionPtr(), &buf, Timestamp::now());
+  assert(g_arenaMessages == 3);
+  assert(buf.readableBytes() == 0);
+  }
+
   google::protobuf::ShutdownProtobufLibrary();
 }
@@ -0,0 +1,86 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_PROTORPC_RPCCONTROLLER_H
+#define MUDUO_NET_PROTORPC_RPCCONTROLLER_H
+
+#include <muduo/net/protorpc/rpc.pb.h>
+
+#include <google/protobuf/service.h>
+
+namespace muduo
+{
+namespace net
+{
+
+/// Client side controller, pass it to a stub method to learn why a call
+/// failed, eg. TIMEOUT or an error answered by the server.
+/// Cancellation is not supported.
+class RpcController : public ::google::protobuf::RpcController
+{
+ public:
+  RpcController()
+    : errorCode_(NO_ERROR)
+  {
+  }
+
+  virtual void Reset()
+  {
+    errorCode_ = NO_ERROR;
+    reason_.clear();
+  }
+
+  virtual bool Failed() const
+  {
+    return errorCode_ != NO_ERROR || !reason_.empty();
+  }
+
+  virtual std::string ErrorText() const
+  {
+    return reason_;
+  }
+
+  virtual void StartCancel()
+  {
+  }
+
+  virtual void SetFailed(const std::string& reason)
+  {
+    reason_ = reason;
+  }
+
+  virtual bool IsCanceled() const
+  {
+    return false;
+  }
+
+  virtual void NotifyOnCancel(::google::protobuf::Closure* callback)
+  {
+  }
+
+  ErrorCode errorCode() const
+  {
+    return errorCode_;
+  }
+
+  void setErrorCode(ErrorCode error)
+  {
+    errorCode_ = error;
+  }
+
+ private:
+  ErrorCode errorCode_;
+  std::string reason_;
+};
+
+}
+}
+
+#endif  // MUDUO_NET_PROTORPC_RPCCONTROLLER_H
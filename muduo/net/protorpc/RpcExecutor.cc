@@ -0,0 +1,74 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include <muduo/net/protorpc/RpcExecutor.h>
+
+#include <muduo/base/ThreadPool.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+RpcExecutor::RpcExecutor(int maxInFlight)
+  : pool_(NULL),
+    maxInFlight_(maxInFlight),
+    maxQueueTimeUs_(0)
+{
+}
+
+RpcExecutor::RpcExecutor(ThreadPool* pool, int maxInFlight)
+  : pool_(pool),
+    maxInFlight_(maxInFlight),
+    maxQueueTimeUs_(0)
+{
+}
+
+RpcExecutor::RpcExecutor(const string& name, int numThreads, int maxInFlight)
+  : ownPool_(new ThreadPool(name)),
+    pool_(get_pointer(ownPool_)),
+    maxInFlight_(maxInFlight),
+    maxQueueTimeUs_(0)
+{
+  ownPool_->start(numThreads);
+}
+
+RpcExecutor::~RpcExecutor()
+{
+}
+
+bool RpcExecutor::tryAcquire()
+{
+  if (inFlight_.incrementAndGet() > maxInFlight_ && maxInFlight_ > 0)
+  {
+    inFlight_.decrement();
+    numRejected_.increment();
+    return false;
+  }
+  numCalls_.increment();
+  return true;
+}
+
+void RpcExecutor::release()
+{
+  inFlight_.decrement();
+}
+
+void RpcExecutor::recordQueueTime(Timestamp enqueued, Timestamp started)
+{
+  int64_t us = started.microSecondsSinceEpoch() - enqueued.microSecondsSinceEpoch();
+  totalQueueTimeUs_.add(us);
+  int64_t max = maxQueueTimeUs();
+  while (us > max)
+  {
+    int64_t old = __sync_val_compare_and_swap(&maxQueueTimeUs_, max, us);
+    if (old == max)
+    {
+      break;
+    }
+    max = old;
+  }
+}
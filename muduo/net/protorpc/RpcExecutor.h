@@ -0,0 +1,82 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_PROTORPC_RPCEXECUTOR_H
+#define MUDUO_NET_PROTORPC_RPCEXECUTOR_H
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/base/Types.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace muduo
+{
+
+class ThreadPool;
+
+namespace net
+{
+
+/// Decides where service methods run, and how many may run at once.
+///
+/// An executor is shared by every connection of a RpcServer,
+/// all methods are thread safe.
+class RpcExecutor : boost::noncopyable
+{
+ public:
+  /// Runs methods inline in the IO thread that decoded the request.
+  /// maxInFlight == 0 means no limit.
+  explicit RpcExecutor(int maxInFlight = 0);
+
+  /// Runs methods on pool, which is shared and not owned.
+  RpcExecutor(ThreadPool* pool, int maxInFlight);
+
+  /// Runs methods on a dedicated pool of numThreads threads.
+  RpcExecutor(const string& name, int numThreads, int maxInFlight);
+
+  ~RpcExecutor();  // force out-line dtor, for scoped_ptr members.
+
+  /// NULL if methods run inline.
+  ThreadPool* pool() const { return pool_; }
+  int maxInFlight() const { return maxInFlight_; }
+
+  /// Returns false, and counts a rejection, if maxInFlight calls are running.
+  bool tryAcquire();
+  /// Called when a call acquired by tryAcquire() is done.
+  void release();
+
+  /// Records how long a call waited between decoding and running.
+  void recordQueueTime(Timestamp enqueued, Timestamp started);
+
+  int inFlight() { return inFlight_.get(); }
+  int64_t numCalls() { return numCalls_.get(); }
+  int64_t numRejected() { return numRejected_.get(); }
+  int64_t totalQueueTimeUs() { return totalQueueTimeUs_.get(); }
+  int64_t maxQueueTimeUs() { return __sync_val_compare_and_swap(&maxQueueTimeUs_, 0, 0); }
+
+ private:
+  boost::scoped_ptr<ThreadPool> ownPool_;
+  ThreadPool* pool_;
+  const int maxInFlight_;
+  AtomicInt32 inFlight_;
+  AtomicInt64 numCalls_;
+  AtomicInt64 numRejected_;
+  AtomicInt64 totalQueueTimeUs_;
+  volatile int64_t maxQueueTimeUs_;  // no max in AtomicInt64, CAS by hand
+};
+typedef boost::shared_ptr<RpcExecutor> RpcExecutorPtr;
+
+}
+}
+
+#endif  // MUDUO_NET_PROTORPC_RPCEXECUTOR_H
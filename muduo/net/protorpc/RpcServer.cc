@@ -35,6 +35,35 @@ void RpcServer::registerService(google::protobuf::Service* service)
   services_[desc->full_name()] = service;
 }
 
+void RpcServer::setExecutor(const google::protobuf::ServiceDescriptor* service,
+                            const RpcExecutorPtr& executor)
+{
+  serviceExecutors_[service] = executor;
+}
+
+void RpcServer::setExecutor(const google::protobuf::MethodDescriptor* method,
+                            const RpcExecutorPtr& executor)
+{
+  methodExecutors_[method] = executor;
+}
+
+RpcExecutor* RpcServer::findExecutor(const google::protobuf::MethodDescriptor* method) const
+{
+  std::map<const google::protobuf::MethodDescriptor*, RpcExecutorPtr>::const_iterator mit
+    = methodExecutors_.find(method);
+  if (mit != methodExecutors_.end())
+  {
+    return get_pointer(mit->second);
+  }
+  std::map<const google::protobuf::ServiceDescriptor*, RpcExecutorPtr>::const_iterator sit
+    = serviceExecutors_.find(method->service());
+  if (sit != serviceExecutors_.end())
+  {
+    return get_pointer(sit->second);
+  }
+  return NULL;
+}
+
 void RpcServer::start()
 {
   server_.start();
@@ -49,8 +78,15 @@ void RpcServer::onConnection(const TcpConnectionPtr& conn)
   {
     RpcChannelPtr channel(new RpcChannel(conn));
     channel->setServices(&services_);
+    channel->setFollowPeerChecksum(true);
+    if (!methodExecutors_.empty() || !serviceExecutors_.empty())
+    {
+      channel->setExecutorSelector(boost::bind(&RpcServer::findExecutor, this, _1));
+    }
     conn->setMessageCallback(
         boost::bind(&RpcChannel::onMessage, get_pointer(channel), _1, _2, _3));
+    // responses to pipelined requests go out in one write per iteration.
+    conn->setDeferredFlush(true);
     conn->setContext(channel);
   }
   else
@@ -12,11 +12,14 @@
 #define MUDUO_NET_PROTORPC_RPCSERVER_H
 
 #include <muduo/net/TcpServer.h>
+#include <muduo/net/protorpc/RpcExecutor.h>
 
 namespace google {
 namespace protobuf {
 
+class MethodDescriptor;
 class Service;
+class ServiceDescriptor;
 
 }  // namespace protobuf
 }  // namespace google
@@ -38,6 +41,17 @@ class RpcServer
   }
 
   void registerService(::google::protobuf::Service*);
+
+  /// Runs every method of service on executor, instead of the IO thread.
+  /// Not thread safe, call before start().
+  void setExecutor(const ::google::protobuf::ServiceDescriptor* service,
+                   const RpcExecutorPtr& executor);
+  /// Overrides the executor of service for one method.
+  void setExecutor(const ::google::protobuf::MethodDescriptor* method,
+                   const RpcExecutorPtr& executor);
+  /// NULL if method runs inline without limit.
+  RpcExecutor* findExecutor(const ::google::protobuf::MethodDescriptor* method) const;
+
   void start();
 
  private:
@@ -49,6 +63,8 @@ class RpcServer
 
   TcpServer server_;
   std::map<std::string, ::google::protobuf::Service*> services_;
+  std::map<const ::google::protobuf::ServiceDescriptor*, RpcExecutorPtr> serviceExecutors_;
+  std::map<const ::google::protobuf::MethodDescriptor*, RpcExecutorPtr> methodExecutors_;
 };
 
 }
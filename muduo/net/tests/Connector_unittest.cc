@@ -0,0 +1,154 @@
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/SocketsOps.h>
+#include <muduo/net/TcpClient.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+
+#include <dlfcn.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// A host of two addresses, the first refuses, the second never answers
+// as the backlog of its listener is full.  The refused socket is closed
+// while its Channel handles POLLERR|POLLOUT, and the next attempt may
+// get the same fd, which must not be taken as connected.
+
+const uint16_t kPort = 2019;
+const char* kHost = "eyeballs.test";
+
+EventLoop* g_loop;
+int g_failures = 0;
+int g_connections = 0;
+
+void check(bool ok, const char* what)
+{
+  if (!ok)
+  {
+    LOG_ERROR << "FAILED " << what;
+    ++g_failures;
+  }
+}
+
+typedef int (*GetAddrInfo)(const char*, const char*,
+                           const struct addrinfo*, struct addrinfo**);
+
+// resolves kHost to 127.0.0.2 and 127.0.0.1, in that order.
+extern "C" int getaddrinfo(const char* node, const char* service,
+                           const struct addrinfo* hints, struct addrinfo** res)
+{
+  GetAddrInfo next = reinterpret_cast<GetAddrInfo>(::dlsym(RTLD_NEXT, "getaddrinfo"));
+  if (node == NULL || strcmp(node, kHost) != 0)
+  {
+    return next(node, service, hints, res);
+  }
+  struct addrinfo* refused = NULL;
+  struct addrinfo* stalled = NULL;
+  int ret = next("127.0.0.2", service, hints, &refused);
+  if (ret == 0)
+  {
+    ret = next("127.0.0.1", service, hints, &stalled);
+    if (ret != 0)
+    {
+      ::freeaddrinfo(refused);
+      return ret;
+    }
+    struct addrinfo* last = refused;
+    while (last->ai_next)
+    {
+      last = last->ai_next;
+    }
+    last->ai_next = stalled;
+    *res = refused;
+  }
+  return ret;
+}
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    ++g_connections;
+    LOG_INFO << "connected to " << conn->peerAddress().toIpPort();
+  }
+}
+
+// the refused address is skipped for one that accepts.
+void testFallback()
+{
+  InetAddress serverAddr("127.0.0.1", kPort + 1);
+  TcpServer server(g_loop, serverAddr, "Server");
+  server.start();
+  g_connections = 0;
+  TcpClient client(g_loop, kHost, kPort + 1, "Fallback");
+  client.setConnectionCallback(onConnection);
+  client.connect();
+  g_loop->runAfter(0.5, boost::bind(&EventLoop::quit, g_loop));
+  g_loop->loop();
+  check(g_connections == 1, "connected");
+  check(client.connection() &&
+        client.connection()->peerAddress().toIpPort() == serverAddr.toIpPort(), "peer");
+  client.disconnect();
+  g_loop->runAfter(0.1, boost::bind(&EventLoop::quit, g_loop));
+  g_loop->loop();
+}
+
+int connectTo(const InetAddress& addr)
+{
+  int sockfd = sockets::createNonblockingOrDie(addr.family());
+  int ret = sockets::connect(sockfd, addr.getSockAddr());
+  check(ret == 0 || errno == EINPROGRESS, "filler connect");
+  return sockfd;
+}
+
+int main()
+{
+  EventLoop loop;
+  g_loop = &loop;
+
+  // never accepts, SYNs beyond its backlog go unanswered.
+  InetAddress listenAddr("127.0.0.1", kPort);
+  int listenfd = sockets::createNonblockingOrDie(listenAddr.family());
+  sockets::bindOrDie(listenfd, listenAddr.getSockAddr());
+  if (::listen(listenfd, 0) < 0)
+  {
+    LOG_SYSFATAL << "listen";
+  }
+  std::vector<int> fillers;
+  for (int i = 0; i < 3; ++i)
+  {
+    fillers.push_back(connectTo(listenAddr));
+  }
+
+  for (int round = 0; round < 5; ++round)
+  {
+    TcpClient client(&loop, kHost, kPort, "Connector");
+    client.setConnectionCallback(onConnection);
+    client.connect();
+    loop.runAfter(0.5, boost::bind(&EventLoop::quit, &loop));
+    loop.loop();
+    check(g_connections == 0, "no connection to a stalled address");
+    client.stop();
+    loop.runAfter(0.1, boost::bind(&EventLoop::quit, &loop));
+    loop.loop();
+  }
+
+  for (size_t i = 0; i < fillers.size(); ++i)
+  {
+    sockets::close(fillers[i]);
+  }
+  sockets::close(listenfd);
+
+  testFallback();
+
+  if (g_failures == 0)
+  {
+    printf("All tests passed\n");
+  }
+  return g_failures == 0 ? 0 : 1;
+}
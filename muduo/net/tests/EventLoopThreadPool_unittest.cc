@@ -1,5 +1,7 @@
+#undef NDEBUG
 #include <muduo/net/EventLoopThreadPool.h>
 #include <muduo/net/EventLoop.h>
+#include <muduo/base/CountDownLatch.h>
 #include <muduo/base/Thread.h>
 
 #include <boost/bind.hpp>
@@ -15,6 +17,25 @@ void print(EventLoop* p = NULL)
          getpid(), CurrentThread::tid(), p);
 }
 
+void block(CountDownLatch* running, CountDownLatch* release)
+{
+  running->countDown();
+  release->wait();
+}
+
+// a quit() before loop() is lost, so loops must be running
+// before the pool is destroyed.
+void waitLooping(EventLoopThreadPool* model)
+{
+  std::vector<EventLoop*> loops = model->getAllLoops();
+  CountDownLatch latch(static_cast<int>(loops.size()));
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    loops[i]->runInLoop(boost::bind(&CountDownLatch::countDown, &latch));
+  }
+  latch.wait();
+}
+
 void init(EventLoop* p)
 {
   printf("init(): pid = %d, tid = %d, loop = %p\n",
@@ -62,6 +83,93 @@ int main()
     assert(nextLoop != model.getNextLoop());
     assert(nextLoop != model.getNextLoop());
     assert(nextLoop == model.getNextLoop());
+    waitLooping(&model);
+  }
+
+  {
+    printf("Least connections:\n");
+    EventLoopThreadPool model(&loop, "least");
+    model.setThreadNum(3);
+    model.setSelectionPolicy(EventLoopThreadPool::kLeastConnections);
+    model.start(init);
+    std::vector<EventLoop*> loops = model.getAllLoops();
+    model.updateLoad(loops[0], 2);
+    model.updateLoad(loops[1], 1);
+    assert(model.getNextLoop() == loops[2]);
+    model.updateLoad(loops[2], 2);
+    assert(model.getNextLoop() == loops[1]);
+    model.updateLoad(loops[0], -2);
+    assert(model.getNextLoop() == loops[0]);
+
+    model.setSelectionPolicy(EventLoopThreadPool::kPowerOfTwoChoices);
+    model.updateLoad(loops[1], 100);
+    bool picked[3] = { false, false, false };
+    for (int i = 0; i < 100; ++i)
+    {
+      // the two choices are distinct, so the busiest is never picked
+      EventLoop* chosen = model.getNextLoop();
+      assert(chosen != loops[1]);
+      picked[chosen == loops[0] ? 0 : 2] = true;
+    }
+    assert(picked[0] && picked[2]);
+    waitLooping(&model);
+  }
+
+  {
+    printf("CPU sets:\n");
+    EventLoopThreadPool model(&loop, "cpu");
+    model.setThreadNum(4);
+    // loops 0 and 2 share CPU 0, as loops sharing a NUMA node do.
+    std::vector<CpuSet> cpuSets(2);
+    cpuSets[0].push_back(0);
+    model.setCpuSets(cpuSets);
+    model.start(init);
+    std::vector<EventLoop*> loops = model.getAllLoops();
+    EventLoop* first = model.getLoopForCpu(0);
+    EventLoop* second = model.getLoopForCpu(0);
+    assert(first == loops[0] || first == loops[2]);
+    assert(second == loops[0] || second == loops[2]);
+    assert(first != second);
+    // the least loaded one, as TcpServer counts connections
+    model.updateLoad(loops[0], 2);
+    model.updateLoad(loops[2], 1);
+    assert(model.getLoopForCpu(0) == loops[2]);
+    assert(model.getLoopForCpu(0) == loops[2]);
+    // no loop on cpu 1, or cpu unknown, falls back to round-robin
+    assert(model.getLoopForCpu(1) == loops[0]);
+    assert(model.getLoopForCpu(-1) == loops[1]);
+    waitLooping(&model);
+  }
+
+  {
+    printf("Least queued:\n");
+    // outlive the pool's threads
+    CountDownLatch running(2);
+    CountDownLatch thirdRunning(1);
+    CountDownLatch release(1);
+    EventLoopThreadPool model(&loop, "queued");
+    model.setThreadNum(3);
+    model.setSelectionPolicy(EventLoopThreadPool::kLeastQueued);
+    model.start(init);
+    std::vector<EventLoop*> loops = model.getAllLoops();
+    // blocks loops 0 and 1, then queues more functors behind them.
+    loops[0]->runInLoop(boost::bind(block, &running, &release));
+    loops[1]->runInLoop(boost::bind(block, &running, &release));
+    running.wait();
+    for (int i = 0; i < 3; ++i)
+    {
+      loops[0]->queueInLoop(boost::bind(print, loops[0]));
+    }
+    loops[1]->queueInLoop(boost::bind(print, loops[1]));
+    assert(model.getNextLoop() == loops[2]);
+    loops[2]->runInLoop(boost::bind(block, &thirdRunning, &release));
+    thirdRunning.wait();
+    for (int i = 0; i < 2; ++i)
+    {
+      loops[2]->queueInLoop(boost::bind(print, loops[2]));
+    }
+    assert(model.getNextLoop() == loops[1]);
+    release.countDown();
   }
 
   loop.loop();
@@ -45,3 +45,15 @@ BOOST_AUTO_TEST_CASE(testInetAddressResolve)
     LOG_ERROR << "Unable to resolve google.com";
   }
 }
+
+BOOST_AUTO_TEST_CASE(testInetAddressResolveAll)
+{
+  std::vector<InetAddress> addrs = InetAddress::resolveAll("localhost", 80);
+  BOOST_CHECK(!addrs.empty());
+  for (size_t i = 0; i < addrs.size(); ++i)
+  {
+    LOG_INFO << "localhost resolved to " << addrs[i].toIpPort();
+    BOOST_CHECK_EQUAL(addrs[i].toPort(), 80);
+  }
+  BOOST_CHECK(InetAddress::resolveAll("no-such-host.invalid").empty());
+}
@@ -0,0 +1,96 @@
+#include <muduo/net/Resolver.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/TcpClient.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const uint16_t kPort = 2018;
+
+EventLoop* g_loop;
+int g_failures = 0;
+bool g_called = false;
+bool g_connected = false;
+
+void check(bool ok, const char* what)
+{
+  if (!ok)
+  {
+    LOG_ERROR << "FAILED " << what;
+    ++g_failures;
+  }
+}
+
+void onIp(const Resolver::AddressList& addresses)
+{
+  g_called = true;
+  check(addresses.size() == 1 && addresses[0].toIpPort() == "127.0.0.1:80", "ip");
+}
+
+void onCached(const Resolver::AddressList& addresses)
+{
+  g_called = true;
+  check(!addresses.empty(), "cached");
+}
+
+void onLocalhost(const Resolver::AddressList& addresses)
+{
+  check(!addresses.empty(), "localhost");
+  for (size_t i = 0; i < addresses.size(); ++i)
+  {
+    LOG_INFO << "localhost resolved to " << addresses[i].toIpPort();
+    check(addresses[i].toPort() == kPort, "port");
+  }
+  // cached now, calls back at once in loop thread.
+  g_called = false;
+  Resolver::instance().resolve(g_loop, "localhost", kPort, onCached);
+  check(g_called, "cache hit");
+}
+
+void onInvalid(const Resolver::AddressList& addresses)
+{
+  check(addresses.empty(), "invalid");
+}
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    // the server listens on IPv4 only, ::1 if tried first is refused.
+    LOG_INFO << "connected to " << conn->peerAddress().toIpPort();
+    g_connected = true;
+    conn->shutdown();
+    g_loop->runAfter(0.5, boost::bind(&EventLoop::quit, g_loop));
+  }
+}
+
+int main()
+{
+  EventLoop loop;
+  g_loop = &loop;
+
+  Resolver::instance().resolve(&loop, "127.0.0.1", 80, onIp);
+  check(g_called, "ip at once");
+  Resolver::instance().resolve(&loop, "localhost", kPort, onLocalhost);
+  Resolver::instance().resolve(&loop, "no-such-host.invalid", kPort, onInvalid);
+
+  TcpServer server(&loop, InetAddress("127.0.0.1", kPort), "ResolverTest");
+  server.start();
+  TcpClient client(&loop, "localhost", kPort, "ResolverTest");
+  client.setConnectionCallback(onConnection);
+  client.connect();
+
+  loop.runAfter(10.0, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  check(g_connected, "connect by hostname");
+  printf("%d failures\n", g_failures);
+  return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+#include <muduo/net/TcpClientPool.h>
+
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopThread.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <map>
+#include <set>
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const uint16_t kPort = 2020;
+const int kBackends = 3;
+const int kConnections = 2;
+
+EventLoop* g_loop;
+int g_failures = 0;
+
+void check(bool ok, const char* what)
+{
+  if (!ok)
+  {
+    LOG_ERROR << "FAILED " << what;
+    ++g_failures;
+  }
+}
+
+void testLeastOutstanding(TcpClientPool* pool)
+{
+  check(pool->numConnected() == kBackends * kConnections, "warm up");
+
+  // every connection gets one request before any gets two.
+  std::set<TcpConnectionPtr> used;
+  std::vector<TcpConnectionPtr> conns;
+  for (int i = 0; i < kBackends * kConnections; ++i)
+  {
+    TcpConnectionPtr conn = pool->getConnection();
+    check(conn && used.insert(conn).second, "least outstanding");
+    pool->requestStarted(conn);
+    conns.push_back(conn);
+  }
+  pool->requestFinished(conns[2], true);
+  check(pool->getConnection() == conns[2], "finished one first");
+  for (size_t i = 0; i < conns.size(); ++i)
+  {
+    if (i != 2)
+    {
+      pool->requestFinished(conns[i], true);
+    }
+  }
+}
+
+void testConsistentHashAndEjection(TcpClientPool* hashPool)
+{
+  std::map<string, uint16_t> owners;
+  std::set<uint16_t> backends;
+  for (int i = 0; i < 100; ++i)
+  {
+    char key[32];
+    snprintf(key, sizeof key, "key%d", i);
+    TcpConnectionPtr conn = hashPool->getConnection(key);
+    check(conn && conn == hashPool->getConnection(key), "stable");
+    owners[key] = conn->peerAddress().toPort();
+    backends.insert(conn->peerAddress().toPort());
+  }
+  check(backends.size() == kBackends, "spread");
+
+  // fails key0's backend until it's ejected, only its keys move.
+  TcpConnectionPtr conn = hashPool->getConnection("key0");
+  uint16_t ejected = conn->peerAddress().toPort();
+  for (int i = 0; i < 3; ++i)
+  {
+    hashPool->requestStarted(conn);
+    hashPool->requestFinished(conn, false);
+  }
+  for (std::map<string, uint16_t>::iterator it = owners.begin(); it != owners.end(); ++it)
+  {
+    uint16_t port = hashPool->getConnection(it->first)->peerAddress().toPort();
+    check(port != ejected, "ejected");
+    check(it->second == ejected || port == it->second, "others stay");
+  }
+}
+
+void runTests(TcpClientPool* pool, TcpClientPool* hashPool)
+{
+  testLeastOutstanding(pool);
+  testConsistentHashAndEjection(hashPool);
+  pool->stop();
+  hashPool->stop();
+  g_loop->runAfter(0.5, boost::bind(&EventLoop::quit, g_loop));
+}
+
+// Teardown: a pool destroyed while its loop runs and its connections
+// are up closes them, and calls back no more.
+CountDownLatch g_upLatch(kBackends);
+bool g_poolDestroyed = false;
+int g_backendDowns = 0;
+
+void onPooledConnection(const TcpConnectionPtr& conn)
+{
+  check(!g_poolDestroyed, "no callback after destruction");
+  if (conn->connected())
+  {
+    g_upLatch.countDown();
+  }
+}
+
+void onBackendConnection(const TcpConnectionPtr& conn)
+{
+  if (!conn->connected())
+  {
+    ++g_backendDowns;
+  }
+}
+
+void destroyPool(TcpClientPool* pool)
+{
+  g_upLatch.wait();
+  delete pool;
+  g_poolDestroyed = true;
+  g_loop->runAfter(0.5, boost::bind(&EventLoop::quit, g_loop));
+}
+
+int main()
+{
+  EventLoop loop;
+  g_loop = &loop;
+
+  std::vector<InetAddress> backends;
+  boost::ptr_vector<TcpServer> servers;
+  for (int i = 0; i < kBackends; ++i)
+  {
+    InetAddress addr("127.0.0.1", static_cast<uint16_t>(kPort + i));
+    servers.push_back(new TcpServer(&loop, addr, "Backend"));
+    servers.back().start();
+    backends.push_back(addr);
+  }
+
+  std::vector<EventLoop*> loops(1, &loop);
+  TcpClientPool pool(loops, backends, "Pool");
+  pool.setConnectionsPerBackend(kConnections);
+  pool.start();
+
+  TcpClientPool hashPool(loops, backends, "HashPool");
+  hashPool.setSelectionPolicy(TcpClientPool::kConsistentHash);
+  hashPool.setOutlierDetection(3, 10.0);
+  hashPool.start();
+
+  loop.runAfter(0.5, boost::bind(runTests, &pool, &hashPool));
+  loop.runAfter(10.0, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  // the pool lives in another thread, the backends in this one
+  for (int i = 0; i < kBackends; ++i)
+  {
+    servers[i].setConnectionCallback(onBackendConnection);
+  }
+  EventLoopThread poolThread;
+  std::vector<EventLoop*> poolLoops(1, poolThread.startLoop());
+  TcpClientPool* dying = new TcpClientPool(poolLoops, backends, "DyingPool");
+  dying->setConnectionCallback(onPooledConnection);
+  dying->start();
+  loop.queueInLoop(boost::bind(destroyPool, dying));
+  loop.loop();
+  check(g_backendDowns == kBackends, "closed by destruction");
+
+  printf("%d failures\n", g_failures);
+  return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,337 @@
+#include <muduo/net/TcpConnection.h>
+
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/Logging.h>
+#include <muduo/base/Thread.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/TcpServer.h>
+
+#include <boost/bind.hpp>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// The client reads with a tiny receive buffer, after a delay, so the
+// server's writes are partial and later sends queue behind earlier ones.
+
+const uint16_t kPort = 2030;
+
+EventLoop* g_loop;
+int g_failures = 0;
+bool g_queued = false;
+string g_expected;
+string g_received;
+
+void check(bool ok, const char* what)
+{
+  if (!ok)
+  {
+    LOG_ERROR << "FAILED " << what;
+    ++g_failures;
+  }
+}
+
+// every send flavour, back to back, in an order that alternates
+// buffered and shared bytes.
+void sendRound(const TcpConnectionPtr& conn, int round)
+{
+  for (int i = 0; i < 8; ++i)
+  {
+    char header[64];
+    snprintf(header, sizeof header, "round %d message %d\n", round, i);
+    conn->send(header);
+    g_expected += header;
+
+    SharedMessage big(new string(256 * 1024 * (i + 1), static_cast<char>('a' + i)));
+    conn->send(big);
+    g_expected += *big;
+
+    string small(i * 100 + 1, static_cast<char>('A' + i));
+    conn->send(small);
+    g_expected += small;
+
+    SharedMessage first(new string(10, static_cast<char>('0' + i)));
+    SharedMessage second(new string(1000, static_cast<char>('0' + round)));
+    conn->send(first);
+    conn->send(second);
+    g_expected += *first;
+    g_expected += *second;
+
+    Buffer buf;
+    buf.append(header);
+    buf.appendInt32(i);
+    g_expected.append(buf.peek(), buf.readableBytes());
+    conn->send(&buf);
+  }
+}
+
+void secondRound(const TcpConnectionPtr& conn)
+{
+  sendRound(conn, 1);
+  conn->shutdown();
+}
+
+void onHighWaterMark(const TcpConnectionPtr&, size_t)
+{
+  g_queued = true;
+}
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setHighWaterMarkCallback(onHighWaterMark, 1024 * 1024);
+    sendRound(conn, 0);
+    // more sends while the first round is still queued.
+    g_loop->runAfter(0.1, boost::bind(secondRound, conn));
+  }
+}
+
+void readAll()
+{
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  int rcvbuf = 4096;
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof rcvbuf);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) == 0)
+  {
+    ::usleep(300 * 1000);
+    char buf[4096];
+    ssize_t n = 0;
+    while ((n = ::read(fd, buf, sizeof buf)) > 0)
+    {
+      g_received.append(buf, n);
+    }
+  }
+  ::close(fd);
+  g_loop->quit();
+}
+
+// Deferred flush: the echo is written at the end of the iteration, the
+// write complete callback queued from there must run without waiting
+// for the next poll, it sends "done".
+bool g_echoed = false;
+
+void onEchoMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  conn->send(buf);
+  g_echoed = true;
+}
+
+void onEchoWriteComplete(const TcpConnectionPtr& conn)
+{
+  if (g_echoed)
+  {
+    g_echoed = false;
+    conn->send("done\n");
+  }
+}
+
+void onEchoConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setDeferredFlush(true);
+  }
+}
+
+void pingPong()
+{
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  struct timeval timeout = { 5, 0 };
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort + 1);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  string received;
+  Timestamp start;
+  if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) == 0)
+  {
+    start = Timestamp::now();
+    check(::write(fd, "ping\n", 5) == 5, "write");
+    char buf[64];
+    ssize_t n = 0;
+    while (received.size() < 10 && (n = ::read(fd, buf, sizeof buf)) > 0)
+    {
+      received.append(buf, n);
+    }
+  }
+  check(received == "ping\ndone\n", "deferred echo");
+  check(timeDifference(Timestamp::now(), start) < 1.0, "write complete callback is prompt");
+  ::close(fd);
+  g_loop->quit();
+}
+
+// Zero copy: 8 MB payloads, shared and buffered, in the loop thread and
+// from another one, which hands its Buffer over for the loop to decide.
+const size_t kLarge = 8 * 1024 * 1024;
+CountDownLatch g_zeroCopyReady(1);
+TcpConnectionPtr g_zeroCopyConn;
+
+string largePayload(int seed)
+{
+  string payload(kLarge, '\0');
+  for (size_t i = 0; i < payload.size(); ++i)
+  {
+    payload[i] = static_cast<char>(i * 7 + seed + i / 4096);
+  }
+  return payload;
+}
+
+void onZeroCopyConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setZeroCopyThreshold(64 * 1024);
+    SharedMessage shared(new string(largePayload(1)));
+    conn->send(shared);
+    Buffer buf;
+    buf.append(largePayload(2));
+    conn->send(&buf);
+    check(buf.readableBytes() == 0, "buffer taken");
+    g_zeroCopyConn = conn;
+    g_zeroCopyReady.countDown();
+  }
+}
+
+void readLarge()
+{
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort + 2);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  string received;
+  if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) == 0)
+  {
+    g_zeroCopyReady.wait();
+    Buffer buf;
+    buf.append(largePayload(3));
+    g_zeroCopyConn->send(&buf);
+    check(buf.readableBytes() == 0, "buffer taken off loop");
+    g_zeroCopyConn->shutdown();
+    char chunk[65536];
+    ssize_t n = 0;
+    while ((n = ::read(fd, chunk, sizeof chunk)) > 0)
+    {
+      received.append(chunk, n);
+    }
+  }
+  check(received == largePayload(1) + largePayload(2) + largePayload(3), "zero copy bytes");
+  ::close(fd);
+  g_loop->quit();
+}
+
+// High water mark: crossed once by a shared message, an in place append
+// behind it must not report it again.
+int g_highWaterMarks = 0;
+
+void countHighWaterMark(const TcpConnectionPtr&, size_t)
+{
+  ++g_highWaterMarks;
+}
+
+void onQueuedConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setHighWaterMarkCallback(countHighWaterMark, 4 * 1024 * 1024);
+    conn->send(SharedMessage(new string(kLarge, 'q')));
+    Buffer* output = conn->outputBuffer();
+    size_t oldLen = output->readableBytes();
+    output->append(string(100, 'r'));
+    conn->sendOutputBuffer(oldLen);
+    conn->shutdown();
+  }
+}
+
+void readQueued()
+{
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  int rcvbuf = 4096;
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof rcvbuf);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort + 3);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  size_t received = 0;
+  if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) == 0)
+  {
+    ::usleep(200 * 1000);
+    char buf[65536];
+    ssize_t n = 0;
+    while ((n = ::read(fd, buf, sizeof buf)) > 0)
+    {
+      received += n;
+    }
+  }
+  check(received == kLarge + 100, "queued bytes");
+  ::close(fd);
+  g_loop->quit();
+}
+
+int main()
+{
+  EventLoop loop;
+  g_loop = &loop;
+  TcpServer server(&loop, InetAddress("127.0.0.1", kPort), "Sender");
+  server.setConnectionCallback(onConnection);
+  server.start();
+
+  Thread client(readAll, "client");
+  client.start();
+  loop.runAfter(30.0, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+  client.join();
+
+  check(g_queued, "partial write");
+  check(g_received.size() == g_expected.size(), "size");
+  check(g_received == g_expected, "byte order");
+
+  TcpServer echo(&loop, InetAddress("127.0.0.1", kPort + 1), "Echo");
+  echo.setConnectionCallback(onEchoConnection);
+  echo.setMessageCallback(onEchoMessage);
+  echo.setWriteCompleteCallback(onEchoWriteComplete);
+  echo.start();
+  Thread pinger(pingPong, "pinger");
+  pinger.start();
+  loop.loop();
+  pinger.join();
+
+  TcpServer zeroCopy(&loop, InetAddress("127.0.0.1", kPort + 2), "ZeroCopy");
+  zeroCopy.setConnectionCallback(onZeroCopyConnection);
+  zeroCopy.start();
+  Thread reader(readLarge, "reader");
+  reader.start();
+  loop.loop();
+  reader.join();
+  g_zeroCopyConn.reset();
+
+  TcpServer queued(&loop, InetAddress("127.0.0.1", kPort + 3), "Queued");
+  queued.setConnectionCallback(onQueuedConnection);
+  queued.start();
+  Thread queuedReader(readQueued, "queuedReader");
+  queuedReader.start();
+  loop.loop();
+  queuedReader.join();
+  check(g_highWaterMarks == 1, "high water mark once");
+
+  printf("%zd bytes, %d failures\n", g_received.size(), g_failures);
+  return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+#include <muduo/net/UdpClient.h>
+#include <muduo/net/UdpServer.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/base/ProcessInfo.h>
+#include <muduo/base/Thread.h>
+#include <muduo/net/EventLoop.h>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const uint16_t kPort = 2017;
+const int kClients = 4;
+const int kMessages = 100;
+const int kSegments = 10;
+const size_t kSegmentSize = 1000;
+const int kExpected = kClients * (kMessages + kSegments);
+
+EventLoop* g_loop;
+int g_received = 0;
+int g_bytes = 0;
+
+void onServerDatagram(UdpSocket* socket, Buffer* buf, const InetAddress& peer, Timestamp)
+{
+  LOG_TRACE << socket->name() << " tid " << CurrentThread::tid()
+            << " echoes " << buf->readableBytes() << " bytes to " << peer.toIpPort();
+  socket->send(peer, buf);
+}
+
+void onClientDatagram(UdpSocket*, Buffer* buf, const InetAddress&, Timestamp)
+{
+  g_bytes += static_cast<int>(buf->readableBytes());
+  buf->retrieveAll();
+  if (++g_received == kExpected)
+  {
+    g_loop->quit();
+  }
+}
+
+typedef boost::shared_ptr<UdpClient> UdpClientPtr;
+
+void sendAll(std::vector<UdpClientPtr>* clients)
+{
+  for (size_t i = 0; i < clients->size(); ++i)
+  {
+    UdpClient& client = *(*clients)[i];
+    for (int j = 0; j < kMessages; ++j)
+    {
+      char buf[32];
+      snprintf(buf, sizeof buf, "hello %d", j);
+      client.send(buf);
+    }
+    string train(kSegments * kSegmentSize, 'x');
+    client.socket()->sendSegments(client.serverAddress(), train, kSegmentSize);
+  }
+}
+
+int main()
+{
+  LOG_INFO << "pid = " << getpid() << ", tid = " << CurrentThread::tid();
+  EventLoop loop;
+  g_loop = &loop;
+
+  UdpServer server(&loop, InetAddress("127.0.0.1", kPort), "UdpEcho");
+  server.setThreadNum(2);
+  server.setDatagramCallback(onServerDatagram);
+  server.setGso(true);
+  server.start();
+
+  std::vector<UdpClientPtr> clients;
+  for (int i = 0; i < kClients; ++i)
+  {
+    char name[32];
+    snprintf(name, sizeof name, "client%d", i);
+    UdpClientPtr client(new UdpClient(&loop, InetAddress("127.0.0.1", kPort), name));
+    client->setDatagramCallback(onClientDatagram);
+    client->socket()->setGso(true);
+    client->start();
+    clients.push_back(client);
+  }
+
+  loop.runAfter(0.5, boost::bind(sendAll, &clients));
+  loop.runAfter(10.0, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  for (size_t i = 0; i < server.sockets().size(); ++i)
+  {
+    const UdpSocketPtr& socket = server.sockets()[i];
+    LOG_INFO << socket->name() << " received " << socket->numReceived()
+             << " sent " << socket->numSent() << " dropped " << socket->numDropped();
+  }
+  printf("received %d of %d datagrams, %d bytes\n", g_received, kExpected, g_bytes);
+
+  // nobody listens, the ICMP error must be read once, not spin the loop.
+  UdpClient refused(&loop, InetAddress("127.0.0.1", kPort + 10), "refused");
+  refused.start();
+  refused.send("anyone?");
+  ProcessInfo::CpuTime before = ProcessInfo::cpuTime();
+  loop.runAfter(0.5, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+  ProcessInfo::CpuTime after = ProcessInfo::cpuTime();
+  double cpu = after.userSeconds + after.systemSeconds
+             - before.userSeconds - before.systemSeconds;
+  int64_t errors = refused.socket()->numErrors();
+  printf("refused: %lld errors, %.3f cpu seconds\n", static_cast<long long>(errors), cpu);
+
+  return g_received == kExpected && errors == 1 && cpu < 0.2 ? 0 : 1;
+}
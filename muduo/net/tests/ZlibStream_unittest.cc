@@ -89,3 +89,40 @@ BOOST_AUTO_TEST_CASE(testZlibOutputStream5)
   printf("total %zd\n", output.readableBytes());
   BOOST_CHECK_EQUAL(stream.zlibErrorCode(), Z_STREAM_END);
 }
+
+BOOST_AUTO_TEST_CASE(testZlibDeflater)
+{
+  muduo::net::ZlibDeflater deflater(muduo::net::ZlibDeflater::kZlib);
+  BOOST_CHECK_EQUAL(deflater.zlibErrorCode(), Z_OK);
+  muduo::string input;
+  for (int i = 0; i < 4096; ++i)
+  {
+    input += "{\"key\":\"value\"},"[i % 16];
+  }
+
+  // the same deflater is reused for every message
+  for (int i = 0; i < 3; ++i)
+  {
+    muduo::net::Buffer output;
+    BOOST_CHECK(deflater.compress(input, &output));
+    BOOST_CHECK(output.readableBytes() < input.size());
+
+    muduo::string plain(input.size(), '\0');
+    uLongf len = plain.size();
+    BOOST_CHECK_EQUAL(uncompress(reinterpret_cast<Bytef*>(&*plain.begin()), &len,
+                                 reinterpret_cast<const Bytef*>(output.peek()),
+                                 output.readableBytes()), Z_OK);
+    BOOST_CHECK_EQUAL(len, input.size());
+    BOOST_CHECK(plain == input);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testZlibDeflaterGzip)
+{
+  muduo::net::ZlibDeflater deflater(muduo::net::ZlibDeflater::kGzip);
+  muduo::net::Buffer output;
+  BOOST_CHECK(deflater.compress("hello, world", &output));
+  BOOST_CHECK(output.readableBytes() > 2);
+  BOOST_CHECK_EQUAL(static_cast<unsigned char>(output.peek()[0]), 0x1f);
+  BOOST_CHECK_EQUAL(static_cast<unsigned char>(output.peek()[1]), 0x8b);
+}